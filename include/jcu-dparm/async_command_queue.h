@@ -0,0 +1,109 @@
+/**
+ * @file	async_command_queue.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_ASYNC_COMMAND_QUEUE_H_
+#define JCU_DPARM_ASYNC_COMMAND_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "err.h"
+#include "ata_types.h"
+#include "sense_data.h"
+
+namespace jcu {
+namespace dparm {
+
+struct AsyncAtaCommand {
+  /**
+   * index returned by AsyncCommandQueue::addDrive
+   */
+  int drive;
+  /**
+   * 0 : read, 1 : write
+   */
+  int rw;
+  /**
+   * -1 : by tf.command
+   */
+  int dma;
+  ata::ata_tf_t tf;
+  /**
+   * must stay valid until the command is reaped
+   */
+  void *data;
+  unsigned int data_bytes;
+  unsigned int timeout_secs;
+  /**
+   * returned in AsyncAtaCompletion
+   */
+  uint64_t user_data;
+  /**
+   * do not clear the read buffer before the transfer.
+   * Only the first (data_bytes - detail.resid) bytes of the completion are valid then.
+   */
+  bool no_read_zeroing;
+};
+
+struct AsyncAtaCompletion {
+  int drive;
+  uint64_t user_data;
+  /**
+   * result Task File (status, error, ...)
+   */
+  ata::ata_tf_t tf;
+  DparmResult result;
+  /**
+   * SCSI status, sense and residual of the command
+   */
+  AtaCompletion detail;
+};
+
+/**
+ * Queue of ATA commands in flight on several drives at once
+ *
+ * Commands are issued without waiting and collected by reap() from one thread.
+ * Not thread safe.
+ */
+class AsyncCommandQueue {
+ public:
+  virtual ~AsyncCommandQueue() {}
+
+  /**
+   * @param drive_path (in) drive path (linux: /dev/sdX or /dev/sgN)
+   * @return drive index for AsyncAtaCommand::drive
+   */
+  virtual DparmReturn<int> addDrive(const char *drive_path) = 0;
+
+  /**
+   * issue a command without waiting for it
+   *
+   * @return DPARME_OK if queued. DPARME_SYS with EAGAIN if the drive queue is full.
+   */
+  virtual DparmResult submit(const AsyncAtaCommand& command) = 0;
+
+  /**
+   * collect finished commands
+   *
+   * @param completions     (out) finished commands are appended
+   * @param min_completions (in)  wait until this many commands are collected (limited to the in-flight count)
+   * @param timeout_ms      (in)  -1 : infinite
+   * @return zero if successful, ETIMEDOUT if fewer than min_completions are collected, otherwise system error code.
+   */
+  virtual int reap(std::vector<AsyncAtaCompletion>& completions, size_t min_completions, int timeout_ms) = 0;
+
+  virtual size_t getInflightCount() const = 0;
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_ASYNC_COMMAND_QUEUE_H_
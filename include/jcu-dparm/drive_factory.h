@@ -14,6 +14,7 @@
 
 #include <memory>
 #include <list>
+#include <functional>
 
 #include "err.h"
 #include "types.h"
@@ -22,6 +23,8 @@ namespace jcu {
 namespace dparm {
 
 class DriveHandle;
+class DeviceEventSource;
+class AsyncCommandQueue;
 
 class EnumVolumesContext {
  public:
@@ -30,14 +33,91 @@ class EnumVolumesContext {
   virtual std::list<VolumeInfo> getList() const = 0;
 };
 
+/**
+ * called for each drive as soon as it is probed
+ *
+ * @param drive_info (in)     copy of the drive information owned by the enumeration, not by the handle,
+ *                            so it stays valid even if the handle is moved out and closed. Valid only during the call.
+ * @param handle     (in/out) opened handle (nullptr with kEnumBasic).
+ *                            Move it out to keep the drive open, otherwise it is closed after the call.
+ * @return false to stop the enumeration. Drives not started yet are skipped.
+ */
+typedef std::function<bool(const DriveInfo& drive_info, std::unique_ptr<DriveHandle>& handle)> EnumDrivesCallback;
+
 class DriveFactory {
  public:
   static DriveFactory* getSystemFactory();
   static std::shared_ptr<DriveFactory> createSystemFactory(const DriveFactoryOptions& options);
 
   virtual std::unique_ptr<DriveHandle> open(const char* drive_path) const = 0;
+
+  /**
+   * open a drive through the handle cache of the factory
+   *
+   * Returns the same handle for the same path until it is invalidated,
+   * so repeated queries do not redo the open and IDENTIFY/Discovery 0.
+   * Linux: the entry is reopened if the path points another device number.
+   * A drive swapped under the same device number is not detected here: DriveInventory calls
+   * invalidateShared() on each device event; without an inventory, call it on hot-plug.
+   *
+   * @warning DriveHandle methods are not thread safe. Serialize calls on a shared handle.
+   *          Do not close() a shared handle; use invalidateShared().
+   */
+  virtual std::shared_ptr<DriveHandle> openShared(const char* drive_path) const = 0;
+
+  /**
+   * drop cached handles. They are closed when the last reference is released.
+   *
+   * @param drive_path (in) nullptr : all
+   */
+  virtual void invalidateShared(const char* drive_path) const = 0;
   virtual int enumDrives(std::list<DriveInfo>& result_list) const = 0;
 
+  /**
+   * enumerate drives
+   *
+   * @param result_list (out) drives. Each DriveInfo::open_result holds the open result of the drive.
+   * @param options     (in)  enumeration options
+   * @return zero if successful, otherwise system error code.
+   */
+  virtual int enumDrives(std::list<DriveInfo>& result_list, const EnumDrivesOptions& options) const = 0;
+
+  /**
+   * enumerate drives without building a list
+   *
+   * The callback is called in completion order, one at a time (never concurrently),
+   * possibly from a worker thread when options.parallel > 1.
+   *
+   * @param callback (in) called for each drive
+   * @param options  (in) enumeration options
+   * @return zero if successful, otherwise system error code.
+   */
+  virtual int enumDrives(const EnumDrivesCallback& callback, const EnumDrivesOptions& options) const = 0;
+
+  /**
+   * fill the DriveInfo of one drive as enumDrives does
+   *
+   * @param drive_path (in)  drive path
+   * @param drive_info (out) drive information. DriveInfo::open_result holds the open result.
+   * @param options    (in)  enumeration options (parallel is ignored)
+   * @return zero if successful, ENODEV if the drive is excluded by options.filter, otherwise system error code.
+   */
+  virtual int probeDrive(const char* drive_path, DriveInfo& drive_info, const EnumDrivesOptions& options) const = 0;
+
+  /**
+   * create a source of drive add/remove events (see drive_inventory.h)
+   *
+   * @return nullptr if the platform does not support it
+   */
+  virtual std::unique_ptr<DeviceEventSource> createDeviceEventSource() const = 0;
+
+  /**
+   * create a queue of ATA commands which are in flight at once (see async_command_queue.h)
+   *
+   * @return nullptr if the platform does not support it
+   */
+  virtual std::unique_ptr<AsyncCommandQueue> createAsyncCommandQueue() const = 0;
+
   virtual std::unique_ptr<EnumVolumesContext> enumVolumes() const = 0;
 };
 
@@ -14,6 +14,9 @@
 
 #include "./types.h"
 #include "./err.h"
+#include "./trace_ring.h"
+#include "./latency_stats.h"
+#include "./sense_data.h"
 #include "tcg/tcg_device.h"
 
 namespace jcu {
@@ -29,10 +32,45 @@ class DriveHandle {
   virtual bool isOpen() const = 0;
   virtual DparmResult getError() const = 0;
   virtual void close() = 0;
+  /**
+   * Never issues a command.
+   * tcg_* fields are not valid while isTcgDiscoveryPending() is true; tcg_support is -1 then.
+   */
   virtual const DriveInfo& getDriveInfo() const = 0;
+  virtual bool isTcgDiscoveryPending() const = 0;
+  /**
+   * run the TCG Discovery 0 deferred by DriveFactoryOptions::lazy_tcg_discovery.
+   * getTcgDevice() runs it too.
+   *
+   * @return result of the discovery. DPARME_OK if nothing is pending.
+   */
+  virtual DparmResult runPendingTcgDiscovery() = 0;
 
   virtual std::string getDriverName() const = 0;
 
+  /**
+   * @return nullptr unless DriveFactoryOptions::trace_records is set
+   */
+  virtual const TraceRing* getTraceRing() const = 0;
+
+  /**
+   * latency and error counters of the passthrough commands issued through this handle, per opcode.
+   * Collected by the Linux SG and NVMe drivers. Valid while the handle lives.
+   */
+  virtual const LatencyStats* getLatencyStats() const = 0;
+
+  /**
+   * Read buffers are cleared before each device-to-host passthrough transfer by default.
+   * With false, the caller must use only the first (data_bytes - getLastResid()) bytes.
+   * Saves a memset of each multi-megabyte log, telemetry or verify read.
+   * The commands the handle issues itself (IDENTIFY, SMART, DCO, TCG security receive) always clear.
+   */
+  virtual void setReadZeroing(bool enabled) = 0;
+  /**
+   * @return bytes not transferred by the last passthrough command (SCSI resid). 0 if the driver does not report it.
+   */
+  virtual int getLastResid() const = 0;
+
   virtual const std::vector<unsigned char> getAtaIdentifyDeviceRaw() const = 0;
   virtual const std::vector<unsigned char> getNvmeIdentifyDeviceRaw() const = 0;
 
@@ -46,6 +84,21 @@ class DriveHandle {
       unsigned int data_bytes,
       unsigned int timeout_secs
   ) = 0;
+  /**
+   * doTaskfileCmd which also returns the SCSI status, sense key/ASC/ASCQ, residual and ATA return descriptor,
+   * decoded from the sense data of the command itself.
+   *
+   * @param completion (out) filled even if the command fails
+   */
+  virtual DparmResult doTaskfileCmdWithCompletion(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      void *data,
+      unsigned int data_bytes,
+      unsigned int timeout_secs,
+      AtaCompletion *completion
+  ) = 0;
 
   virtual bool driverIsAtaCmdSupported() const = 0;
   virtual DparmResult doAtaCmd(
@@ -60,6 +113,32 @@ class DriveHandle {
       unsigned int sense_buf_bytes
   ) = 0;
 
+  /**
+   * Scatter-gather forms of doTaskfileCmd/doAtaCmd.
+   * The data goes directly to/from the segments (e.g. a ring of pages) without a contiguous staging buffer.
+   * DPARME_NOT_SUPPORTED unless driverIsVectoredCmdSupported().
+   */
+  virtual bool driverIsVectoredCmdSupported() const = 0;
+  virtual DparmResult doTaskfileCmdV(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      unsigned int timeout_secs
+  ) = 0;
+  virtual DparmResult doAtaCmdV(
+      int rw,
+      unsigned char* cdb,
+      unsigned int cdb_bytes,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      int pack_id,
+      unsigned int timeout_secs,
+      unsigned char *sense_buf,
+      unsigned int sense_buf_bytes
+  ) = 0;
+
   /* NVMe Low-level methods */
   virtual bool driverIsNvmeAdminPassthruSupported() const = 0;
   virtual DparmReturn<int> doNvmeAdminPassthru(nvme::nvme_admin_cmd_t* cmd) = 0;
@@ -67,12 +146,33 @@ class DriveHandle {
   virtual DparmReturn<int> doNvmeIoPassthru(nvme::nvme_passthru_cmd_t* cmd) = 0;
   virtual bool driverIsNvmeIoSupported() const = 0;
   virtual DparmReturn<int> doNvmeIo(nvme::nvme_user_io_t* io) = 0;
+  /**
+   * @return namespace doNvmeIo is issued on (linux: NVME_IOCTL_ID of a namespace device), 0 if none or unknown
+   */
+  virtual uint32_t getNvmeNamespaceId() const = 0;
+  /**
+   * Passthrough with the 64-bit completion result (linux: NVME_IOCTL_ADMIN64_CMD/NVME_IOCTL_IO64_CMD).
+   * cmd->result receives the whole result; value is the NVMe status.
+   * DPARME_NOT_SUPPORTED if the driver or the kernel does not have them.
+   */
+  virtual bool driverIsNvmePassthru64Supported() const = 0;
+  virtual DparmReturn<int> doNvmeAdminPassthru64(nvme::nvme_passthru_cmd64_t* cmd) = 0;
+  virtual DparmReturn<int> doNvmeIoPassthru64(nvme::nvme_passthru_cmd64_t* cmd) = 0;
+  /**
+   * doNvmeIoPassthru64 with the data in segments, transferred without a bounce copy
+   * (linux: NVME_IOCTL_IO64_CMD_VEC). cmd->addr and cmd->data_len are ignored.
+   */
+  virtual DparmReturn<int> doNvmeIoPassthru64V(nvme::nvme_passthru_cmd64_t* cmd, const DparmIoVec *iov, unsigned int iov_count) = 0;
   virtual DparmResult doNvmeGetLogPageCmd(
       uint32_t nsid, uint8_t log_id,
       uint8_t lsp, uint64_t lpo, uint16_t lsi,
       bool rae, uint8_t uuid_ix,
       uint32_t data_len, void *data) = 0;
   virtual DparmResult doNvmeGetLogPage(uint32_t nsid, uint8_t log_id, bool rae, uint32_t data_len, void *data) = 0;
+  /**
+   * @return transfer size of each Get Log Page command of doNvmeGetLogPage: MDTS of the controller limited by the host
+   */
+  virtual uint32_t getNvmeLogChunkBytes() = 0;
 
   /* Security Low-level methods */
   virtual DparmResult doSecurityCommand(int rw, int dma, uint8_t protocol, uint16_t com_id, void *buffer, uint32_t len) = 0;
@@ -92,6 +192,22 @@ class DriveHandle {
   virtual DparmReturn<nvme::nvme_smart_log_page_t> readNvmeSmartLogPage() = 0;
   virtual DparmReturn<SMARTStatus> readAtaSmartStatus() = 0;
 
+  /**
+   * active namespaces of the controller (Identify CNS 02h) with their Identify Namespace data, ordered by nsid.
+   * Read by the first call and cached by the handle.
+   */
+  virtual DparmReturn<std::vector<NvmeNamespaceInfo>> getNvmeNamespaces() = 0;
+  /**
+   * update the cached namespaces after a namespace change (e.g. a DeviceEvent of a namespace of the controller).
+   * The active list is read again, and Identify Namespace only for namespaces which are new,
+   * listed in the Changed Namespace List log (04h) or given by nsid.
+   * All namespaces are identified again if the log can not be read.
+   * The linux kernel usually consumes the Changed Namespace List itself; pass the nsid of the event then.
+   *
+   * @param nsid (in) namespace known to be changed. 0 : none, 0xFFFFFFFF : all
+   */
+  virtual DparmResult refreshNvmeNamespaces(uint32_t nsid) = 0;
+
   virtual uint64_t getAtaLbaCapacity() = 0;
   virtual DparmReturn<uint64_t> readNativeMaxSectors() = 0;
   virtual DparmReturn<std::vector<uint16_t>> readDcoIdentify() = 0;
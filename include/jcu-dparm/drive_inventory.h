@@ -0,0 +1,139 @@
+/**
+ * @file	drive_inventory.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_DRIVE_INVENTORY_H_
+#define JCU_DPARM_DRIVE_INVENTORY_H_
+
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include "types.h"
+#include "drive_factory.h"
+
+namespace jcu {
+namespace dparm {
+
+enum DeviceEventAction {
+  kDeviceAdd = 1,
+  kDeviceRemove = 2,
+  kDeviceChange = 3,
+};
+
+struct DeviceEvent {
+  DeviceEventAction action;
+  /**
+   * kernel name (linux: sda, nvme0n1)
+   */
+  std::string dev_name;
+  /**
+   * path for DriveFactory::open (linux: /dev/sda)
+   */
+  std::string device_path;
+};
+
+/**
+ * Source of whole-disk add/remove/change events
+ * (linux: NETLINK_KOBJECT_UEVENT)
+ */
+class DeviceEventSource {
+ public:
+  virtual ~DeviceEventSource() {}
+
+  /**
+   * wait for the next event
+   *
+   * @param event      (out) event
+   * @param timeout_ms (in)  -1 : infinite, 0 : no wait
+   * @return zero if an event is read, ETIMEDOUT if there is no event, otherwise system error code.
+   */
+  virtual int readEvent(DeviceEvent& event, int timeout_ms) = 0;
+};
+
+enum DriveChangeType {
+  kDriveAdded = 1,
+  kDriveRemoved = 2,
+  kDriveChanged = 3,
+};
+
+/**
+ * Set of DriveInfo kept up to date by device events
+ *
+ * Only the drive of each event is probed; the other drives are untouched.
+ * getDrives() may be called from any thread while another thread runs processEvents().
+ */
+class DriveInventory {
+ public:
+  typedef std::function<void(DriveChangeType change, const DriveInfo& drive_info)> ChangeCallback;
+
+ private:
+  const DriveFactory* factory_;
+  std::unique_ptr<DeviceEventSource> event_source_;
+  EnumDrivesOptions options_;
+  ChangeCallback change_callback_;
+
+  mutable std::mutex mutex_;
+  // key: device_path
+  std::map<std::string, DriveInfo> drives_;
+
+  void notify(DriveChangeType change, const DriveInfo& drive_info);
+
+ public:
+  /**
+   * @param factory      (in) factory used to probe drives. Must outlive the inventory.
+   * @param event_source (in) event source. nullptr to update only by refresh() and handleEvent().
+   * @param options      (in) options used for the probe (parallel is used by refresh() only)
+   */
+  DriveInventory(const DriveFactory* factory, std::unique_ptr<DeviceEventSource> event_source, const EnumDrivesOptions& options);
+
+  /**
+   * create an inventory with the platform event source of the factory
+   */
+  static std::unique_ptr<DriveInventory> create(const DriveFactory* factory, const EnumDrivesOptions& options);
+
+  /**
+   * called after the inventory is updated. Not called with the internal lock held.
+   */
+  void setChangeCallback(const ChangeCallback& callback);
+
+  /**
+   * rescan all drives. Call once after creation, since the event source is subscribed first.
+   *
+   * @return zero if successful, otherwise system error code.
+   */
+  int refresh();
+
+  /**
+   * handle events of the event source until there is no pending event
+   *
+   * @param timeout_ms (in) timeout for the first event. -1 : infinite
+   * @return zero if at least one event is handled, ETIMEDOUT if none, ENOTSUP without event source,
+   *         otherwise system error code.
+   */
+  int processEvents(int timeout_ms);
+
+  /**
+   * apply one event: probe the drive on add, drop it on remove.
+   * A change event probes only a drive which is not in the inventory; closing the drive after a probe
+   * makes udev emit one for the drive itself. Use refresh() or kDeviceAdd to probe a known drive again.
+   * The shared handle of the device (DriveFactory::openShared) is invalidated, except on an ignored change.
+   */
+  void handleEvent(const DeviceEvent& event);
+
+  std::list<DriveInfo> getDrives() const;
+  bool findDrive(const std::string& device_path, DriveInfo* drive_info) const;
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_DRIVE_INVENTORY_H_
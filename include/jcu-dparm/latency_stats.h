@@ -0,0 +1,121 @@
+/**
+ * @file	latency_stats.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_LATENCY_STATS_H_
+#define JCU_DPARM_LATENCY_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+namespace jcu {
+namespace dparm {
+
+enum LatencyOpcodeClass {
+  /**
+   * ATA command (taskfile command, ATA PASS-THROUGH cdb)
+   */
+  kLatencyAta = 0,
+  /**
+   * SCSI operation code of any other cdb
+   */
+  kLatencyScsi = 1,
+  kLatencyNvmeAdmin = 2,
+  kLatencyNvmeIo = 3,
+  kLatencyOpcodeClassCount = 4,
+};
+
+/**
+ * HDR-style bucket layout of latencies in microseconds
+ *
+ * Values below 8 have their own bucket. Above, each power of two is split into 8 linear sub-buckets,
+ * so a bucket bound is within 12.5% of any value it holds. Values are clamped to kMaxValue (about 19 hours).
+ */
+struct LatencyHistogram {
+  static const unsigned int kSubBucketBits = 3;
+  static const unsigned int kSubBucketCount = 1u << kSubBucketBits;
+  static const unsigned int kMaxValueBits = 36;
+  static const uint64_t kMaxValue = (1ULL << kMaxValueBits) - 1;
+  static const size_t kBucketCount = kSubBucketCount * (kMaxValueBits - kSubBucketBits + 1);
+
+  static size_t bucketIndex(uint64_t value);
+  static uint64_t bucketLowerBound(size_t index);
+  /**
+   * @return largest value of the bucket
+   */
+  static uint64_t bucketUpperBound(size_t index);
+};
+
+struct LatencyOpcodeStats {
+  LatencyOpcodeClass opcode_class;
+  uint8_t opcode;
+  uint64_t count;
+  /**
+   * commands that failed (ioctl error, transport error, ATA ERR/DRQ, NVMe status)
+   */
+  uint64_t errors;
+  uint64_t total_us;
+  uint64_t max_us;
+  /**
+   * LatencyHistogram::kBucketCount counters
+   */
+  std::vector<uint64_t> buckets;
+
+  uint64_t meanUs() const {
+    return count ? (total_us / count) : 0;
+  }
+
+  /**
+   * @param percentile (in) 0 ~ 100
+   * @return upper bound of the bucket holding the percentile, not more than max_us
+   */
+  uint64_t percentileUs(double percentile) const;
+};
+
+/**
+ * Latency histograms and error counters keyed by opcode
+ *
+ * The counters of an opcode are allocated when it is first recorded.
+ * record() takes no lock and may be called from any thread, as may snapshot().
+ */
+class LatencyStats {
+ private:
+  struct Entry {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> total_us;
+    std::atomic<uint64_t> max_us;
+    std::atomic<uint64_t> buckets[LatencyHistogram::kBucketCount];
+
+    Entry();
+  };
+
+  std::atomic<Entry *> entries_[kLatencyOpcodeClassCount * 256];
+
+  LatencyStats(const LatencyStats&) = delete;
+  LatencyStats& operator=(const LatencyStats&) = delete;
+
+ public:
+  LatencyStats();
+  ~LatencyStats();
+
+  void record(LatencyOpcodeClass opcode_class, uint8_t opcode, uint64_t duration_us, bool error);
+
+  /**
+   * @param stats (out) appended, one item per recorded opcode ordered by class and opcode
+   */
+  void snapshot(std::vector<LatencyOpcodeStats>& stats) const;
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_LATENCY_STATS_H_
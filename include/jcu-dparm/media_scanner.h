@@ -0,0 +1,188 @@
+/**
+ * @file	media_scanner.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_MEDIA_SCANNER_H_
+#define JCU_DPARM_MEDIA_SCANNER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+#include <functional>
+
+#include "err.h"
+#include "latency_stats.h"
+#include "drive_handle.h"
+
+namespace jcu {
+namespace dparm {
+
+struct MediaScanOptions {
+  /**
+   * sectors per READ VERIFY SECTORS EXT. 0 : 65536 (the maximum)
+   */
+  uint32_t chunk_sectors;
+  uint64_t start_lba;
+  /**
+   * exclusive. 0 : end of the drive
+   */
+  uint64_t end_lba;
+  /**
+   * a chunk taking longer is reported as a slow region. 0 : 1000 ms
+   */
+  uint32_t slow_chunk_ms;
+  /**
+   * timeout of each command. 0 : DriveFactoryOptions::retry_policy default
+   */
+  uint32_t timeout_secs;
+  /**
+   * throttle of each drive. 0 : unlimited
+   */
+  uint64_t max_sectors_per_second;
+  /**
+   * number of drives scanned at once. 0 : all drives
+   */
+  int parallel;
+  /**
+   * stop a drive after this many failed commands. 0 : unlimited
+   */
+  uint32_t max_errors;
+
+  MediaScanOptions() {
+    chunk_sectors = 0;
+    start_lba = 0;
+    end_lba = 0;
+    slow_chunk_ms = 0;
+    timeout_secs = 0;
+    max_sectors_per_second = 0;
+    parallel = 0;
+    max_errors = 0;
+  }
+};
+
+enum MediaRegionType {
+  /**
+   * READ VERIFY failed (the ATA error LBA, or the whole chunk if the drive did not report it)
+   */
+  kMediaRegionBad = 1,
+  /**
+   * the chunk took longer than MediaScanOptions::slow_chunk_ms
+   */
+  kMediaRegionSlow = 2,
+};
+
+struct MediaRegion {
+  uint64_t lba;
+  uint64_t sectors;
+  MediaRegionType type;
+  /**
+   * slowest command of the region
+   */
+  uint32_t max_latency_ms;
+};
+
+/**
+ * Bad and slow regions of a drive, sorted by lba.
+ * Touching regions of the same type are merged.
+ */
+class MediaRegionMap {
+ private:
+  std::vector<MediaRegion> regions_;
+
+ public:
+  void add(uint64_t lba, uint64_t sectors, MediaRegionType type, uint32_t latency_ms);
+
+  const std::vector<MediaRegion>& getRegions() const {
+    return regions_;
+  }
+
+  /**
+   * @return total sectors of the regions of the type
+   */
+  uint64_t countSectors(MediaRegionType type) const;
+};
+
+struct MediaScanResult {
+  /**
+   * DPARME_NOT_SUPPORTED for drives without ATA taskfile commands,
+   * otherwise the error which stopped the scan
+   */
+  DparmResult result;
+  uint64_t start_lba;
+  uint64_t end_lba;
+  /**
+   * next lba to verify. end_lba when finished.
+   */
+  uint64_t next_lba;
+  uint32_t errors;
+  uint64_t elapsed_ms;
+  MediaRegionMap regions;
+  /**
+   * latency of each command (opcode_class : kLatencyAta, opcode : ATA_OP_READ_VERIFY_EXT)
+   */
+  LatencyOpcodeStats chunk_latency;
+};
+
+/**
+ * Surface scan of many drives with READ VERIFY SECTORS EXT
+ *
+ * The media is read by the drive only; no data crosses the bus.
+ * Each drive is scanned by its own worker, chunk after chunk.
+ */
+class MediaScanner {
+ public:
+  /**
+   * called by the worker of the drive after each chunk. May be called concurrently for different drives.
+   *
+   * @return false to stop the drive
+   */
+  typedef std::function<bool(size_t drive_index, const MediaScanResult& progress)> ProgressCallback;
+
+ private:
+  MediaScanOptions options_;
+  std::vector<DriveHandle *> drives_;
+  std::vector<MediaScanResult> results_;
+  ProgressCallback progress_callback_;
+  std::atomic<bool> cancelled_;
+
+  void scanDrive(size_t index);
+
+ public:
+  explicit MediaScanner(const MediaScanOptions& options);
+
+  /**
+   * @param handle (in) opened drive. Must outlive run() and must not be used by others meanwhile.
+   * @return drive index
+   */
+  size_t addDrive(DriveHandle *handle);
+
+  void setProgressCallback(const ProgressCallback& callback);
+
+  /**
+   * scan all drives and wait for them
+   */
+  void run();
+
+  /**
+   * stop all drives after their current chunk. May be called from any thread.
+   */
+  void cancel();
+
+  /**
+   * @return one result per drive in addDrive order
+   */
+  const std::vector<MediaScanResult>& getResults() const {
+    return results_;
+  }
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_MEDIA_SCANNER_H_
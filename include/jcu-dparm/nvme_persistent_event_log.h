@@ -0,0 +1,167 @@
+/**
+ * @file	nvme_persistent_event_log.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_NVME_PERSISTENT_EVENT_LOG_H_
+#define JCU_DPARM_NVME_PERSISTENT_EVENT_LOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "err.h"
+#include "nvme_types.h"
+#include "drive_handle.h"
+
+namespace jcu {
+namespace dparm {
+
+/**
+ * one event of the Persistent Event Log. The pointers refer to the buffer of the reader.
+ */
+struct NvmePersistentEvent {
+  /**
+   * byte offset of the event in the log
+   */
+  uint64_t offset;
+  /**
+   * bytes of the whole event (header, vendor specific information and data)
+   */
+  uint32_t length;
+  uint8_t type;
+  uint8_t revision;
+  uint16_t controller_id;
+  /**
+   * milliseconds since 1970-01-01 (bits 47:0 of the event timestamp)
+   */
+  uint64_t timestamp_ms;
+  const uint8_t *vendor_info;
+  uint16_t vendor_info_length;
+  const uint8_t *data;
+  uint32_t data_length;
+};
+
+/**
+ * forward iterator over packed events. Parses in place without allocation.
+ * Stops at the end of the buffer or at an event which does not fit in it.
+ */
+class NvmePersistentEventIterator {
+ private:
+  const uint8_t *pos_;
+  const uint8_t *end_;
+  NvmePersistentEvent event_;
+
+  void parse();
+
+ public:
+  /**
+   * end iterator
+   */
+  NvmePersistentEventIterator();
+  /**
+   * @param data   (in) first event
+   * @param length (in) bytes of the events
+   * @param offset (in) log offset of the first event
+   */
+  NvmePersistentEventIterator(const void *data, size_t length, uint64_t offset);
+
+  const NvmePersistentEvent& operator*() const {
+    return event_;
+  }
+
+  const NvmePersistentEvent* operator->() const {
+    return &event_;
+  }
+
+  NvmePersistentEventIterator& operator++();
+
+  bool operator==(const NvmePersistentEventIterator& rhs) const {
+    return pos_ == rhs.pos_;
+  }
+
+  bool operator!=(const NvmePersistentEventIterator& rhs) const {
+    return pos_ != rhs.pos_;
+  }
+};
+
+/**
+ * Incremental reader of the Persistent Event Log (0Dh)
+ *
+ * Each poll() establishes a reporting context and reads only the part of the log after the last
+ * consumed event. If that event is not at its offset anymore (the log wrapped or was cleared), the whole
+ * log is read and the events up to the last consumed one (same timestamp and type) are skipped.
+ * If it is gone, only the leading events older than its timestamp are skipped, up to a Timestamp Change
+ * or Power-on or Reset event or a timestamp going back; events of the same millisecond are reported again.
+ * The buffer is reused between polls. Not thread safe.
+ */
+class NvmePersistentEventReader {
+ private:
+  DriveHandle *handle_;
+  std::vector<uint8_t> buffer_;
+  nvme::nvme_persistent_event_log_header_t header_;
+
+  // events of the last poll in buffer_
+  size_t events_begin_;
+  size_t events_end_;
+  uint64_t events_offset_;
+
+  bool has_position_;
+  uint64_t last_event_offset_;
+  uint64_t last_timestamp_ms_;
+  uint8_t last_type_;
+
+  DparmResult readRange(uint64_t start, uint64_t end);
+
+ public:
+  explicit NvmePersistentEventReader(DriveHandle *handle);
+
+  /**
+   * fetch the events added since the last poll (all events on the first poll)
+   */
+  DparmResult poll();
+
+  /**
+   * events fetched by the last poll. Valid until the next poll.
+   */
+  NvmePersistentEventIterator begin() const;
+  NvmePersistentEventIterator end() const;
+
+  /**
+   * header read by the last poll
+   */
+  const nvme::nvme_persistent_event_log_header_t& getHeader() const {
+    return header_;
+  }
+
+  /**
+   * resume from a position saved from a previous reader (getLastEventOffset, getLastTimestamp, getLastType)
+   */
+  void setPosition(uint64_t last_event_offset, uint64_t last_timestamp_ms, uint8_t last_type);
+
+  bool hasPosition() const {
+    return has_position_;
+  }
+
+  uint64_t getLastEventOffset() const {
+    return last_event_offset_;
+  }
+
+  uint64_t getLastTimestamp() const {
+    return last_timestamp_ms_;
+  }
+
+  uint8_t getLastType() const {
+    return last_type_;
+  }
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_NVME_PERSISTENT_EVENT_LOG_H_
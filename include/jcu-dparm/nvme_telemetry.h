@@ -0,0 +1,105 @@
+/**
+ * @file	nvme_telemetry.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_NVME_TELEMETRY_H_
+#define JCU_DPARM_NVME_TELEMETRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+
+#include "err.h"
+#include "drive_handle.h"
+
+namespace jcu {
+namespace dparm {
+
+struct NvmeTelemetryOptions {
+  /**
+   * last data area to capture: 1 ~ 4. 0 : 3.
+   * Data area 4 is captured only if the controller reports it (Host Behavior Support ETDAS).
+   */
+  int data_area;
+  /**
+   * true  : Create Telemetry Host-Initiated Data (LSP bit 0) with the header read; a new snapshot is captured.
+   * false : read the snapshot retained by the controller.
+   */
+  bool create;
+  /**
+   * bytes per Get Log Page, multiple of 512. 0 : DriveHandle::getNvmeLogChunkBytes()
+   */
+  uint32_t chunk_bytes;
+  /**
+   * chunk buffers in flight between the drive and the sink. 0 : 4, 1 : no writer thread.
+   * Memory used is ring_buffers * chunk_bytes regardless of the log size.
+   */
+  int ring_buffers;
+
+  NvmeTelemetryOptions() {
+    data_area = 0;
+    create = false;
+    chunk_bytes = 0;
+    ring_buffers = 0;
+  }
+};
+
+struct NvmeTelemetryResult {
+  /**
+   * DPARME_ILLEGAL_DATA if the generation changed during the capture,
+   * DPARME_SYS with the error of the sink if it failed
+   */
+  DparmResult result;
+  /**
+   * bytes to capture (header included)
+   */
+  uint64_t total_bytes;
+  /**
+   * bytes passed to the sink
+   */
+  uint64_t written_bytes;
+  /**
+   * Telemetry Host-Initiated Data Generation Number of the header
+   */
+  uint8_t generation;
+  /**
+   * last 512 byte block of data area 1 ~ 4
+   */
+  uint32_t data_area_last_block[4];
+  /**
+   * the generation of the header read after the data differs; the output mixes two snapshots
+   */
+  bool generation_changed;
+};
+
+/**
+ * receives the log in order
+ *
+ * @return zero if successful, otherwise system error code (the capture stops)
+ */
+typedef std::function<int(const void *data, size_t length)> NvmeTelemetrySink;
+
+/**
+ * stream the Telemetry Host-Initiated log (07h) of the controller to the sink
+ *
+ * The header is read first (creating the snapshot if requested), then the data areas chunk by chunk
+ * into a ring of buffers drained by a writer thread, so the drive and the sink work in parallel.
+ * The header is read again at the end to check that the generation did not change.
+ */
+NvmeTelemetryResult captureNvmeTelemetry(DriveHandle *handle, const NvmeTelemetryOptions& options, const NvmeTelemetrySink& sink);
+
+/**
+ * captureNvmeTelemetry writing to a file descriptor
+ */
+NvmeTelemetryResult captureNvmeTelemetry(DriveHandle *handle, const NvmeTelemetryOptions& options, int fd);
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_NVME_TELEMETRY_H_
@@ -21,6 +21,7 @@ extern "C" {
 typedef uint8_t u8_t;
 typedef uint16_t le16_t;
 typedef uint32_t le32_t;
+typedef uint64_t le64_t;
 
 /**
  * NVM_Express_Revision_1.3.pdf
@@ -211,6 +212,9 @@ enum NvmeGetLogPageCommand {
   NVME_NO_LOG_LPO       = 0x0,
   NVME_LOG_ANA_LSP_RGO  = 0x1,
   NVME_TELEM_LSP_CREATE = 0x1,
+  NVME_PEL_LSP_READ = 0x0,
+  NVME_PEL_LSP_ESTABLISH_CONTEXT = 0x1,
+  NVME_PEL_LSP_RELEASE_CONTEXT = 0x2,
 };
 
 /**
@@ -222,6 +226,20 @@ enum NvmeGetLogPageIdentifier {
   NVME_GET_LOG_PAGE_ERROR_INFO = 0x01,
   NVME_GET_LOG_PAGE_SMART = 0x02,
   NVME_GET_LOG_PAGE_FIRMWARE_SLOT_INFO = 0x03,
+  NVME_GET_LOG_PAGE_CHANGED_NS_LIST = 0x04,
+  NVME_GET_LOG_PAGE_TELEMETRY_HOST = 0x07,
+  NVME_GET_LOG_PAGE_TELEMETRY_CTRL = 0x08,
+  NVME_GET_LOG_PAGE_PERSISTENT_EVENT = 0x0d,
+};
+
+/**
+ * NVM_Express_Revision_1.3.pdf
+ * Figure 109 : Identify - CNS Values
+ */
+enum NvmeIdentifyCns {
+  NVME_IDENTIFY_CNS_NS = 0x00,
+  NVME_IDENTIFY_CNS_CTRL = 0x01,
+  NVME_IDENTIFY_CNS_NS_ACTIVE_LIST = 0x02,
 };
 
 /**
@@ -424,6 +442,135 @@ typedef struct nvme_identify_controller {
   u8_t			vs[1024];
 } nvme_identify_controller_t;
 
+/**
+ * NVM_Express_Revision_1.3.pdf
+ * Figure 115 : Identify - LBA Format Data Structure, NVM Command Set Specific
+ */
+typedef struct nvme_lba_format {
+  le16_t			ms;
+  u8_t			lbads;
+  u8_t			rp;
+} nvme_lba_format_t;
+
+/**
+ * NVM_Express_Revision_1.3.pdf
+ * Figure 114 : Identify - Identify Namespace Data Structure, NVM Command Set Specific
+ */
+typedef struct nvme_identify_namespace {
+  le64_t			nsze;
+  le64_t			ncap;
+  le64_t			nuse;
+  u8_t			nsfeat;
+  u8_t			nlbaf;
+  u8_t			flbas;
+  u8_t			mc;
+  u8_t			dpc;
+  u8_t			dps;
+  u8_t			nmic;
+  u8_t			rescap;
+  u8_t			fpi;
+  u8_t			dlfeat;
+  le16_t			nawun;
+  le16_t			nawupf;
+  le16_t			nacwu;
+  le16_t			nabsn;
+  le16_t			nabo;
+  le16_t			nabspf;
+  le16_t			noiob;
+  u8_t			nvmcap[16];
+  u8_t			rsvd64[40];
+  u8_t			nguid[16];
+  u8_t			eui64[8];
+  nvme_lba_format_t	lbaf[16];
+  u8_t			rsvd192[192];
+  u8_t			vs[3712];
+} nvme_identify_namespace_t;
+
+/**
+ * NVM_Express_Revision_1.3.pdf
+ * Figure 94 : Get Log Page - Telemetry Host-Initiated Log (Log Identifier 07h)
+ * The header is followed by the data areas in 512 byte blocks. dalb4 is from NVMe 2.0.
+ */
+typedef struct nvme_telemetry_log_header {
+  u8_t			lpi;
+  u8_t			rsvd1[4];
+  u8_t			ieee[3];
+  le16_t			dalb1;
+  le16_t			dalb2;
+  le16_t			dalb3;
+  u8_t			rsvd14[2];
+  le32_t			dalb4;
+  u8_t			rsvd20[361];
+  u8_t			hostdgn;
+  u8_t			ctrlavail;
+  u8_t			ctrldgn;
+  u8_t			rsnident[128];
+} nvme_telemetry_log_header_t;
+
+/**
+ * NVM_Express_Revision_1.4.pdf
+ * Figure 207 : Persistent Event Log Header (Log Identifier 0Dh)
+ */
+typedef struct nvme_persistent_event_log_header {
+  u8_t			lid;
+  u8_t			rsvd1[3];
+  le32_t			tnev;
+  le64_t			tll;
+  u8_t			rv;
+  u8_t			rsvd17;
+  le16_t			lhl;
+  le64_t			ts;
+  u8_t			poh[16];
+  le64_t			pcc;
+  le16_t			vid;
+  le16_t			ssvid;
+  char			sn[20];
+  char			mn[40];
+  char			subnqn[256];
+  le16_t			gen_number;
+  le32_t			rci;
+  u8_t			rsvd378[102];
+  u8_t			seb[32];
+} nvme_persistent_event_log_header_t;
+
+/**
+ * NVM_Express_Revision_1.4.pdf
+ * Figure 209 : Persistent Event Log Event Format
+ * The event takes ehl + 3 + el bytes; the vendor specific information (vsil bytes) precedes the event data.
+ */
+typedef struct nvme_persistent_event_header {
+  u8_t			etype;
+  u8_t			etype_rev;
+  u8_t			ehl;
+  u8_t			ehai;
+  le16_t			cntlid;
+  le64_t			ets;
+  le16_t			pelpid;
+  u8_t			rsvd16[4];
+  le16_t			vsil;
+  le16_t			el;
+} nvme_persistent_event_header_t;
+
+/**
+ * NVM_Express_Revision_1.4.pdf
+ * Figure 210 : Persistent Event Log Event Types
+ */
+enum NvmePersistentEventType {
+  NVME_PEL_SMART_SNAPSHOT = 0x01,
+  NVME_PEL_FIRMWARE_COMMIT = 0x02,
+  NVME_PEL_TIMESTAMP_CHANGE = 0x03,
+  NVME_PEL_POWER_ON_RESET = 0x04,
+  NVME_PEL_HARDWARE_ERROR = 0x05,
+  NVME_PEL_CHANGE_NAMESPACE = 0x06,
+  NVME_PEL_FORMAT_START = 0x07,
+  NVME_PEL_FORMAT_COMPLETION = 0x08,
+  NVME_PEL_SANITIZE_START = 0x09,
+  NVME_PEL_SANITIZE_COMPLETION = 0x0a,
+  NVME_PEL_SET_FEATURE = 0x0b,
+  NVME_PEL_TELEMETRY_LOG_CREATED = 0x0c,
+  NVME_PEL_THERMAL_EXCURSION = 0x0d,
+};
+
 /**
  * NVM_Express_Revision_1.3.pdf
  * 5.14.1.9.2 Sanitize Status (Log Identifier 81h)
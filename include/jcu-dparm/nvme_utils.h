@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 
+#include "err.h"
 #include "nvme_types.h"
 
 namespace jcu {
@@ -20,6 +21,13 @@ namespace nvme {
 
 const char *nvmeStatusToString(NvmeStatusCode status);
 
+/**
+ * whether a failed data transfer may succeed with a smaller length:
+ * the host rejected the buffer (DPARME_IOCTL_FAILED with EINVAL or ENOMEM)
+ * or the controller the length (Invalid Field in Command)
+ */
+bool isTransferSizeError(const DparmResult& result);
+
 } // namespace nvme
 } // namespace dparm
 } // namespace jcu
@@ -0,0 +1,114 @@
+/**
+ * @file	sense_data.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SENSE_DATA_H_
+#define JCU_DPARM_SENSE_DATA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ata_types.h"
+
+namespace jcu {
+namespace dparm {
+
+enum ScsiSenseKey {
+  kSenseNoSense = 0x0,
+  kSenseRecoveredError = 0x1,
+  kSenseNotReady = 0x2,
+  kSenseMediumError = 0x3,
+  kSenseHardwareError = 0x4,
+  kSenseIllegalRequest = 0x5,
+  kSenseUnitAttention = 0x6,
+  kSenseDataProtect = 0x7,
+  kSenseAbortedCommand = 0xb,
+};
+
+/**
+ * Outcome of a passthrough command, decoded from the SG_IO header and the sense buffer
+ */
+struct AtaCompletion {
+  /**
+   * SCSI transport (linux: sg_io_hdr). zero if not available.
+   */
+  uint8_t scsi_status;
+  uint16_t host_status;
+  uint16_t driver_status;
+  /**
+   * bytes not transferred
+   */
+  int32_t resid;
+  uint32_t duration_ms;
+
+  /**
+   * 0x70/0x71 : fixed, 0x72/0x73 : descriptor, 0 : no sense data
+   */
+  uint8_t sense_response_code;
+  uint8_t sense_key;
+  uint8_t asc;
+  uint8_t ascq;
+
+  /**
+   * ATA Status Return descriptor (descriptor format),
+   * or the ATA PASS-THROUGH information of the fixed format
+   */
+  bool has_ata_return;
+  bool ata_extend;
+  /**
+   * fixed format only: count(15:8) or lba(47:24) is non-zero but not reported
+   */
+  bool ata_upper_unknown;
+  uint8_t ata_status;
+  uint8_t ata_error;
+  uint8_t ata_device;
+  uint16_t ata_count;
+  uint64_t ata_lba;
+
+  AtaCompletion() {
+    memset(this, 0, sizeof(*this));
+  }
+
+  bool isAtaError() const {
+    return has_ata_return && (ata_status & 0x01);
+  }
+
+  /**
+   * @return true if the command may succeed when issued again:
+   *         BUSY / TASK SET FULL status, UNIT ATTENTION, NOT READY (becoming ready) or a host requeue request
+   */
+  bool isTransient() const;
+
+  /**
+   * fill the ATA return fields from a result taskfile (for drivers returning a taskfile instead of sense data)
+   */
+  void setAtaReturn(const ata::ata_tf_t& tf);
+
+  /**
+   * store the ATA return fields to a result taskfile
+   */
+  void getAtaReturn(ata::ata_tf_t *tf) const;
+};
+
+/**
+ * decode a fixed or descriptor format sense buffer in place
+ *
+ * @param sense            (in)  sense buffer
+ * @param length           (in)  valid bytes of the buffer
+ * @param ata_pass_through (in)  the command was ATA PASS-THROUGH (fixed format bytes 3-11 hold ATA registers
+ *                               if ASC/ASCQ is 00h/1Dh)
+ * @param completion       (out) sense_* and ata_* fields are overwritten. Other fields are untouched.
+ * @return false if there is no valid sense data
+ */
+bool decodeSenseData(const unsigned char *sense, size_t length, bool ata_pass_through, AtaCompletion *completion);
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SENSE_DATA_H_
@@ -0,0 +1,132 @@
+/**
+ * @file	trace_ring.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_TRACE_RING_H_
+#define JCU_DPARM_TRACE_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace jcu {
+namespace dparm {
+
+enum TraceRecordType {
+  /**
+   * payload: cdb
+   * result: pack_id
+   */
+  kTraceSgCdb = 1,
+  /**
+   * payload: status, host_status, driver_status, sb_len_wr, sense data (up to 32 bytes)
+   * result: 0, or -errno if the ioctl failed
+   */
+  kTraceSgResult = 2,
+  /**
+   * payload: ata_tf_t after the command
+   * result: return code of sg16 (0, 1 : bad sense, -1 : error)
+   */
+  kTraceTaskfile = 3,
+  /**
+   * payload: TraceNvmeCmd
+   * result: NVMe status, or -errno if the ioctl failed
+   */
+  kTraceNvmeAdmin = 4,
+  kTraceNvmeIo = 5,
+};
+
+struct TraceNvmeCmd {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t reserved;
+  uint32_t nsid;
+  uint32_t cdw10[6];
+};
+
+/**
+ * One fixed-size trace record
+ */
+struct TraceRecord {
+  /**
+   * position since the ring was created
+   */
+  uint64_t index;
+  /**
+   * TraceRing::now() when the command was issued
+   */
+  uint64_t timestamp_ns;
+  uint32_t duration_us;
+  int32_t result;
+  uint16_t type;
+  uint16_t length;
+  uint8_t payload[36];
+};
+
+/**
+ * Lock-free ring of binary trace records
+ *
+ * record() takes no lock, allocates nothing and formats nothing; the oldest records are overwritten.
+ * Records are rendered to text afterwards by decodeTraceRecords().
+ * record() and snapshot() may be called from any thread.
+ */
+class TraceRing {
+ private:
+  struct Slot {
+    // 2 * index + 1 while writing, 2 * index + 2 when published
+    std::atomic<uint64_t> sequence;
+    TraceRecord record;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<uint64_t> head_;
+
+ public:
+  /**
+   * @param capacity (in) number of records. rounded up to a power of two.
+   */
+  explicit TraceRing(size_t capacity);
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /**
+   * @param payload (in) truncated to sizeof(TraceRecord::payload)
+   */
+  void record(TraceRecordType type, uint64_t timestamp_ns, uint32_t duration_us, int32_t result, const void *payload, size_t length);
+
+  /**
+   * copy the published records, oldest first. Records being written are skipped.
+   */
+  void snapshot(std::vector<TraceRecord>& records) const;
+
+  /**
+   * monotonic clock in nanoseconds
+   */
+  static uint64_t now();
+};
+
+/**
+ * render records to text, one line per record
+ *
+ * @param records (in)  records, e.g. a TraceRing::snapshot or a binary dump of it
+ * @param count   (in)  number of records
+ * @param text    (out) appended
+ */
+void decodeTraceRecords(const TraceRecord *records, size_t count, std::string& text);
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_TRACE_RING_H_
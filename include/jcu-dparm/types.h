@@ -18,11 +18,21 @@
 #include <list>
 #include <vector>
 #include <functional>
+#include <memory>
+#include <utility>
 
 #include "err.h"
 #include "ata_types.h"
 #include "nvme_types.h"
 
+#if defined(__GNUC__) || defined(__clang__)
+#define JCU_DPARM_DEPRECATED(message) __attribute__((deprecated(message)))
+#elif defined(_MSC_VER)
+#define JCU_DPARM_DEPRECATED(message) __declspec(deprecated(message))
+#else
+#define JCU_DPARM_DEPRECATED(message)
+#endif
+
 namespace jcu {
 namespace dparm {
 
@@ -35,9 +45,104 @@ enum VerboseLoggingLevel {
   kVerboseDebug = 3
 };
 
+enum CommandTimeoutClass {
+  /**
+   * IDENTIFY DEVICE and INQUIRY issued by open()
+   */
+  kTimeoutIdentify = 0,
+  /**
+   * SMART and log reads
+   */
+  kTimeoutSmart,
+  /**
+   * SECURITY PROTOCOL IN/OUT and TRUSTED SEND/RECEIVE (TCG).
+   * Built-in: 5 seconds, and 15 seconds for the ATA TRUSTED fallback of drivers
+   * without SECURITY PROTOCOL passthrough. A configured value applies to both.
+   */
+  kTimeoutSecurity,
+  /**
+   * commands issued with timeout_secs 0
+   */
+  kTimeoutDefault,
+  kTimeoutClassCount
+};
+
+/**
+ * Timeouts and retries of the passthrough commands of a handle.
+ * Zero-initialized means the built-in timeouts without retry.
+ */
+struct CommandRetryPolicy {
+  /**
+   * seconds per CommandTimeoutClass. 0 : built-in value
+   */
+  unsigned int timeout_secs[kTimeoutClassCount];
+  /**
+   * additional attempts after a transient error (UNIT ATTENTION, BUSY, TASK SET FULL, becoming ready, host requeue)
+   */
+  unsigned int max_retries;
+  /**
+   * delay before the first retry in milliseconds, doubled on each further retry
+   */
+  unsigned int backoff_ms;
+  /**
+   * limit of all attempts of one command in milliseconds.
+   * The timeout of each attempt is shortened to the time left, and no retry starts with less than
+   * 1 second left.
+   * 0 : unlimited
+   */
+  unsigned int deadline_ms;
+
+  unsigned int getTimeoutSecs(CommandTimeoutClass timeout_class) const {
+    static const unsigned int kBuiltin[kTimeoutClassCount] = {3, 15, 5, 15};
+    return timeout_secs[timeout_class] ? timeout_secs[timeout_class] : kBuiltin[timeout_class];
+  }
+};
+
 struct DriveFactoryOptions {
   DebugPutsType debug_puts;
   VerboseLoggingLevel verbose;
+
+  /**
+   * Linux only.
+   * File to persist IDENTIFY and TCG Discovery 0 results across processes.
+   * An entry is reused only when the device number and the sysfs wwid/serial are unchanged,
+   * then open() does not probe drivers nor run INQUIRY, and NVMe drives get no Identify Controller.
+   * ATA drives still get IDENTIFY DEVICE, since its security words (frozen, locked) change across
+   * reboots; the TCG Locking state is read again as well.
+   * Empty to disable.
+   */
+  std::string identity_cache_file;
+
+  /**
+   * Defer TCG Discovery 0 from open() until DriveHandle::runPendingTcgDiscovery() or getTcgDevice().
+   * enumDrives and probeDrive still run it to fill the tcg_* fields.
+   * Saves a security receive command on each open for callers that never use TCG.
+   */
+  bool lazy_tcg_discovery;
+
+  /**
+   * Number of records of the binary trace ring of each handle (DriveHandle::getTraceRing).
+   * Passthrough commands are recorded without formatting, so it can stay enabled in production.
+   * 0 to disable.
+   */
+  size_t trace_records;
+
+  /**
+   * Linux SG driver: timeouts, retries and deadline of passthrough commands.
+   * Linux NVMe driver: timeout of commands issued without timeout_ms (only if set).
+   */
+  CommandRetryPolicy retry_policy;
+
+  DriveFactoryOptions()
+      : verbose(kVerboseDisabled), lazy_tcg_discovery(false), trace_records(0), retry_policy() {
+  }
+
+  /**
+   * keeps the former aggregate initialization, e.g. DriveFactoryOptions{debug_puts, kVerboseInfo}
+   */
+  DriveFactoryOptions(DebugPutsType debug_puts, VerboseLoggingLevel verbose = kVerboseDisabled)
+      : debug_puts(std::move(debug_puts)), verbose(verbose), lazy_tcg_discovery(false), trace_records(0), retry_policy() {
+  }
 };
 
 enum DrivingType {
@@ -46,6 +151,84 @@ enum DrivingType {
   kDrivingNvme,
 };
 
+/**
+ * one segment of a scatter-gather data buffer (same layout as struct iovec)
+ */
+struct DparmIoVec {
+  void *base;
+  size_t length;
+};
+
+/**
+ * TCG Discovery 0 feature descriptors (4-byte header included) packed in one buffer
+ */
+class TcgFeatureTable {
+ private:
+  std::vector<unsigned char> data_;
+
+  static uint16_t codeOf(const unsigned char *descriptor) {
+    return (uint16_t) ((descriptor[0] << 8) | descriptor[1]);
+  }
+
+  static size_t lengthOf(const unsigned char *descriptor) {
+    return (size_t) descriptor[3] + 4;
+  }
+
+ public:
+  bool empty() const {
+    return data_.empty();
+  }
+
+  void clear() {
+    data_.clear();
+  }
+
+  /**
+   * @param descriptor (in) descriptor. Ignored if malformed or the feature code already exists.
+   * @param length     (in) descriptor length (header included)
+   */
+  void add(const unsigned char *descriptor, size_t length) {
+    if (length < 4 || length != lengthOf(descriptor) || find(codeOf(descriptor))) {
+      return;
+    }
+    data_.insert(data_.end(), descriptor, descriptor + length);
+  }
+
+  /**
+   * @return descriptor, or nullptr if not found
+   */
+  const unsigned char *find(uint16_t feature_code, size_t *length = nullptr) const {
+    for (size_t pos = 0; pos + 4 <= data_.size(); pos += lengthOf(&data_[pos])) {
+      if (codeOf(&data_[pos]) == feature_code) {
+        if (length) *length = lengthOf(&data_[pos]);
+        return &data_[pos];
+      }
+    }
+    return nullptr;
+  }
+
+  template<typename F>
+  void forEach(F fn) const {
+    for (size_t pos = 0; pos + 4 <= data_.size(); pos += lengthOf(&data_[pos])) {
+      fn(codeOf(&data_[pos]), &data_[pos], lengthOf(&data_[pos]));
+    }
+  }
+
+  const std::vector<unsigned char>& raw() const {
+    return data_;
+  }
+
+  /**
+   * replace with a buffer of raw()
+   */
+  void assignRaw(const std::vector<unsigned char>& raw) {
+    data_.clear();
+    for (size_t pos = 0; pos + 4 <= raw.size() && pos + lengthOf(&raw[pos]) <= raw.size(); pos += lengthOf(&raw[pos])) {
+      add(&raw[pos], lengthOf(&raw[pos]));
+    }
+  }
+};
+
 struct DriveInfo {
   std::string device_path;
   DparmResult open_result;
@@ -56,15 +239,15 @@ struct DriveInfo {
   std::string serial;
   std::string firmware_revision;
   char raw_serial[20];
+  std::string wwid; // Linux sysfs only
 
   int windows_dev_num;
-  std::string linux_dev_name; //TODO: Not implemented yet
+  std::string linux_dev_name; // Filled by enumDrives
 
-  ata::ata_identify_device_data_t ata_identify;
-  nvme::nvme_identify_controller_t nvme_identify_ctrl;
 
   bool is_ssd;
   int ssd_check_weight;
+  bool is_removable; // Linux sysfs only
 
   bool smart_enabled;
 
@@ -79,7 +262,7 @@ struct DriveInfo {
   int support_sanitize_overwrite;
 
   /**
-   * -1 : Not determined (OS Error)
+   * -1 : Not determined (OS Error, or Discovery 0 deferred: DriveHandle::isTcgDiscoveryPending())
    * 0 : Not supported
    * 1 : Supported
    */
@@ -94,17 +277,16 @@ struct DriveInfo {
   bool tcg_single_user_mode;
   bool tcg_datastore;
 
-  std::map<uint16_t, std::vector<unsigned char>> tcg_raw_features;
+  TcgFeatureTable tcg_features;
 
   int64_t total_capacity;
 
   DriveInfo() {
     driving_type = kDrivingUnknown;
     windows_dev_num = -1;
-    memset(&ata_identify, 0, sizeof(ata_identify));
-    memset(&nvme_identify_ctrl, 0, sizeof(nvme_identify_ctrl));
     is_ssd = false;
     ssd_check_weight = 0;
+    is_removable = false;
     smart_enabled = false;
     support_sanitize_crypto_erase = false;
     support_sanitize_block_erase = false;
@@ -120,6 +302,213 @@ struct DriveInfo {
     tcg_datastore = false;
     total_capacity = -1;
   }
+
+  /**
+   * IDENTIFY DEVICE data of an ATA drive. All zero if not available.
+   */
+  const ata::ata_identify_device_data_t& getAtaIdentify() const {
+    static const ata::ata_identify_device_data_t empty = {0};
+    return ata_identify_ ? *ata_identify_ : empty;
+  }
+
+  /**
+   * IDENTIFY CONTROLLER data of an NVMe drive. All zero if not available.
+   */
+  const nvme::nvme_identify_controller_t& getNvmeIdentifyCtrl() const {
+    static const nvme::nvme_identify_controller_t empty = {0};
+    return nvme_identify_ctrl_ ? *nvme_identify_ctrl_ : empty;
+  }
+
+  bool hasAtaIdentify() const {
+    return ata_identify_.operator bool();
+  }
+
+  bool hasNvmeIdentifyCtrl() const {
+    return nvme_identify_ctrl_.operator bool();
+  }
+
+  void setAtaIdentify(std::shared_ptr<const ata::ata_identify_device_data_t> data) {
+    ata_identify_ = std::move(data);
+  }
+
+  void setNvmeIdentifyCtrl(std::shared_ptr<const nvme::nvme_identify_controller_t> data) {
+    nvme_identify_ctrl_ = std::move(data);
+  }
+
+  /**
+   * @deprecated replaces the former ata_identify field; use getAtaIdentify()
+   * Source break: `info.ata_identify.x` is now `info.ata_identify().x`, and it can not be assigned.
+   */
+  JCU_DPARM_DEPRECATED("use getAtaIdentify()")
+  const ata::ata_identify_device_data_t& ata_identify() const {
+    return getAtaIdentify();
+  }
+
+  /**
+   * @deprecated replaces the former nvme_identify_ctrl field; use getNvmeIdentifyCtrl()
+   * Source break: `info.nvme_identify_ctrl.x` is now `info.nvme_identify_ctrl().x`, and it can not be assigned.
+   */
+  JCU_DPARM_DEPRECATED("use getNvmeIdentifyCtrl()")
+  const nvme::nvme_identify_controller_t& nvme_identify_ctrl() const {
+    return getNvmeIdentifyCtrl();
+  }
+
+  /**
+   * @deprecated replaces the former tcg_raw_features field; use tcg_features.
+   * Builds a copy of the descriptors keyed by feature code.
+   */
+  JCU_DPARM_DEPRECATED("use tcg_features")
+  std::map<uint16_t, std::vector<unsigned char>> tcg_raw_features() const {
+    std::map<uint16_t, std::vector<unsigned char>> features;
+    tcg_features.forEach([&features](uint16_t feature_code, const unsigned char *data, size_t length) -> void {
+      features[feature_code].assign(data, data + length);
+    });
+    return features;
+  }
+
+ private:
+  // Only the one of the driving type is allocated, and shared by copies of DriveInfo.
+  std::shared_ptr<const ata::ata_identify_device_data_t> ata_identify_;
+  std::shared_ptr<const nvme::nvme_identify_controller_t> nvme_identify_ctrl_;
+};
+
+/**
+ * NVMe namespace from Identify Namespace (CNS 00h)
+ */
+struct NvmeNamespaceInfo {
+  uint32_t nsid;
+
+  /**
+   * NSZE, NCAP and NUSE in logical blocks.
+   * utilization_lbas is the value of the last Identify and changes with writes and deallocations.
+   */
+  uint64_t size_lbas;
+  uint64_t capacity_lbas;
+  uint64_t utilization_lbas;
+
+  /**
+   * LBA format in use (FLBAS)
+   */
+  uint8_t lba_format;
+  uint32_t lba_bytes;
+  uint16_t metadata_bytes;
+  /**
+   * true : metadata is transferred at the end of each logical block, false : in a separate buffer
+   */
+  bool metadata_extended;
+
+  NvmeNamespaceInfo() {
+    nsid = 0;
+    size_lbas = 0;
+    capacity_lbas = 0;
+    utilization_lbas = 0;
+    lba_format = 0;
+    lba_bytes = 0;
+    metadata_bytes = 0;
+    metadata_extended = false;
+  }
+
+  /**
+   * whole Identify Namespace data (LBA formats, NGUID, EUI64, protection, ...). All zero if not available.
+   */
+  const nvme::nvme_identify_namespace_t& getIdentify() const {
+    static const nvme::nvme_identify_namespace_t empty = {0};
+    return identify_ ? *identify_ : empty;
+  }
+
+  void setIdentify(std::shared_ptr<const nvme::nvme_identify_namespace_t> data) {
+    identify_ = std::move(data);
+  }
+
+ private:
+  // shared by copies of NvmeNamespaceInfo
+  std::shared_ptr<const nvme::nvme_identify_namespace_t> identify_;
+};
+
+enum EnumDrivesLevel {
+  /**
+   * Open each drive: IDENTIFY (or INQUIRY) and TCG Discovery 0
+   */
+  kEnumFull = 0,
+  /**
+   * Linux only (other platforms use kEnumFull).
+   * No passthrough command is issued. Only the following fields are filled from sysfs:
+   * device_path, linux_dev_name, driving_type, model, serial, firmware_revision,
+   * wwid, total_capacity, is_ssd, is_removable
+   */
+  kEnumBasic = 1,
+};
+
+/**
+ * Drives which do not match are excluded from the enumeration.
+ *
+ * Each criterion is checked at the first stage where its data is known,
+ * so a rejected drive skips the remaining probe steps:
+ *   1. sysfs    : Linux only, before the device is opened
+ *   2. identify : after IDENTIFY, before INQUIRY and TCG Discovery 0
+ *   3. tcg      : after TCG Discovery 0
+ */
+struct EnumDrivesFilter {
+  /**
+   * kDrivingUnknown : any
+   */
+  DrivingType driving_type;
+  /**
+   * Linux only
+   */
+  bool exclude_removable;
+  /**
+   * substring of the model. empty : any
+   */
+  std::string model_contains;
+  /**
+   * bytes. 0 : no limit. Drives of unknown capacity pass.
+   */
+  int64_t min_capacity;
+  int64_t max_capacity;
+  /**
+   * only tcg_support == 1
+   */
+  bool tcg_only;
+
+  /**
+   * custom predicates of each stage. Return false to exclude the drive.
+   * sysfs_predicate gets the fields listed in kEnumBasic.
+   */
+  std::function<bool(const DriveInfo&)> sysfs_predicate;
+  std::function<bool(const DriveInfo&)> identify_predicate;
+  std::function<bool(const DriveInfo&)> tcg_predicate;
+
+  EnumDrivesFilter() {
+    driving_type = kDrivingUnknown;
+    exclude_removable = false;
+    min_capacity = 0;
+    max_capacity = 0;
+    tcg_only = false;
+  }
+
+  bool needsTcgStage() const {
+    return tcg_only || tcg_predicate;
+  }
+};
+
+struct EnumDrivesOptions {
+  EnumDrivesLevel level;
+
+  EnumDrivesFilter filter;
+
+  /**
+   * Maximum number of drives probed concurrently.
+   * 0 or 1 : probe one by one
+   *
+   * The order of the result list does not depend on this value.
+   */
+  int parallel;
+
+  EnumDrivesOptions() {
+    level = kEnumFull;
+    parallel = 0;
+  }
 };
 
 struct VolumeInfo {
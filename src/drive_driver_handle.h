@@ -16,6 +16,9 @@
 #include <jcu-dparm/types.h>
 #include <jcu-dparm/ata_types.h>
 #include <jcu-dparm/nvme_types.h>
+#include <jcu-dparm/trace_ring.h>
+#include <jcu-dparm/latency_stats.h>
+#include <jcu-dparm/sense_data.h>
 
 namespace jcu {
 namespace dparm {
@@ -46,6 +49,33 @@ class DriveDriverHandle {
 
   virtual std::string getDriverName() const = 0;
 
+  /**
+   * @param trace_ring (in) nullable. owned by the DriveHandle.
+   */
+  virtual void setTraceRing(TraceRing* trace_ring) {}
+
+  /**
+   * @param latency_stats (in) nullable. owned by the DriveHandle.
+   */
+  virtual void setLatencyStats(LatencyStats* latency_stats) {}
+
+  /**
+   * see DriveHandle::setReadZeroing
+   */
+  virtual void setReadZeroing(bool enabled) {}
+
+  virtual int getLastResid() const {
+    return 0;
+  }
+
+  /**
+   * largest data transfer of one passthrough command allowed by the host (linux: max_hw_sectors_kb)
+   * @return 0 if unknown
+   */
+  virtual uint32_t getMaxTransferBytes() const {
+    return 0;
+  }
+
   virtual void mergeDriveInfo(DriveInfo& drive_info) const = 0;
 
   DrivingType getDrivingType() const {
@@ -105,6 +135,59 @@ class DriveDriverHandle {
     return { DPARME_NOT_SUPPORTED, 0 };
   }
 
+  /**
+   * doTaskfileCmd with the decoded outcome.
+   * Drivers without sense data fill only the ATA return from the result taskfile.
+   */
+  virtual DparmResult doTaskfileCmdWithCompletion(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      void *data,
+      unsigned int data_bytes,
+      unsigned int timeout_secs,
+      AtaCompletion *completion
+  ) {
+    DparmResult result = doTaskfileCmd(rw, dma, tf, data, data_bytes, timeout_secs);
+    *completion = AtaCompletion();
+    if (result.code == DPARME_OK || result.code == DPARME_ATA_FAILED) {
+      completion->setAtaReturn(*tf);
+    }
+    return result;
+  }
+
+  /**
+   * doAtaCmdV and doTaskfileCmdV take the segments without a staging copy
+   */
+  virtual bool driverIsVectoredCmdSupported() const {
+    return false;
+  }
+
+  virtual DparmResult doAtaCmdV(
+      int rw,
+      unsigned char* cdb,
+      unsigned int cdb_bytes,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      int pack_id,
+      unsigned int timeout_secs,
+      unsigned char *sense_buf,
+      unsigned int sense_buf_bytes
+  ) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
+  virtual DparmResult doTaskfileCmdV(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      unsigned int timeout_secs
+  ) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
   virtual bool driverIsNvmeAdminPassthruSupported() const {
     return false;
   }
@@ -125,10 +208,33 @@ class DriveDriverHandle {
     return false;
   }
 
+  /**
+   * see DriveHandle::getNvmeNamespaceId
+   */
+  virtual uint32_t getNvmeNamespaceId() const {
+    return 0;
+  }
+
   virtual DparmReturn<int> doNvmeIo(nvme::nvme_user_io_t* io) {
     return { DPARME_NOT_SUPPORTED, 0 };
   }
 
+  virtual bool driverIsNvmePassthru64Supported() const {
+    return false;
+  }
+
+  virtual DparmReturn<int> doNvmeAdminPassthru64(nvme::nvme_passthru_cmd64_t* cmd) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
+  virtual DparmReturn<int> doNvmeIoPassthru64(nvme::nvme_passthru_cmd64_t* cmd) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
+  virtual DparmReturn<int> doNvmeIoPassthru64V(nvme::nvme_passthru_cmd64_t* cmd, const DparmIoVec *iov, unsigned int iov_count) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
   virtual bool driverHasSpecificNvmeGetLogPage() const {
     return false;
   }
@@ -0,0 +1,87 @@
+/**
+ * @file	drive_filter.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "drive_filter.h"
+
+namespace jcu {
+namespace dparm {
+
+static bool matchCapacity(const EnumDrivesFilter& filter, const DriveInfo& drive_info) {
+  if (drive_info.total_capacity < 0) {
+    return true;
+  }
+  if (filter.min_capacity && drive_info.total_capacity < filter.min_capacity) {
+    return false;
+  }
+  if (filter.max_capacity && drive_info.total_capacity > filter.max_capacity) {
+    return false;
+  }
+  return true;
+}
+
+static bool matchModel(const EnumDrivesFilter& filter, const DriveInfo& drive_info) {
+  return filter.model_contains.empty() || (drive_info.model.find(filter.model_contains) != std::string::npos);
+}
+
+bool matchDriveFilter(const EnumDrivesFilter& filter, DriveFilterStage stage, const DriveInfo& drive_info) {
+  switch (stage) {
+    case kFilterStageSysfs:
+      // sysfs can not tell the driving type of every drive (e.g. SAS), and the model of
+      // ATA drives behind libata is truncated to 16 characters, so only reject on known values.
+      if (filter.driving_type != kDrivingUnknown && drive_info.driving_type != kDrivingUnknown &&
+          drive_info.driving_type != filter.driving_type) {
+        return false;
+      }
+      if (filter.exclude_removable && drive_info.is_removable) {
+        return false;
+      }
+      if (drive_info.driving_type == kDrivingNvme && !matchModel(filter, drive_info)) {
+        return false;
+      }
+      if (!matchCapacity(filter, drive_info)) {
+        return false;
+      }
+      if (filter.sysfs_predicate && !filter.sysfs_predicate(drive_info)) {
+        return false;
+      }
+      return true;
+
+    case kFilterStageIdentify:
+      if (filter.driving_type != kDrivingUnknown && drive_info.driving_type != filter.driving_type) {
+        return false;
+      }
+      // an empty model may still be filled by INQUIRY
+      if (!drive_info.model.empty() && !matchModel(filter, drive_info)) {
+        return false;
+      }
+      if (!matchCapacity(filter, drive_info)) {
+        return false;
+      }
+      if (filter.identify_predicate && !filter.identify_predicate(drive_info)) {
+        return false;
+      }
+      return true;
+
+    case kFilterStageTcg:
+      if (!matchModel(filter, drive_info)) {
+        return false;
+      }
+      if (filter.tcg_only && drive_info.tcg_support != 1) {
+        return false;
+      }
+      if (filter.tcg_predicate && !filter.tcg_predicate(drive_info)) {
+        return false;
+      }
+      return true;
+  }
+  return true;
+}
+
+} // namespace dparm
+} // namespace jcu
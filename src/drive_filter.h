@@ -0,0 +1,34 @@
+/**
+ * @file	drive_filter.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_DRIVE_FILTER_H_
+#define JCU_DPARM_SRC_DRIVE_FILTER_H_
+
+#include <jcu-dparm/types.h>
+
+namespace jcu {
+namespace dparm {
+
+enum DriveFilterStage {
+  kFilterStageSysfs = 0,
+  kFilterStageIdentify,
+  kFilterStageTcg,
+};
+
+/**
+ * check the criteria of EnumDrivesFilter known at the stage
+ *
+ * @return false if the drive is excluded
+ */
+bool matchDriveFilter(const EnumDrivesFilter& filter, DriveFilterStage stage, const DriveInfo& drive_info);
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_DRIVE_FILTER_H_
@@ -19,7 +19,7 @@ namespace dparm {
 
 uint64_t DriveHandleBase::getAtaLbaCapacity() {
   auto driver_handle = getDriverHandle();
-  const auto& ata_identify = drive_info_.ata_identify;
+  const auto& ata_identify = drive_info_.getAtaIdentify();
   uint64_t capacity;
 
   if (driver_handle->getDrivingType() != kDrivingAtapi) {
@@ -54,14 +54,16 @@ DparmReturn<std::vector<uint16_t>> DriveHandleBase::readDcoIdentify() {
   ata::tf_init(&tf, ata::ATA_OP_DCO, 0, 1);
   tf.lob.feat = 0xc2;
 
-  dr = driver_handle->doTaskfileCmd(0, -1, &tf, data_buf.data(), data_buf.size() * sizeof(uint16_t), 15);
+  InternalReadScope read_scope(this);
+
+  dr = driver_handle->doTaskfileCmd(0, -1, &tf, data_buf.data(), data_buf.size() * sizeof(uint16_t), options_.retry_policy.getTimeoutSecs(kTimeoutDefault));
 
   return { dr, data_buf };
 }
 
 DparmReturn<uint64_t> DriveHandleBase::readNativeMaxSectors() {
   auto driver_handle = getDriverHandle();
-  const auto& ata_identify = drive_info_.ata_identify;
+  const auto& ata_identify = drive_info_.getAtaIdentify();
   DparmResult dr;
   ata::ata_tf_t tf;
   uint64_t max_sectors = 0;
@@ -82,7 +84,7 @@ DparmReturn<uint64_t> DriveHandleBase::readNativeMaxSectors() {
     tf.dev = 0x01;
   }
 
-  dr = driver_handle->doTaskfileCmd(0, -1, &tf, NULL, 0, 15);
+  dr = driver_handle->doTaskfileCmd(0, -1, &tf, NULL, 0, options_.retry_policy.getTimeoutSecs(kTimeoutDefault));
   if (tf.command == ata::ATA_OP_READ_NATIVE_MAX) {
     max_sectors = ((((uint64_t)tf.dev) & 0x0f) << 24) | (((uint64_t)tf.lob.lbah) << 16) | (((uint64_t)tf.lob.lbam) << 8) | (((uint64_t)tf.lob.lbal)) + 1;
   } else {
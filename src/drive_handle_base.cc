@@ -10,7 +10,10 @@
 #include <string.h>
 #include <stdarg.h>
 
+#include <jcu-dparm/nvme_utils.h>
+
 #include "drive_handle_base.h"
+#include "drive_filter.h"
 
 #include "intl_utils.h"
 
@@ -22,29 +25,53 @@
 namespace jcu {
 namespace dparm {
 
+/**
+ * Get Log Page transfer size when neither the controller nor the host limits it
+ */
+static const uint64_t kNvmeMaxLogChunkBytes = 1024 * 1024;
+
 DriveHandleBase::DriveHandleBase(const DriveFactoryOptions& options, const std::string& device_path, const DparmResult& open_result)
-    : options_(options), device_path_(device_path)
+    : options_(options), device_path_(device_path), tcg_discovery_pending_(false), read_zeroing_(true), nvme_log_chunk_bytes_(0),
+      nvme_namespaces_loaded_(false)
 {
   drive_info_.device_path = device_path_;
   drive_info_.open_result = open_result;
+  if (options_.trace_records) {
+    trace_ring_.reset(new TraceRing(options_.trace_records));
+  }
 }
 
 int DriveHandleBase::dbgprintf(const char* fmt, ...) {
-  std::vector<char> buffer(strlen(fmt) + 256);
+  if (!options_.debug_puts) {
+    return 0;
+  }
+  char buffer[256];
   va_list args;
   va_start(args, fmt);
-  int length = vsnprintf(buffer.data(), buffer.size(), fmt, args);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
   va_end(args);
-  if (options_.debug_puts) {
-    return options_.debug_puts(std::string(buffer.data(), length));
+  if (length < 0) {
+    return 0;
   }
-  return 0;
+  if ((size_t) length < sizeof(buffer)) {
+    return options_.debug_puts(std::string(buffer, length));
+  }
+  std::vector<char> large(length + 1);
+  va_start(args, fmt);
+  vsnprintf(large.data(), large.size(), fmt, args);
+  va_end(args);
+  return options_.debug_puts(std::string(large.data(), length));
 }
 
-void DriveHandleBase::afterOpen() {
+bool DriveHandleBase::afterOpen(const EnumDrivesFilter *filter) {
   auto driver_handle = getDriverHandle();
+  driver_handle->setTraceRing(trace_ring_.get());
+  driver_handle->setLatencyStats(&latency_stats_);
   drive_info_.driving_type = driver_handle->getDrivingType();
   parseIdentifyDevice();
+  if (filter && !matchDriveFilter(*filter, kFilterStageIdentify, drive_info_)) {
+    return false;
+  }
   if (drive_info_.serial.empty()) {
     auto res = driver_handle->inquiryDeviceInfo();
     if (res.isOk()) {
@@ -52,7 +79,56 @@ void DriveHandleBase::afterOpen() {
       drive_info_.model = res.value.product_identification;
     }
   }
-  tcgDiscovery0();
+  if (options_.lazy_tcg_discovery && !(filter && filter->needsTcgStage())) {
+    tcg_discovery_pending_ = true;
+    drive_info_.tcg_support = -1;
+  } else {
+    tcgDiscovery0();
+  }
+  return !filter || matchDriveFilter(*filter, kFilterStageTcg, drive_info_);
+}
+
+bool DriveHandleBase::afterOpen(const IdentityCacheEntry& cached, const EnumDrivesFilter *filter) {
+  auto driver_handle = getDriverHandle();
+  driver_handle->setTraceRing(trace_ring_.get());
+  driver_handle->setLatencyStats(&latency_stats_);
+  drive_info_.driving_type = driver_handle->getDrivingType();
+  parseIdentifyDevice();
+  if (drive_info_.serial.empty()) {
+    drive_info_.serial = cached.serial;
+    drive_info_.model = cached.model;
+  }
+  if (filter && !matchDriveFilter(*filter, kFilterStageIdentify, drive_info_)) {
+    return false;
+  }
+  tcg_discovery_pending_ = false;
+  drive_info_.tcg_support = cached.tcg_support;
+  TcgFeatureTable cached_features;
+  cached_features.assignRaw(cached.tcg_features);
+  if (cached_features.find(tcg::kFcLocking)) {
+    // Locked and MBR Done change at runtime; only Discovery 0 knows the current state
+    if (options_.lazy_tcg_discovery && !(filter && filter->needsTcgStage())) {
+      tcg_discovery_pending_ = true;
+      drive_info_.tcg_support = -1;
+    } else {
+      tcgDiscovery0();
+    }
+  } else {
+    cached_features.forEach([this](uint16_t feature_code, const unsigned char *data, size_t length) -> void {
+      applyTcgFeature(feature_code, data, length);
+    });
+  }
+  return !filter || matchDriveFilter(*filter, kFilterStageTcg, drive_info_);
+}
+
+void DriveHandleBase::exportIdentity(IdentityCacheEntry& entry) const {
+  auto driver_handle = getDriverHandle();
+  entry.driver_name = driver_handle->getDriverName();
+  entry.nvme_identify = driver_handle->getNvmeIdentifyDeviceBuf();
+  entry.model = drive_info_.model;
+  entry.serial = drive_info_.serial;
+  entry.tcg_support = drive_info_.tcg_support;
+  entry.tcg_features = drive_info_.tcg_features.raw();
 }
 
 int DriveHandleBase::parseIdentifyDevice() {
@@ -71,7 +147,7 @@ int DriveHandleBase::parseIdentifyDevice() {
 
     memcpy(&data, raw.data(), sizeof(data));
 
-    drive_info_.ata_identify = data;
+    drive_info_.setAtaIdentify(std::make_shared<ata::ata_identify_device_data_t>(data));
 
     if (data.nominal_media_rotation_rate == 0 || data.nominal_media_rotation_rate == 1) {
       ssd_check_weight++;
@@ -112,7 +188,7 @@ int DriveHandleBase::parseIdentifyDevice() {
     }
 
     memcpy(&data, raw.data(), sizeof(data));
-    drive_info_.nvme_identify_ctrl = data;
+    drive_info_.setNvmeIdentifyCtrl(std::make_shared<nvme::nvme_identify_controller_t>(data));
 
     memcpy(drive_info_.raw_serial, data.sn, sizeof(drive_info_.raw_serial));
     drive_info_.serial = intl::readStringRange((const unsigned char *) data.sn, 0, sizeof(data.sn), true);
@@ -158,6 +234,35 @@ DparmResult DriveHandleBase::doNvmeGetLogPageCmd(
   return getDriverHandle()->doNvmeAdminPassthru(&cmd);
 }
 
+uint32_t DriveHandleBase::getNvmeLogChunkBytes() {
+  if (nvme_log_chunk_bytes_) {
+    return nvme_log_chunk_bytes_;
+  }
+
+  uint64_t chunk_bytes = 4096;
+  if (drive_info_.hasNvmeIdentifyCtrl()) {
+    /*
+     * MDTS is a power of two in units of CAP.MPSMIN, which is only in the controller registers.
+     * 4k is the smallest memory page size and the one of practically all controllers.
+     * 0 means no limit.
+     */
+    uint8_t mdts = drive_info_.getNvmeIdentifyCtrl().mdts;
+    chunk_bytes = kNvmeMaxLogChunkBytes;
+    if (mdts && mdts < 20 && (4096ULL << mdts) < chunk_bytes) {
+      chunk_bytes = 4096ULL << mdts;
+    }
+    uint32_t host_max = getDriverHandle()->getMaxTransferBytes();
+    if (host_max && host_max < chunk_bytes) {
+      chunk_bytes = host_max & ~4095U;
+    }
+    if (chunk_bytes < 4096) {
+      chunk_bytes = 4096;
+    }
+  }
+  nvme_log_chunk_bytes_ = (uint32_t) chunk_bytes;
+  return nvme_log_chunk_bytes_;
+}
+
 DparmResult DriveHandleBase::doNvmeGetLogPage(uint32_t nsid, uint8_t log_id, bool rae, uint32_t data_len, void *data) {
   auto driver_handle = getDriverHandle();
   if (driver_handle->driverHasSpecificNvmeGetLogPage()) {
@@ -166,21 +271,30 @@ DparmResult DriveHandleBase::doNvmeGetLogPage(uint32_t nsid, uint8_t log_id, boo
 
   uint32_t offset = 0, xfer_len = data_len;
   uint8_t *ptr = (uint8_t*)data;
+  uint32_t chunk_bytes = getNvmeLogChunkBytes();
   DparmResult ret;
 
-  /*
-   * 4k is the smallest possible transfer unit, so by
-   * restricting ourselves for 4k transfers we avoid having
-   * to check the MDTS value of the controller.
-   */
   do {
     xfer_len = data_len - offset;
-    if (xfer_len > 4096)
-      xfer_len = 4096;
+    if (xfer_len > chunk_bytes)
+      xfer_len = chunk_bytes;
 
     ret = doNvmeGetLogPageCmd(nsid, log_id, nvme::NVME_NO_LOG_LSP, offset, 0, rae, 0, xfer_len, ptr);
-    if (!ret.isOk())
+    if (!ret.isOk()) {
+      if (xfer_len > 4096 && nvme::isTransferSizeError(ret)) {
+        /*
+         * 4k is the smallest possible transfer unit. Retry the chunk and
+         * the rest of the log with it. A host limit stays for this drive;
+         * Invalid Field may be about this log page only.
+         */
+        chunk_bytes = 4096;
+        if (ret.code == DPARME_IOCTL_FAILED) {
+          nvme_log_chunk_bytes_ = chunk_bytes;
+        }
+        continue;
+      }
       break;
+    }
 
     offset += xfer_len;
     ptr += xfer_len;
@@ -191,7 +305,9 @@ DparmResult DriveHandleBase::doNvmeGetLogPage(uint32_t nsid, uint8_t log_id, boo
 
 DparmResult DriveHandleBase::doSecurityCommand(int rw, int dma, uint8_t protocol, uint16_t com_id, void *buffer, uint32_t len) {
   auto driver_handle = getDriverHandle();
-  DparmResult res = driver_handle->doSecurityCommand(protocol, com_id, rw, buffer, len, 5);
+  // TCG responses are parsed up to the length they report
+  InternalReadScope read_scope(this);
+  DparmResult res = driver_handle->doSecurityCommand(protocol, com_id, rw, buffer, len, options_.retry_policy.getTimeoutSecs(kTimeoutSecurity));
   if (res.isOk()) {
     return res;
   }
@@ -215,7 +331,8 @@ DparmResult DriveHandleBase::doSecurityCommand(int rw, int dma, uint8_t protocol
     }
     tf.lob.lbam = (uint8_t) com_id;
     tf.lob.lbah = (uint8_t) (com_id >> 8U);
-    return this->getDriverHandle()->doTaskfileCmd(rw, dma, &tf, buffer, len, 15);
+    unsigned int timeout_secs = options_.retry_policy.timeout_secs[kTimeoutSecurity];
+    return this->getDriverHandle()->doTaskfileCmd(rw, dma, &tf, buffer, len, timeout_secs ? timeout_secs : 15);
   }
   return { DPARME_NOT_SUPPORTED, 0 };
 }
@@ -226,6 +343,8 @@ DparmResult DriveHandleBase::tcgDiscovery0() {
 
   DparmResult dr;
 
+  tcg_discovery_pending_ = false;
+
   dr = doSecurityCommand(0, 0, 0x01, 0x0001, buffer_ptr, tcg::MIN_BUFFER_LENGTH);
   if (!dr.isOk()) {
     if (dr.code == DPARME_NOT_SUPPORTED) {
@@ -251,49 +370,48 @@ DparmResult DriveHandleBase::tcgDiscovery0() {
   while (discovery_cptr < discovery_dend) {
     union tcg::_discovery0_feature_u *cur = (union tcg::_discovery0_feature_u *)discovery_cptr;
     uint16_t feature_code = SWAP16(cur->basic.feature_code);
-    std::vector<unsigned char> item_buffer;
-
-    item_buffer.insert(
-        item_buffer.end(),
-        discovery_cptr,
-        discovery_cptr + cur->basic.length + 4
-    );
-
-    switch(feature_code) {
-      case tcg::kFcTPer:
-        drive_info_.tcg_tper = true;
-        break;
-      case tcg::kFcLocking:
-        drive_info_.tcg_locking = true;
-        break;
-      case tcg::kFcGeometryReporting:
-        drive_info_.tcg_geometry_reporting = true;
-        break;
-      case tcg::kFcOpalSscV100:
-        drive_info_.tcg_opal_v100 = true;
-        break;
-      case tcg::kFcOpalSscV200:
-        drive_info_.tcg_opal_v200 = true;
-        break;
-      case tcg::kFcEnterprise:
-        drive_info_.tcg_enterprise = true;
-        break;
-      case tcg::kFcSingleUser:
-        drive_info_.tcg_single_user_mode = true;
-        break;
-      case tcg::kFcDataStore:
-        drive_info_.tcg_datastore = true;
-        break;
-    }
-
-    drive_info_.tcg_raw_features.emplace(feature_code, item_buffer);
+    applyTcgFeature(feature_code, discovery_cptr, cur->basic.length + 4);
     discovery_cptr += cur->basic.length + 4;
   }
 
   return dr;
 }
 
+void DriveHandleBase::applyTcgFeature(uint16_t feature_code, const unsigned char *data, size_t length) {
+  switch(feature_code) {
+    case tcg::kFcTPer:
+      drive_info_.tcg_tper = true;
+      break;
+    case tcg::kFcLocking:
+      drive_info_.tcg_locking = true;
+      break;
+    case tcg::kFcGeometryReporting:
+      drive_info_.tcg_geometry_reporting = true;
+      break;
+    case tcg::kFcOpalSscV100:
+      drive_info_.tcg_opal_v100 = true;
+      break;
+    case tcg::kFcOpalSscV200:
+      drive_info_.tcg_opal_v200 = true;
+      break;
+    case tcg::kFcEnterprise:
+      drive_info_.tcg_enterprise = true;
+      break;
+    case tcg::kFcSingleUser:
+      drive_info_.tcg_single_user_mode = true;
+      break;
+    case tcg::kFcDataStore:
+      drive_info_.tcg_datastore = true;
+      break;
+  }
+
+  drive_info_.tcg_features.add(data, length);
+}
+
 tcg::TcgDevice *DriveHandleBase::getTcgDevice() {
+  if (tcg_discovery_pending_) {
+    tcgDiscovery0();
+  }
   if (!tcg_device_) {
     if (drive_info_.tcg_support) {
       if (drive_info_.tcg_opal_v200) {
@@ -325,6 +443,7 @@ DparmReturn<SMARTStatus> DriveHandleBase::readAtaSmartStatus() {
   auto driver_handle = getDriverHandle();
   DparmResult dres;
   SMARTStatus smart_status;
+  InternalReadScope read_scope(this);
   if (driver_handle->getDrivingType() == kDrivingAtapi) {
     ata::ata_tf_t tf = {0};
     ata::ata_smart_attribute_values_t values;
@@ -341,7 +460,7 @@ DparmReturn<SMARTStatus> DriveHandleBase::readAtaSmartStatus() {
       tf.lob.lbah = ata::SMART_LBA_HIGH;
       tf.lob.lbam = ata::SMART_LBA_LOW;
       tf.lob.nsect = 1;
-      dres = driver_handle->doTaskfileCmd(0, 0, &tf, &values, sizeof(values), 15);
+      dres = driver_handle->doTaskfileCmd(0, 0, &tf, &values, sizeof(values), options_.retry_policy.getTimeoutSecs(kTimeoutSmart));
       if (!dres.isOk()) {
         break;
       }
@@ -352,7 +471,7 @@ DparmReturn<SMARTStatus> DriveHandleBase::readAtaSmartStatus() {
       tf.lob.lbah = ata::SMART_LBA_HIGH;
       tf.lob.lbam = ata::SMART_LBA_LOW;
       tf.lob.nsect = 1;
-      dres = driver_handle->doTaskfileCmd(0, 0, &tf, &thresholds, sizeof(thresholds), 15);
+      dres = driver_handle->doTaskfileCmd(0, 0, &tf, &thresholds, sizeof(thresholds), options_.retry_policy.getTimeoutSecs(kTimeoutSmart));
       if (!dres.isOk()) {
         break;
       }
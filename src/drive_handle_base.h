@@ -14,11 +14,14 @@
 #include <memory>
 
 #include <jcu-dparm/drive_handle.h>
+#include <jcu-dparm/trace_ring.h>
+#include <jcu-dparm/latency_stats.h>
 #include <jcu-dparm/ata_types.h>
 #include <jcu-dparm/tcg/tcg_types.h>
 #include <jcu-dparm/tcg/tcg_device.h>
 
 #include "drive_driver_handle.h"
+#include "identity_cache.h"
 
 namespace jcu {
 namespace dparm {
@@ -31,6 +34,48 @@ class DriveHandleBase : public DriveHandle {
   DriveInfo drive_info_;
 
   std::unique_ptr<tcg::TcgDevice> tcg_device_;
+  bool tcg_discovery_pending_;
+
+  std::unique_ptr<TraceRing> trace_ring_;
+  LatencyStats latency_stats_;
+
+  /**
+   * value of setReadZeroing
+   */
+  bool read_zeroing_;
+
+  /**
+   * clears read buffers during internal commands (IDENTIFY, SMART, DCO, TCG) whose whole buffer is parsed,
+   * even if the caller disabled it by setReadZeroing(false)
+   */
+  class InternalReadScope {
+   private:
+    DriveHandleBase *handle_;
+
+   public:
+    explicit InternalReadScope(DriveHandleBase *handle) : handle_(handle) {
+      if (!handle_->read_zeroing_) {
+        handle_->getDriverHandle()->setReadZeroing(true);
+      }
+    }
+
+    ~InternalReadScope() {
+      if (!handle_->read_zeroing_) {
+        handle_->getDriverHandle()->setReadZeroing(false);
+      }
+    }
+  };
+
+  /**
+   * transfer size of each Get Log Page command. 0 : not computed yet
+   */
+  uint32_t nvme_log_chunk_bytes_;
+
+  /**
+   * ordered by nsid. Valid if nvme_namespaces_loaded_.
+   */
+  std::vector<NvmeNamespaceInfo> nvme_namespaces_;
+  bool nvme_namespaces_loaded_;
 
   virtual DriveDriverHandle *getDriverHandle() const = 0;
 
@@ -46,18 +91,58 @@ class DriveHandleBase : public DriveHandle {
 
   int dbgprintf(const char* fmt, ...);
 
-  void afterOpen();
+  /**
+   * fill drive_info_: IDENTIFY, INQUIRY fallback and TCG Discovery 0
+   *
+   * @param filter (in) nullable. Steps after a failed stage are skipped.
+   * @return false if the drive is excluded by the filter
+   */
+  bool afterOpen(const EnumDrivesFilter *filter);
+  /**
+   * afterOpen without INQUIRY and TCG Discovery 0
+   * The driver handle must be opened with the identify data of the cache entry.
+   */
+  bool afterOpen(const IdentityCacheEntry& cached, const EnumDrivesFilter *filter);
   int parseIdentifyDevice();
+  void applyTcgFeature(uint16_t feature_code, const unsigned char *data, size_t length);
 
  public:
   std::string getDriverName() const {
     return getDriverHandle()->getDriverName();
   }
 
+  const TraceRing* getTraceRing() const override {
+    return trace_ring_.get();
+  }
+
+  const LatencyStats* getLatencyStats() const override {
+    return &latency_stats_;
+  }
+
+  void setReadZeroing(bool enabled) override {
+    read_zeroing_ = enabled;
+    getDriverHandle()->setReadZeroing(enabled);
+  }
+
+  int getLastResid() const override {
+    return getDriverHandle()->getLastResid();
+  }
+
   const DriveInfo& getDriveInfo() const override {
     return drive_info_;
   }
 
+  bool isTcgDiscoveryPending() const override {
+    return tcg_discovery_pending_;
+  }
+
+  DparmResult runPendingTcgDiscovery() override {
+    if (!tcg_discovery_pending_) {
+      return { DPARME_OK, 0 };
+    }
+    return tcgDiscovery0();
+  }
+
   bool driverIsTaskfileCmdSupported() const override {
     return getDriverHandle()->driverIsTaskfileCmdSupported();
   }
@@ -73,6 +158,18 @@ class DriveHandleBase : public DriveHandle {
     return getDriverHandle()->doTaskfileCmd(rw, dma, tf, data, data_bytes, timeout_secs);
   }
 
+  DparmResult doTaskfileCmdWithCompletion(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      void *data,
+      unsigned int data_bytes,
+      unsigned int timeout_secs,
+      AtaCompletion *completion
+  ) override {
+    return getDriverHandle()->doTaskfileCmdWithCompletion(rw, dma, tf, data, data_bytes, timeout_secs, completion);
+  }
+
   bool driverIsAtaCmdSupported() const override {
     return getDriverHandle()->driverIsAtaCmdSupported();
   }
@@ -91,6 +188,35 @@ class DriveHandleBase : public DriveHandle {
     return getDriverHandle()->doAtaCmd(rw, cdb, cdb_bytes, data, data_bytes, pack_id, timeout_secs, sense_buf, sense_buf_bytes);
   }
 
+  bool driverIsVectoredCmdSupported() const override {
+    return getDriverHandle()->driverIsVectoredCmdSupported();
+  }
+
+  DparmResult doTaskfileCmdV(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      unsigned int timeout_secs
+  ) override {
+    return getDriverHandle()->doTaskfileCmdV(rw, dma, tf, iov, iov_count, timeout_secs);
+  }
+
+  DparmResult doAtaCmdV(
+      int rw,
+      unsigned char* cdb,
+      unsigned int cdb_bytes,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      int pack_id,
+      unsigned int timeout_secs,
+      unsigned char *sense_buf,
+      unsigned int sense_buf_bytes
+  ) override {
+    return getDriverHandle()->doAtaCmdV(rw, cdb, cdb_bytes, iov, iov_count, pack_id, timeout_secs, sense_buf, sense_buf_bytes);
+  }
+
   bool driverIsNvmeAdminPassthruSupported() const {
     return getDriverHandle()->driverIsNvmeAdminPassthruSupported();
   }
@@ -115,6 +241,26 @@ class DriveHandleBase : public DriveHandle {
     return getDriverHandle()->doNvmeIo(io);
   }
 
+  uint32_t getNvmeNamespaceId() const override {
+    return getDriverHandle()->getNvmeNamespaceId();
+  }
+
+  bool driverIsNvmePassthru64Supported() const override {
+    return getDriverHandle()->driverIsNvmePassthru64Supported();
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru64(nvme::nvme_passthru_cmd64_t* cmd) override {
+    return getDriverHandle()->doNvmeAdminPassthru64(cmd);
+  }
+
+  DparmReturn<int> doNvmeIoPassthru64(nvme::nvme_passthru_cmd64_t* cmd) override {
+    return getDriverHandle()->doNvmeIoPassthru64(cmd);
+  }
+
+  DparmReturn<int> doNvmeIoPassthru64V(nvme::nvme_passthru_cmd64_t* cmd, const DparmIoVec *iov, unsigned int iov_count) override {
+    return getDriverHandle()->doNvmeIoPassthru64V(cmd, iov, iov_count);
+  }
+
   DparmResult doNvmeGetLogPageCmd(
       uint32_t nsid, uint8_t log_id,
       uint8_t lsp, uint64_t lpo, uint16_t lsi,
@@ -122,6 +268,7 @@ class DriveHandleBase : public DriveHandle {
       uint32_t data_len, void *data) override;
 
   DparmResult doNvmeGetLogPage(uint32_t nsid, uint8_t log_id, bool rae, uint32_t data_len, void *data) override;
+  uint32_t getNvmeLogChunkBytes() override;
 
   DparmReturn<SanitizeCmdResult> doSanitizeCmd(const SanitizeOptions& options) override;
   DparmReturn<SanitizeEstimates> getSanitizeEstimates() override;
@@ -131,11 +278,18 @@ class DriveHandleBase : public DriveHandle {
 
   DparmResult tcgDiscovery0();
 
+  void exportIdentity(IdentityCacheEntry& entry) const;
+
   tcg::TcgDevice* getTcgDevice() override;
 
   DparmReturn<nvme::nvme_smart_log_page_t> readNvmeSmartLogPage() override;
   DparmReturn<SMARTStatus> readAtaSmartStatus() override;
 
+  DparmReturn<std::vector<NvmeNamespaceInfo>> getNvmeNamespaces() override;
+  DparmResult refreshNvmeNamespaces(uint32_t nsid) override;
+  DparmResult readNvmeActiveNamespaces(std::vector<uint32_t>& nsids);
+  DparmResult readNvmeNamespace(uint32_t nsid, NvmeNamespaceInfo* info);
+
   DparmReturn<uint64_t> readNativeMaxSectors() override;
   uint64_t getAtaLbaCapacity() override;
   DparmReturn<std::vector<uint16_t>> readDcoIdentify() override;
@@ -0,0 +1,166 @@
+/**
+ * @file	drive_handle_nvme_namespace.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <set>
+
+#include "drive_handle_base.h"
+
+#include <jcu-dparm/nvme_types.h>
+
+namespace jcu {
+namespace dparm {
+
+/**
+ * entries of the Identify Active Namespace ID list and of the Changed Namespace List log
+ */
+static const size_t kNvmeNsListEntries = 1024;
+
+static void parseNvmeIdentifyNamespace(uint32_t nsid, std::shared_ptr<const nvme::nvme_identify_namespace_t> data, NvmeNamespaceInfo* info) {
+  const nvme::nvme_identify_namespace_t& identify = *data;
+  uint8_t format = identify.flbas & 0x0f;
+  const nvme::nvme_lba_format_t& lbaf = identify.lbaf[format];
+
+  info->nsid = nsid;
+  info->size_lbas = identify.nsze;
+  info->capacity_lbas = identify.ncap;
+  info->utilization_lbas = identify.nuse;
+  info->lba_format = format;
+  info->lba_bytes = (lbaf.lbads >= 9 && lbaf.lbads < 32) ? (1U << lbaf.lbads) : 0;
+  info->metadata_bytes = lbaf.ms;
+  info->metadata_extended = (identify.flbas & 0x10) != 0;
+  info->setIdentify(std::move(data));
+}
+
+DparmResult DriveHandleBase::readNvmeActiveNamespaces(std::vector<uint32_t>& nsids) {
+  std::vector<uint32_t> list(kNvmeNsListEntries);
+  uint32_t start = 0;
+
+  nsids.clear();
+  for (;;) {
+    nvme::nvme_admin_cmd_t cmd = { 0 };
+    std::fill(list.begin(), list.end(), 0);
+    cmd.opcode = nvme::NVME_ADMIN_OP_IDENTIFY;
+    // namespaces greater than nsid are returned
+    cmd.nsid = start;
+    cmd.addr = list.data();
+    cmd.data_len = (uint32_t) (list.size() * sizeof(uint32_t));
+    cmd.cdw10 = nvme::NVME_IDENTIFY_CNS_NS_ACTIVE_LIST;
+    DparmResult res = getDriverHandle()->doNvmeAdminPassthru(&cmd);
+    if (!res.isOk()) {
+      return res;
+    }
+
+    size_t count = 0;
+    while (count < list.size() && list[count]) {
+      nsids.push_back(list[count]);
+      count++;
+    }
+    if (count < list.size() || list.back() == 0xFFFFFFFEU) {
+      break;
+    }
+    start = list.back();
+  }
+
+  return { DPARME_OK, 0 };
+}
+
+DparmResult DriveHandleBase::readNvmeNamespace(uint32_t nsid, NvmeNamespaceInfo* info) {
+  std::shared_ptr<nvme::nvme_identify_namespace_t> data(new nvme::nvme_identify_namespace_t());
+  nvme::nvme_admin_cmd_t cmd = { 0 };
+  memset(data.get(), 0, sizeof(*data));
+  cmd.opcode = nvme::NVME_ADMIN_OP_IDENTIFY;
+  cmd.nsid = nsid;
+  cmd.addr = data.get();
+  cmd.data_len = sizeof(*data);
+  cmd.cdw10 = nvme::NVME_IDENTIFY_CNS_NS;
+  DparmResult res = getDriverHandle()->doNvmeAdminPassthru(&cmd);
+  if (!res.isOk()) {
+    return res;
+  }
+  parseNvmeIdentifyNamespace(nsid, std::move(data), info);
+  return { DPARME_OK, 0 };
+}
+
+DparmReturn<std::vector<NvmeNamespaceInfo>> DriveHandleBase::getNvmeNamespaces() {
+  if (!nvme_namespaces_loaded_) {
+    DparmResult res = refreshNvmeNamespaces(0xFFFFFFFFU);
+    if (!res.isOk()) {
+      return { res, {} };
+    }
+  }
+  return { DparmResult(DPARME_OK, 0), nvme_namespaces_ };
+}
+
+DparmResult DriveHandleBase::refreshNvmeNamespaces(uint32_t nsid) {
+  auto driver_handle = getDriverHandle();
+  if (driver_handle->getDrivingType() != kDrivingNvme || !driver_handle->driverIsNvmeAdminPassthruSupported()) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+
+  std::vector<uint32_t> active;
+  DparmResult res = readNvmeActiveNamespaces(active);
+  if (!res.isOk()) {
+    return res;
+  }
+
+  bool all = !nvme_namespaces_loaded_ || (nsid == 0xFFFFFFFFU);
+  std::set<uint32_t> changed;
+  if (!all) {
+    // optional log (OAES bit 8). Reading it also clears the Namespace Attribute Notice.
+    std::vector<uint32_t> list(kNvmeNsListEntries);
+    DparmResult log_res = doNvmeGetLogPage(
+        0xFFFFFFFFU, nvme::NVME_GET_LOG_PAGE_CHANGED_NS_LIST, false,
+        (uint32_t) (list.size() * sizeof(uint32_t)), list.data());
+    if (log_res.isOk()) {
+      if (list[0] == 0xFFFFFFFFU) {
+        // more than 1024 namespaces changed
+        all = true;
+      }
+      for (size_t i = 0; i < list.size() && list[i]; i++) {
+        changed.insert(list[i]);
+      }
+    } else {
+      // other namespaces may have changed as well
+      all = true;
+    }
+    if (nsid) {
+      changed.insert(nsid);
+    }
+  }
+
+  std::vector<NvmeNamespaceInfo> updated;
+  updated.reserve(active.size());
+  for (auto it = active.cbegin(); it != active.cend(); it++) {
+    auto cached = std::lower_bound(
+        nvme_namespaces_.cbegin(), nvme_namespaces_.cend(), *it,
+        [](const NvmeNamespaceInfo& info, uint32_t value) -> bool {
+          return info.nsid < value;
+        });
+    if (!all && cached != nvme_namespaces_.cend() && cached->nsid == *it && !changed.count(*it)) {
+      updated.push_back(*cached);
+      continue;
+    }
+    NvmeNamespaceInfo info;
+    res = readNvmeNamespace(*it, &info);
+    if (!res.isOk()) {
+      return res;
+    }
+    updated.push_back(std::move(info));
+  }
+
+  nvme_namespaces_.swap(updated);
+  nvme_namespaces_loaded_ = true;
+  return { DPARME_OK, 0 };
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -109,7 +109,7 @@ DparmReturn<SanitizeCmdResult> DriveHandleBase::doSanitizeCmd(const SanitizeOpti
       tf.hob.nsect |= 0x80; // ZONED NO RESET
     }
 
-    dr = driver_handle->doTaskfileCmd(0, -1, &tf, nullptr, 0, 15);
+    dr = driver_handle->doTaskfileCmd(0, -1, &tf, nullptr, 0, options_.retry_policy.getTimeoutSecs(kTimeoutDefault));
     if (!dr.isOk()) {
       return { dr.code, dr.sys_error, {} };
     }
@@ -184,12 +184,12 @@ DparmReturn<SanitizeEstimates> DriveHandleBase::getSanitizeEstimates() {
 
   if (driving_type == kDrivingAtapi) {
     auto const& drive_info = getDriveInfo();
-    if (drive_info.ata_identify.security_status.security_supported) {
-      auto const& val = drive_info.ata_identify.normal_security_erase_unit;
+    if (drive_info.getAtaIdentify().security_status.security_supported) {
+      auto const& val = drive_info.getAtaIdentify().normal_security_erase_unit;
       ests.security_erase = ataEstToSeconds(val.time_required, val.extended_time_reported);
     }
-    if (drive_info.ata_identify.security_status.enhanced_security_erase_supported) {
-      auto const& val = drive_info.ata_identify.enhanced_security_erase_unit;
+    if (drive_info.getAtaIdentify().security_status.enhanced_security_erase_supported) {
+      auto const& val = drive_info.getAtaIdentify().enhanced_security_erase_unit;
       ests.enhanced_security_erase = ataEstToSeconds(val.time_required, val.extended_time_reported);
     }
     return { DPARME_OK, 0, 0, ests };
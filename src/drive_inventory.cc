@@ -0,0 +1,163 @@
+/**
+ * @file	drive_inventory.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <errno.h>
+
+#include <vector>
+
+#include <jcu-dparm/drive_inventory.h>
+
+namespace jcu {
+namespace dparm {
+
+DriveInventory::DriveInventory(const DriveFactory *factory, std::unique_ptr<DeviceEventSource> event_source, const EnumDrivesOptions &options)
+    : factory_(factory), event_source_(std::move(event_source)), options_(options)
+{
+}
+
+std::unique_ptr<DriveInventory> DriveInventory::create(const DriveFactory *factory, const EnumDrivesOptions &options) {
+  return std::unique_ptr<DriveInventory>(new DriveInventory(factory, factory->createDeviceEventSource(), options));
+}
+
+void DriveInventory::setChangeCallback(const ChangeCallback &callback) {
+  change_callback_ = callback;
+}
+
+void DriveInventory::notify(DriveChangeType change, const DriveInfo &drive_info) {
+  if (change_callback_) {
+    change_callback_(change, drive_info);
+  }
+}
+
+int DriveInventory::refresh() {
+  std::list<DriveInfo> drive_list;
+  int rc = factory_->enumDrives(drive_list, options_);
+  if (rc) {
+    return rc;
+  }
+
+  std::map<std::string, DriveInfo> drives;
+  for (auto it = drive_list.begin(); it != drive_list.end(); it++) {
+    std::string key = it->device_path;
+    drives[key] = std::move(*it);
+  }
+
+  std::vector<std::pair<DriveChangeType, DriveInfo>> changes;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = drives_.cbegin(); it != drives_.cend(); it++) {
+      if (drives.find(it->first) == drives.end()) {
+        changes.emplace_back(kDriveRemoved, it->second);
+      }
+    }
+    for (auto it = drives.cbegin(); it != drives.cend(); it++) {
+      if (drives_.find(it->first) == drives_.end()) {
+        changes.emplace_back(kDriveAdded, it->second);
+      }
+    }
+    drives_.swap(drives);
+  }
+
+  for (auto it = changes.cbegin(); it != changes.cend(); it++) {
+    if (it->first == kDriveRemoved) {
+      factory_->invalidateShared(it->second.device_path.c_str());
+    }
+    notify(it->first, it->second);
+  }
+  return 0;
+}
+
+int DriveInventory::processEvents(int timeout_ms) {
+  if (!event_source_) {
+    return ENOTSUP;
+  }
+
+  DeviceEvent event;
+  int rc = event_source_->readEvent(event, timeout_ms);
+  if (rc) {
+    return rc;
+  }
+
+  do {
+    handleEvent(event);
+  } while (event_source_->readEvent(event, 0) == 0);
+
+  return 0;
+}
+
+void DriveInventory::handleEvent(const DeviceEvent &event) {
+  DriveChangeType change;
+  DriveInfo drive_info;
+
+  if (event.action == kDeviceChange && findDrive(event.device_path, nullptr)) {
+    /*
+     * udev emits "change" when a writable descriptor of the disk is closed (the default watch rule),
+     * so probing a known drive on change would cause the next change event.
+     */
+    return;
+  }
+
+  // a shared handle must not outlive the device
+  factory_->invalidateShared(event.device_path.c_str());
+
+  if (event.action == kDeviceRemove) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = drives_.find(event.device_path);
+    if (it == drives_.end()) {
+      return;
+    }
+    change = kDriveRemoved;
+    drive_info = std::move(it->second);
+    drives_.erase(it);
+  } else {
+    // probe without the lock: it may take seconds
+    if (factory_->probeDrive(event.device_path.c_str(), drive_info, options_)) {
+      // gone or no longer matching the filter
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = drives_.find(event.device_path);
+      if (it == drives_.end()) {
+        return;
+      }
+      change = kDriveRemoved;
+      drive_info = std::move(it->second);
+      drives_.erase(it);
+    } else {
+      std::lock_guard<std::mutex> lock(mutex_);
+      DriveInfo& entry = drives_[event.device_path];
+      change = entry.device_path.empty() ? kDriveAdded : kDriveChanged;
+      entry = drive_info;
+    }
+  }
+
+  notify(change, drive_info);
+}
+
+std::list<DriveInfo> DriveInventory::getDrives() const {
+  std::list<DriveInfo> result;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = drives_.cbegin(); it != drives_.cend(); it++) {
+    result.push_back(it->second);
+  }
+  return result;
+}
+
+bool DriveInventory::findDrive(const std::string &device_path, DriveInfo *drive_info) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = drives_.find(device_path);
+  if (it == drives_.end()) {
+    return false;
+  }
+  if (drive_info) {
+    *drive_info = it->second;
+  }
+  return true;
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,228 @@
+/**
+ * @file	identity_cache.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include "identity_cache.h"
+
+namespace jcu {
+namespace dparm {
+
+/*
+ * File layout (host byte order)
+ *
+ * uint32 magic, uint32 version, uint32 count
+ * count * {
+ *   uint64 device_key
+ *   bytes os_identity, bytes driver_name, bytes nvme_identify
+ *   bytes model, bytes serial
+ *   int32 tcg_support
+ *   bytes tcg_features
+ * }
+ *
+ * bytes = uint32 length + data
+ */
+static const uint32_t kCacheMagic = 0x43494a44; // "DJIC"
+static const uint32_t kCacheVersion = 4;
+static const uint32_t kMaxBytesLength = 65536;
+
+namespace {
+
+class CacheWriter {
+ private:
+  FILE *fp_;
+  int error_;
+
+ public:
+  CacheWriter(FILE *fp) : fp_(fp), error_(0) {}
+
+  /**
+   * @return errno of the first failed write, 0 if none
+   */
+  int getError() const {
+    return error_;
+  }
+
+  void write(const void *data, size_t length) {
+    if (error_ || !length) {
+      return;
+    }
+    errno = 0;
+    if (fwrite(data, 1, length, fp_) != length) {
+      error_ = errno ? errno : EIO;
+    }
+  }
+
+  template<typename T>
+  void writeValue(T value) {
+    write(&value, sizeof(value));
+  }
+
+  template<class C>
+  void writeBytes(const C& data) {
+    writeValue<uint32_t>((uint32_t) data.size());
+    write(data.data(), data.size());
+  }
+};
+
+class CacheReader {
+ private:
+  FILE *fp_;
+  bool ok_;
+
+ public:
+  CacheReader(FILE *fp) : fp_(fp), ok_(true) {}
+
+  bool isOk() const {
+    return ok_;
+  }
+
+  void read(void *data, size_t length) {
+    if (ok_ && length && fread(data, 1, length, fp_) != length) {
+      ok_ = false;
+    }
+  }
+
+  template<typename T>
+  T readValue() {
+    T value = 0;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  template<class C>
+  void readBytes(C& data) {
+    uint32_t length = readValue<uint32_t>();
+    if (length > kMaxBytesLength) {
+      ok_ = false;
+    }
+    if (!ok_) {
+      return;
+    }
+    data.resize(length);
+    if (length) {
+      read(&data[0], length);
+    }
+  }
+};
+
+} // namespace
+
+IdentityCache::IdentityCache(const std::string &file_path)
+    : file_path_(file_path), dirty_(false)
+{
+}
+
+int IdentityCache::load() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<uint64_t, IdentityCacheEntry> entries;
+  FILE *fp = fopen(file_path_.c_str(), "rb");
+  if (!fp) {
+    return (errno == ENOENT) ? 0 : errno;
+  }
+
+  CacheReader reader(fp);
+  if (reader.readValue<uint32_t>() == kCacheMagic && reader.readValue<uint32_t>() == kCacheVersion) {
+    uint32_t count = reader.readValue<uint32_t>();
+    for (uint32_t i = 0; reader.isOk() && i < count; i++) {
+      IdentityCacheEntry entry;
+      entry.device_key = reader.readValue<uint64_t>();
+      reader.readBytes(entry.os_identity);
+      reader.readBytes(entry.driver_name);
+      reader.readBytes(entry.nvme_identify);
+      reader.readBytes(entry.model);
+      reader.readBytes(entry.serial);
+      entry.tcg_support = reader.readValue<int32_t>();
+      reader.readBytes(entry.tcg_features);
+      if (reader.isOk()) {
+        entries[entry.device_key] = std::move(entry);
+      }
+    }
+  }
+  fclose(fp);
+
+  // A broken file is dropped and rewritten on next save.
+  entries_.swap(entries);
+  dirty_ = false;
+  return 0;
+}
+
+int IdentityCache::save() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!dirty_) {
+    return 0;
+  }
+
+  std::string temp_path = file_path_ + ".tmp";
+  FILE *fp = fopen(temp_path.c_str(), "wb");
+  if (!fp) {
+    return errno;
+  }
+
+  CacheWriter writer(fp);
+  writer.writeValue<uint32_t>(kCacheMagic);
+  writer.writeValue<uint32_t>(kCacheVersion);
+  writer.writeValue<uint32_t>((uint32_t) entries_.size());
+  for (auto it = entries_.cbegin(); it != entries_.cend(); it++) {
+    const IdentityCacheEntry& entry = it->second;
+    writer.writeValue<uint64_t>(entry.device_key);
+    writer.writeBytes(entry.os_identity);
+    writer.writeBytes(entry.driver_name);
+    writer.writeBytes(entry.nvme_identify);
+    writer.writeBytes(entry.model);
+    writer.writeBytes(entry.serial);
+    writer.writeValue<int32_t>(entry.tcg_support);
+    writer.writeBytes(entry.tcg_features);
+  }
+
+  // fflush in fclose reports the errors of buffered writes
+  int err = writer.getError();
+  errno = 0;
+  if (fclose(fp) != 0 && !err) {
+    err = errno ? errno : EIO;
+  }
+  if (!err && rename(temp_path.c_str(), file_path_.c_str()) != 0) {
+    err = errno;
+  }
+  if (err) {
+    ::remove(temp_path.c_str());
+    return err;
+  }
+
+  dirty_ = false;
+  return 0;
+}
+
+bool IdentityCache::find(uint64_t device_key, const std::string& os_identity, IdentityCacheEntry* entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(device_key);
+  if (it == entries_.end() || it->second.os_identity != os_identity) {
+    return false;
+  }
+  *entry = it->second;
+  return true;
+}
+
+void IdentityCache::put(const IdentityCacheEntry& entry) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[entry.device_key] = entry;
+  dirty_ = true;
+}
+
+void IdentityCache::remove(uint64_t device_key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.erase(device_key)) {
+    dirty_ = true;
+  }
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,94 @@
+/**
+ * @file	identity_cache.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_IDENTITY_CACHE_H_
+#define JCU_DPARM_SRC_IDENTITY_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace jcu {
+namespace dparm {
+
+/**
+ * Probe results of a drive which can be restored without issuing any command
+ */
+struct IdentityCacheEntry {
+  /**
+   * platform device number (linux: dev_t)
+   */
+  uint64_t device_key;
+  /**
+   * identity read from the OS without touching the drive (linux: sysfs wwid or serial, and firmware revision).
+   * The entry is used only if it is equal.
+   */
+  std::string os_identity;
+
+  std::string driver_name;
+  /**
+   * NVMe Identify Controller. ATA IDENTIFY DEVICE is not kept: its security words
+   * (frozen, locked, enabled) and the erase support derived from them change across reboots.
+   */
+  std::vector<unsigned char> nvme_identify;
+
+  /**
+   * DriveInfo.model/serial after INQUIRY fallback
+   */
+  std::string model;
+  std::string serial;
+
+  int tcg_support;
+  /**
+   * TcgFeatureTable::raw()
+   */
+  std::vector<unsigned char> tcg_features;
+
+  IdentityCacheEntry() : device_key(0), tcg_support(0) {}
+};
+
+/**
+ * On-disk cache of IDENTIFY data and TCG Discovery 0 features
+ *
+ * Thread safe.
+ */
+class IdentityCache {
+ private:
+  std::string file_path_;
+  std::mutex mutex_;
+  std::map<uint64_t, IdentityCacheEntry> entries_;
+  bool dirty_;
+
+ public:
+  IdentityCache(const std::string& file_path);
+
+  /**
+   * @return zero if successful, otherwise errno. A missing or invalid file is treated as empty.
+   */
+  int load();
+
+  /**
+   * write the file if there are changes since last load/save
+   *
+   * @return zero if successful, otherwise errno.
+   */
+  int save();
+
+  bool find(uint64_t device_key, const std::string& os_identity, IdentityCacheEntry* entry);
+  void put(const IdentityCacheEntry& entry);
+  void remove(uint64_t device_key);
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_IDENTITY_CACHE_H_
@@ -7,6 +7,10 @@
  *            of the Apache License 2.0.  See the LICENSE file for details.
  */
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "intl_utils.h"
 
 namespace jcu {
@@ -89,6 +93,35 @@ std::string trimString(const std::string &input) {
   return std::string();
 }
 
+void parallelFor(size_t count, int max_workers, const std::function<void(size_t index)>& fn) {
+  size_t num_workers = (max_workers > 1) ? (size_t) max_workers : 1;
+  if (num_workers > count) {
+    num_workers = count;
+  }
+
+  if (num_workers <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next_index(0);
+  std::vector<std::thread> workers;
+  workers.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++) {
+    workers.emplace_back([&next_index, count, &fn]() -> void {
+      size_t index;
+      while ((index = next_index.fetch_add(1)) < count) {
+        fn(index);
+      }
+    });
+  }
+  for (auto it = workers.begin(); it != workers.end(); it++) {
+    it->join();
+  }
+}
+
 } // namespace intl
 } // namespace dparm
 } // namespace jcu
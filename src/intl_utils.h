@@ -11,6 +11,7 @@
 #define JCU_DPARM_SRC_INTL_UTILS_H_
 
 #include <string>
+#include <functional>
 
 /** change the "endianess" of a 16bit field */
 #define SWAP16(x) ((uint16_t) ((x & 0x00ff) << 8) | ((x & 0xff00) >> 8))
@@ -37,6 +38,15 @@ std::string trimString(const std::string &input);
 
 uint64_t fixAtaUint64Order(const void *buffer);
 
+/**
+ * call fn(0) ... fn(count - 1) on a bounded pool of worker threads
+ *
+ * @param count       number of items
+ * @param max_workers maximum number of threads. 0 or 1 runs in the calling thread.
+ * @param fn          worker function. It may be called concurrently.
+ */
+void parallelFor(size_t count, int max_workers, const std::function<void(size_t index)>& fn);
+
 } // namespace intl
 } // namespace dparm
 } // namespace jcu
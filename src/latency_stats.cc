@@ -0,0 +1,148 @@
+/**
+ * @file	latency_stats.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <jcu-dparm/latency_stats.h>
+
+namespace jcu {
+namespace dparm {
+
+const unsigned int LatencyHistogram::kSubBucketBits;
+const unsigned int LatencyHistogram::kSubBucketCount;
+const unsigned int LatencyHistogram::kMaxValueBits;
+const uint64_t LatencyHistogram::kMaxValue;
+const size_t LatencyHistogram::kBucketCount;
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+  if (value > kMaxValue) {
+    value = kMaxValue;
+  }
+  if (value < kSubBucketCount) {
+    return (size_t) value;
+  }
+  unsigned int msb = kSubBucketBits;
+  while (value >> (msb + 1)) {
+    msb++;
+  }
+  unsigned int shift = msb - kSubBucketBits;
+  return kSubBucketCount * (shift + 1) + (size_t) ((value >> shift) & (kSubBucketCount - 1));
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  unsigned int shift = (unsigned int) (index / kSubBucketCount) - 1;
+  uint64_t sub_bucket = kSubBucketCount + (index % kSubBucketCount);
+  return sub_bucket << shift;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  unsigned int shift = (unsigned int) (index / kSubBucketCount) - 1;
+  return bucketLowerBound(index) + (1ULL << shift) - 1;
+}
+
+uint64_t LatencyOpcodeStats::percentileUs(double percentile) const {
+  if (!count || buckets.empty()) {
+    return 0;
+  }
+  if (percentile < 0) {
+    percentile = 0;
+  }
+  if (percentile > 100) {
+    percentile = 100;
+  }
+  uint64_t target = (uint64_t) (percentile * (double) count / 100.0 + 0.5);
+  if (target < 1) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); i++) {
+    seen += buckets[i];
+    if (seen >= target) {
+      uint64_t bound = LatencyHistogram::bucketUpperBound(i);
+      return (bound < max_us) ? bound : max_us;
+    }
+  }
+  return max_us;
+}
+
+LatencyStats::Entry::Entry()
+    : count(0), errors(0), total_us(0), max_us(0)
+{
+  for (size_t i = 0; i < LatencyHistogram::kBucketCount; i++) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+LatencyStats::LatencyStats() {
+  for (size_t i = 0; i < sizeof(entries_) / sizeof(entries_[0]); i++) {
+    entries_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+LatencyStats::~LatencyStats() {
+  for (size_t i = 0; i < sizeof(entries_) / sizeof(entries_[0]); i++) {
+    delete entries_[i].load(std::memory_order_relaxed);
+  }
+}
+
+void LatencyStats::record(LatencyOpcodeClass opcode_class, uint8_t opcode, uint64_t duration_us, bool error) {
+  if ((unsigned int) opcode_class >= kLatencyOpcodeClassCount) {
+    return;
+  }
+  std::atomic<Entry *>& slot = entries_[opcode_class * 256 + opcode];
+  Entry *entry = slot.load(std::memory_order_acquire);
+  if (!entry) {
+    Entry *created = new Entry();
+    if (slot.compare_exchange_strong(entry, created, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      entry = created;
+    } else {
+      // another thread installed it first; entry holds that one
+      delete created;
+    }
+  }
+
+  entry->count.fetch_add(1, std::memory_order_relaxed);
+  if (error) {
+    entry->errors.fetch_add(1, std::memory_order_relaxed);
+  }
+  entry->total_us.fetch_add(duration_us, std::memory_order_relaxed);
+  uint64_t max_us = entry->max_us.load(std::memory_order_relaxed);
+  while (duration_us > max_us &&
+      !entry->max_us.compare_exchange_weak(max_us, duration_us, std::memory_order_relaxed)) {
+  }
+  entry->buckets[LatencyHistogram::bucketIndex(duration_us)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyStats::snapshot(std::vector<LatencyOpcodeStats> &stats) const {
+  for (size_t i = 0; i < sizeof(entries_) / sizeof(entries_[0]); i++) {
+    const Entry *entry = entries_[i].load(std::memory_order_acquire);
+    if (!entry) {
+      continue;
+    }
+    LatencyOpcodeStats item;
+    item.opcode_class = (LatencyOpcodeClass) (i / 256);
+    item.opcode = (uint8_t) (i % 256);
+    item.count = entry->count.load(std::memory_order_relaxed);
+    item.errors = entry->errors.load(std::memory_order_relaxed);
+    item.total_us = entry->total_us.load(std::memory_order_relaxed);
+    item.max_us = entry->max_us.load(std::memory_order_relaxed);
+    item.buckets.resize(LatencyHistogram::kBucketCount);
+    for (size_t j = 0; j < LatencyHistogram::kBucketCount; j++) {
+      item.buckets[j] = entry->buckets[j].load(std::memory_order_relaxed);
+    }
+    stats.push_back(std::move(item));
+  }
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,215 @@
+/**
+ * @file	media_scanner.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <errno.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <jcu-dparm/media_scanner.h>
+#include <jcu-dparm/ata_utils.h>
+
+#include "intl_utils.h"
+
+namespace jcu {
+namespace dparm {
+
+static const uint32_t kMaxChunkSectors = 65536;
+static const uint32_t kDefaultSlowChunkMs = 1000;
+/**
+ * a drive is stopped after this many failures in a row without an ATA error (timeout, transport error)
+ */
+static const int kMaxTransportFailures = 3;
+
+void MediaRegionMap::add(uint64_t lba, uint64_t sectors, MediaRegionType type, uint32_t latency_ms) {
+  if (!sectors) {
+    return;
+  }
+  auto it = std::upper_bound(regions_.begin(), regions_.end(), lba, [](uint64_t value, const MediaRegion& region) -> bool {
+    return value < region.lba;
+  });
+
+  // regions of the other type may lie in between
+  auto target = regions_.end();
+  for (auto prev = it; prev != regions_.begin(); ) {
+    --prev;
+    if (prev->type == type) {
+      if (prev->lba + prev->sectors >= lba) {
+        target = prev;
+      }
+      break;
+    }
+  }
+  if (target == regions_.end()) {
+    MediaRegion region;
+    region.lba = lba;
+    region.sectors = sectors;
+    region.type = type;
+    region.max_latency_ms = latency_ms;
+    target = regions_.insert(it, region);
+  } else {
+    target->sectors = std::max(target->lba + target->sectors, lba + sectors) - target->lba;
+    target->max_latency_ms = std::max(target->max_latency_ms, latency_ms);
+  }
+
+  // absorb the following regions of the type which touch it
+  for (auto next = target + 1; next != regions_.end() && next->lba <= target->lba + target->sectors; ) {
+    if (next->type == type) {
+      target->sectors = std::max(target->lba + target->sectors, next->lba + next->sectors) - target->lba;
+      target->max_latency_ms = std::max(target->max_latency_ms, next->max_latency_ms);
+      next = regions_.erase(next);
+    } else {
+      ++next;
+    }
+  }
+}
+
+uint64_t MediaRegionMap::countSectors(MediaRegionType type) const {
+  uint64_t total = 0;
+  for (auto it = regions_.cbegin(); it != regions_.cend(); it++) {
+    if (it->type == type) {
+      total += it->sectors;
+    }
+  }
+  return total;
+}
+
+MediaScanner::MediaScanner(const MediaScanOptions &options)
+    : options_(options), cancelled_(false)
+{
+  if (!options_.chunk_sectors || options_.chunk_sectors > kMaxChunkSectors) {
+    options_.chunk_sectors = kMaxChunkSectors;
+  }
+  if (!options_.slow_chunk_ms) {
+    options_.slow_chunk_ms = kDefaultSlowChunkMs;
+  }
+}
+
+size_t MediaScanner::addDrive(DriveHandle *handle) {
+  drives_.push_back(handle);
+  return drives_.size() - 1;
+}
+
+void MediaScanner::setProgressCallback(const ProgressCallback &callback) {
+  progress_callback_ = callback;
+}
+
+void MediaScanner::cancel() {
+  cancelled_ = true;
+}
+
+void MediaScanner::run() {
+  results_.clear();
+  results_.resize(drives_.size());
+  int parallel = (options_.parallel > 0) ? options_.parallel : (int) drives_.size();
+  intl::parallelFor(drives_.size(), parallel, [this](size_t index) -> void {
+    scanDrive(index);
+  });
+}
+
+void MediaScanner::scanDrive(size_t index) {
+  DriveHandle *handle = drives_[index];
+  MediaScanResult& result = results_[index];
+  auto started = std::chrono::steady_clock::now();
+  int transport_failures = 0;
+
+  result.errors = 0;
+  result.elapsed_ms = 0;
+  result.chunk_latency.opcode_class = kLatencyAta;
+  result.chunk_latency.opcode = ata::ATA_OP_READ_VERIFY_EXT;
+  result.chunk_latency.count = 0;
+  result.chunk_latency.errors = 0;
+  result.chunk_latency.total_us = 0;
+  result.chunk_latency.max_us = 0;
+  result.chunk_latency.buckets.assign(LatencyHistogram::kBucketCount, 0);
+
+  uint64_t capacity = handle->driverIsTaskfileCmdSupported() ? handle->getAtaLbaCapacity() : 0;
+  result.start_lba = options_.start_lba;
+  result.end_lba = (options_.end_lba && options_.end_lba < capacity) ? options_.end_lba : capacity;
+  result.next_lba = result.start_lba;
+  if (!capacity) {
+    result.result = { DPARME_NOT_SUPPORTED, 0 };
+    return;
+  }
+
+  while (result.next_lba < result.end_lba && !cancelled_) {
+    uint64_t lba = result.next_lba;
+    uint32_t sectors = (uint32_t) std::min<uint64_t>(options_.chunk_sectors, result.end_lba - lba);
+    ata::ata_tf_t tf;
+    AtaCompletion completion;
+
+    // 65536 is encoded as 0
+    ata::tf_init(&tf, ata::ATA_OP_READ_VERIFY_EXT, lba, sectors);
+
+    auto issued = std::chrono::steady_clock::now();
+    DparmResult dr = handle->doTaskfileCmdWithCompletion(0, -1, &tf, nullptr, 0, options_.timeout_secs, &completion);
+    uint64_t duration_us = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - issued).count();
+    uint32_t latency_ms = (uint32_t) (duration_us / 1000);
+
+    result.chunk_latency.count++;
+    result.chunk_latency.total_us += duration_us;
+    result.chunk_latency.max_us = std::max(result.chunk_latency.max_us, duration_us);
+    result.chunk_latency.buckets[LatencyHistogram::bucketIndex(duration_us)]++;
+
+    if (dr.isOk()) {
+      transport_failures = 0;
+      if (latency_ms > options_.slow_chunk_ms) {
+        result.regions.add(lba, sectors, kMediaRegionSlow, latency_ms);
+      }
+      result.next_lba = lba + sectors;
+    } else {
+      result.errors++;
+      result.chunk_latency.errors++;
+      if (completion.isAtaError()) {
+        // the drive reports the first failed lba; resume right after it
+        transport_failures = 0;
+        uint64_t error_lba = completion.ata_lba;
+        if (completion.ata_upper_unknown || error_lba < lba || error_lba >= lba + sectors) {
+          result.regions.add(lba, sectors, kMediaRegionBad, latency_ms);
+          result.next_lba = lba + sectors;
+        } else {
+          result.regions.add(error_lba, 1, kMediaRegionBad, latency_ms);
+          result.next_lba = error_lba + 1;
+        }
+      } else if (++transport_failures >= kMaxTransportFailures) {
+        result.result = dr;
+        break;
+      } else {
+        result.regions.add(lba, sectors, kMediaRegionBad, latency_ms);
+        result.next_lba = lba + sectors;
+      }
+      if (options_.max_errors && result.errors >= options_.max_errors) {
+        result.result = dr;
+        break;
+      }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    result.elapsed_ms = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    if (progress_callback_ && !progress_callback_(index, result)) {
+      break;
+    }
+
+    if (options_.max_sectors_per_second) {
+      uint64_t scanned_sectors = result.next_lba - result.start_lba;
+      auto expected = std::chrono::microseconds(scanned_sectors * 1000000ULL / options_.max_sectors_per_second);
+      if (expected > elapsed) {
+        std::this_thread::sleep_for(expected - elapsed);
+      }
+    }
+  }
+
+  result.elapsed_ms = (uint64_t) std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - started).count();
+}
+
+} // namespace dparm
+} // namespace jcu
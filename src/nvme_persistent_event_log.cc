@@ -0,0 +1,215 @@
+/**
+ * @file	nvme_persistent_event_log.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <jcu-dparm/nvme_persistent_event_log.h>
+#include <jcu-dparm/nvme_utils.h>
+
+namespace jcu {
+namespace dparm {
+
+static const uint64_t kPelHeaderBytes = sizeof(nvme::nvme_persistent_event_log_header_t);
+static const uint64_t kPelTimestampMask = (1ULL << 48) - 1;
+static const uint32_t kPelFallbackChunkBytes = 4096;
+
+NvmePersistentEventIterator::NvmePersistentEventIterator()
+    : pos_(nullptr), end_(nullptr)
+{
+  memset(&event_, 0, sizeof(event_));
+}
+
+NvmePersistentEventIterator::NvmePersistentEventIterator(const void *data, size_t length, uint64_t offset)
+    : pos_((const uint8_t *) data), end_((const uint8_t *) data + length)
+{
+  memset(&event_, 0, sizeof(event_));
+  event_.offset = offset;
+  parse();
+}
+
+void NvmePersistentEventIterator::parse() {
+  nvme::nvme_persistent_event_header_t header;
+  if (!pos_ || (size_t) (end_ - pos_) < sizeof(header)) {
+    pos_ = nullptr;
+    return;
+  }
+  // events are packed without alignment
+  memcpy(&header, pos_, sizeof(header));
+  size_t header_length = (size_t) header.ehl + 3;
+  size_t length = header_length + header.el;
+  if (header_length < sizeof(header) || header.vsil > header.el || length > (size_t) (end_ - pos_)) {
+    pos_ = nullptr;
+    return;
+  }
+
+  event_.length = (uint32_t) length;
+  event_.type = header.etype;
+  event_.revision = header.etype_rev;
+  event_.controller_id = header.cntlid;
+  event_.timestamp_ms = header.ets & kPelTimestampMask;
+  event_.vendor_info = pos_ + header_length;
+  event_.vendor_info_length = header.vsil;
+  event_.data = event_.vendor_info + header.vsil;
+  event_.data_length = (uint32_t) (header.el - header.vsil);
+}
+
+NvmePersistentEventIterator& NvmePersistentEventIterator::operator++() {
+  if (pos_) {
+    pos_ += event_.length;
+    event_.offset += event_.length;
+    parse();
+  }
+  return *this;
+}
+
+NvmePersistentEventReader::NvmePersistentEventReader(DriveHandle *handle)
+    : handle_(handle), events_begin_(0), events_end_(0), events_offset_(0),
+      has_position_(false), last_event_offset_(0), last_timestamp_ms_(0), last_type_(0)
+{
+  memset(&header_, 0, sizeof(header_));
+}
+
+void NvmePersistentEventReader::setPosition(uint64_t last_event_offset, uint64_t last_timestamp_ms, uint8_t last_type) {
+  has_position_ = true;
+  last_event_offset_ = last_event_offset;
+  last_timestamp_ms_ = last_timestamp_ms;
+  last_type_ = last_type;
+}
+
+DparmResult NvmePersistentEventReader::readRange(uint64_t start, uint64_t end) {
+  // the offset and the length of Get Log Page are in dwords
+  uint64_t aligned_start = start & ~3ULL;
+  uint64_t aligned_end = (end + 3) & ~3ULL;
+  uint32_t chunk_bytes = handle_->getNvmeLogChunkBytes() & ~3U;
+  if (!chunk_bytes) {
+    chunk_bytes = kPelFallbackChunkBytes;
+  }
+
+  // resize() keeps the capacity, so polls of a similar size do not allocate
+  buffer_.resize((size_t) (aligned_end - aligned_start));
+  for (uint64_t offset = aligned_start; offset < aligned_end; ) {
+    uint32_t length = (uint32_t) std::min<uint64_t>(chunk_bytes, aligned_end - offset);
+    DparmResult res = handle_->doNvmeGetLogPageCmd(
+        0xFFFFFFFFU, nvme::NVME_GET_LOG_PAGE_PERSISTENT_EVENT, nvme::NVME_PEL_LSP_READ,
+        offset, 0, false, 0, length, &buffer_[(size_t) (offset - aligned_start)]);
+    if (!res.isOk()) {
+      if (length > kPelFallbackChunkBytes && nvme::isTransferSizeError(res)) {
+        // the same fallback as doNvmeGetLogPage: retry in 4k transfers
+        chunk_bytes = kPelFallbackChunkBytes;
+        continue;
+      }
+      return res;
+    }
+    offset += length;
+  }
+
+  events_begin_ = (size_t) (start - aligned_start);
+  events_end_ = (size_t) (end - aligned_start);
+  events_offset_ = start;
+  return { DPARME_OK, 0 };
+}
+
+DparmResult NvmePersistentEventReader::poll() {
+  events_begin_ = events_end_ = 0;
+
+  memset(&header_, 0, sizeof(header_));
+  DparmResult res = handle_->doNvmeGetLogPageCmd(
+      0xFFFFFFFFU, nvme::NVME_GET_LOG_PAGE_PERSISTENT_EVENT, nvme::NVME_PEL_LSP_ESTABLISH_CONTEXT,
+      0, 0, false, 0, sizeof(header_), &header_);
+  if (!res.isOk()) {
+    return res;
+  }
+  // from here on, the context is released on every path
+  uint64_t total_length = header_.tll;
+  bool skip_by_timestamp = false;
+  bool tail_read = false;
+  if (total_length < kPelHeaderBytes) {
+    res = { DPARME_ILLEGAL_RESPONSE, 0 };
+  } else {
+    if (has_position_ && last_event_offset_ >= kPelHeaderBytes && last_event_offset_ < total_length) {
+      // the tail from the last consumed event, which must be still there
+      res = readRange(last_event_offset_, total_length);
+      if (res.isOk()) {
+        NvmePersistentEventIterator it(&buffer_[events_begin_], events_end_ - events_begin_, events_offset_);
+        if (it != NvmePersistentEventIterator() && it->timestamp_ms == last_timestamp_ms_ && it->type == last_type_) {
+          events_begin_ += it->length;
+          events_offset_ += it->length;
+          tail_read = true;
+        }
+      }
+    }
+    if (!tail_read) {
+      skip_by_timestamp = has_position_;
+      res = readRange(kPelHeaderBytes, total_length);
+    }
+  }
+
+  // no data is returned, but the transfer length must be valid
+  nvme::nvme_persistent_event_log_header_t scratch;
+  handle_->doNvmeGetLogPageCmd(
+      0xFFFFFFFFU, nvme::NVME_GET_LOG_PAGE_PERSISTENT_EVENT, nvme::NVME_PEL_LSP_RELEASE_CONTEXT,
+      0, 0, false, 0, sizeof(scratch), &scratch);
+  if (!res.isOk()) {
+    events_begin_ = events_end_ = 0;
+    return res;
+  }
+
+  if (skip_by_timestamp) {
+    // the last consumed event moved (the log wrapped) or is gone (wrapped past it, or cleared)
+    size_t skip_bytes = 0;
+    bool found = false;
+    for (NvmePersistentEventIterator it = begin(); it != end(); ++it) {
+      skip_bytes += it->length;
+      if (it->timestamp_ms == last_timestamp_ms_ && it->type == last_type_) {
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      // skip the older events at the start. Events of the same millisecond are kept, and nothing
+      // is compared after the clock went back or was changed: a duplicate rather than a lost event.
+      skip_bytes = 0;
+      uint64_t previous_ms = 0;
+      for (NvmePersistentEventIterator it = begin(); it != end(); ++it) {
+        if (it->timestamp_ms >= last_timestamp_ms_ || it->timestamp_ms < previous_ms ||
+            it->type == nvme::NVME_PEL_TIMESTAMP_CHANGE || it->type == nvme::NVME_PEL_POWER_ON_RESET) {
+          break;
+        }
+        previous_ms = it->timestamp_ms;
+        skip_bytes += it->length;
+      }
+    }
+    events_begin_ += skip_bytes;
+    events_offset_ += skip_bytes;
+  }
+
+  for (NvmePersistentEventIterator it = begin(); it != end(); ++it) {
+    has_position_ = true;
+    last_event_offset_ = it->offset;
+    last_timestamp_ms_ = it->timestamp_ms;
+    last_type_ = it->type;
+  }
+  return { DPARME_OK, 0 };
+}
+
+NvmePersistentEventIterator NvmePersistentEventReader::begin() const {
+  if (events_begin_ >= events_end_) {
+    return NvmePersistentEventIterator();
+  }
+  return NvmePersistentEventIterator(&buffer_[events_begin_], events_end_ - events_begin_, events_offset_);
+}
+
+NvmePersistentEventIterator NvmePersistentEventReader::end() const {
+  return NvmePersistentEventIterator();
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,279 @@
+/**
+ * @file	nvme_telemetry.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <jcu-dparm/nvme_telemetry.h>
+#include <jcu-dparm/nvme_types.h>
+#include <jcu-dparm/nvme_utils.h>
+
+namespace jcu {
+namespace dparm {
+
+static const uint32_t kTelemetryBlockBytes = 512;
+static const uint32_t kTelemetryFallbackChunkBytes = 4096;
+static const int kDefaultRingBuffers = 4;
+
+namespace {
+
+/**
+ * fixed set of chunk buffers cycling between the reader (caller thread) and the writer thread
+ */
+class ChunkRing {
+ private:
+  const NvmeTelemetrySink& sink_;
+  std::vector<std::vector<unsigned char>> buffers_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<size_t> free_;
+  // index, length
+  std::deque<std::pair<size_t, size_t>> filled_;
+  bool closed_;
+  int sink_error_;
+  uint64_t written_bytes_;
+  std::thread writer_;
+
+  void writerMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cond_.wait(lock, [this]() -> bool { return closed_ || !filled_.empty(); });
+      if (filled_.empty()) {
+        break;
+      }
+      std::pair<size_t, size_t> item = filled_.front();
+      filled_.pop_front();
+      if (!sink_error_) {
+        lock.unlock();
+        int err = sink_(buffers_[item.first].data(), item.second);
+        lock.lock();
+        if (err) {
+          sink_error_ = err;
+        } else {
+          written_bytes_ += item.second;
+        }
+      }
+      free_.push_back(item.first);
+      cond_.notify_all();
+    }
+  }
+
+ public:
+  ChunkRing(const NvmeTelemetrySink& sink, int count, size_t chunk_bytes)
+      : sink_(sink), buffers_(count, std::vector<unsigned char>(chunk_bytes)),
+        closed_(false), sink_error_(0), written_bytes_(0)
+  {
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      free_.push_back(i);
+    }
+    if (buffers_.size() > 1) {
+      writer_ = std::thread(&ChunkRing::writerMain, this);
+    }
+  }
+
+  ~ChunkRing() {
+    finish();
+  }
+
+  /**
+   * wait for a free buffer
+   *
+   * @return nullptr if the sink failed
+   */
+  unsigned char *acquire(size_t *index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() -> bool { return sink_error_ || !free_.empty(); });
+    if (sink_error_) {
+      return nullptr;
+    }
+    *index = free_.front();
+    free_.pop_front();
+    return buffers_[*index].data();
+  }
+
+  void push(size_t index, size_t length) {
+    if (!writer_.joinable()) {
+      int err = sink_error_ ? sink_error_ : sink_(buffers_[index].data(), length);
+      if (err) {
+        sink_error_ = err;
+      } else {
+        written_bytes_ += length;
+      }
+      free_.push_back(index);
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    filled_.push_back(std::make_pair(index, length));
+    cond_.notify_all();
+  }
+
+  void release(size_t index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(index);
+    cond_.notify_all();
+  }
+
+  /**
+   * drain the pending chunks and stop the writer
+   *
+   * @return error of the sink
+   */
+  int finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+      cond_.notify_all();
+    }
+    if (writer_.joinable()) {
+      writer_.join();
+    }
+    return sink_error_;
+  }
+
+  uint64_t getWrittenBytes() const {
+    return written_bytes_;
+  }
+};
+
+} // namespace
+
+static DparmResult readTelemetry(DriveHandle *handle, bool create, uint64_t offset, uint32_t length, void *data) {
+  return handle->doNvmeGetLogPageCmd(
+      0xFFFFFFFFU, nvme::NVME_GET_LOG_PAGE_TELEMETRY_HOST,
+      create ? (uint8_t) nvme::NVME_TELEM_LSP_CREATE : (uint8_t) nvme::NVME_NO_LOG_LSP,
+      offset, 0, false, 0, length, data);
+}
+
+NvmeTelemetryResult captureNvmeTelemetry(DriveHandle *handle, const NvmeTelemetryOptions &options, const NvmeTelemetrySink &sink) {
+  NvmeTelemetryResult result;
+  nvme::nvme_telemetry_log_header_t header;
+
+  result.total_bytes = 0;
+  result.written_bytes = 0;
+  result.generation = 0;
+  memset(result.data_area_last_block, 0, sizeof(result.data_area_last_block));
+  result.generation_changed = false;
+
+  if (!handle->driverIsNvmeAdminPassthruSupported()) {
+    result.result = { DPARME_NOT_SUPPORTED, 0 };
+    return result;
+  }
+
+  int data_area = options.data_area ? std::min(std::max(options.data_area, 1), 4) : 3;
+  int ring_buffers = (options.ring_buffers > 0) ? options.ring_buffers : kDefaultRingBuffers;
+  uint32_t chunk_bytes = options.chunk_bytes ? options.chunk_bytes : handle->getNvmeLogChunkBytes();
+  chunk_bytes &= ~(kTelemetryBlockBytes - 1);
+  if (!chunk_bytes) {
+    chunk_bytes = kTelemetryBlockBytes;
+  }
+
+  memset(&header, 0, sizeof(header));
+  result.result = readTelemetry(handle, options.create, 0, sizeof(header), &header);
+  if (!result.result.isOk()) {
+    return result;
+  }
+  result.generation = header.hostdgn;
+  result.data_area_last_block[0] = header.dalb1;
+  result.data_area_last_block[1] = header.dalb2;
+  result.data_area_last_block[2] = header.dalb3;
+  result.data_area_last_block[3] = header.dalb4;
+
+  // the data areas are cumulative; an unreported area ends where the previous one does
+  uint64_t last_block = 0;
+  for (int i = 0; i < data_area; i++) {
+    last_block = std::max<uint64_t>(last_block, result.data_area_last_block[i]);
+  }
+  result.total_bytes = (last_block + 1) * kTelemetryBlockBytes;
+
+  ChunkRing ring(sink, ring_buffers, std::max<size_t>(chunk_bytes, sizeof(header)));
+  size_t index = 0;
+  unsigned char *buffer = ring.acquire(&index);
+  if (buffer) {
+    memcpy(buffer, &header, sizeof(header));
+    ring.push(index, sizeof(header));
+  }
+
+  uint64_t offset = sizeof(header);
+  while (offset < result.total_bytes) {
+    uint32_t length = (uint32_t) std::min<uint64_t>(chunk_bytes, result.total_bytes - offset);
+    buffer = ring.acquire(&index);
+    if (!buffer) {
+      break;
+    }
+    result.result = readTelemetry(handle, false, offset, length, buffer);
+    if (!result.result.isOk()) {
+      ring.release(index);
+      if (length > kTelemetryFallbackChunkBytes && nvme::isTransferSizeError(result.result)) {
+        // the same fallback as doNvmeGetLogPage: retry in 4k transfers
+        chunk_bytes = kTelemetryFallbackChunkBytes;
+        continue;
+      }
+      break;
+    }
+    ring.push(index, length);
+    offset += length;
+  }
+
+  int sink_error = ring.finish();
+  result.written_bytes = ring.getWrittenBytes();
+  if (!result.result.isOk()) {
+    return result;
+  }
+  if (sink_error) {
+    result.result = { DPARME_SYS, sink_error };
+    return result;
+  }
+
+  nvme::nvme_telemetry_log_header_t check;
+  memset(&check, 0, sizeof(check));
+  result.result = readTelemetry(handle, false, 0, sizeof(check), &check);
+  if (result.result.isOk() && check.hostdgn != header.hostdgn) {
+    result.generation_changed = true;
+    result.result = { DPARME_ILLEGAL_DATA, 0 };
+  }
+  return result;
+}
+
+NvmeTelemetryResult captureNvmeTelemetry(DriveHandle *handle, const NvmeTelemetryOptions &options, int fd) {
+  return captureNvmeTelemetry(handle, options, [fd](const void *data, size_t length) -> int {
+    const unsigned char *ptr = (const unsigned char *) data;
+    while (length > 0) {
+#if defined(_WIN32)
+      int written = ::_write(fd, ptr, (unsigned int) length);
+#else
+      ssize_t written = ::write(fd, ptr, length);
+#endif
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errno;
+      }
+      ptr += written;
+      length -= (size_t) written;
+    }
+    return 0;
+  });
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -7,6 +7,8 @@
  *            of the Apache License 2.0.  See the LICENSE file for details.
  */
 
+#include <errno.h>
+
 #include <jcu-dparm/nvme_types.h>
 #include <jcu-dparm/nvme_utils.h>
 
@@ -220,6 +222,18 @@ const char *nvmeStatusToString(NvmeStatusCode status)
   }
 }
 
+bool isTransferSizeError(const DparmResult& result) {
+  switch (result.code) {
+    case DPARME_IOCTL_FAILED:
+      return result.sys_error == EINVAL || result.sys_error == ENOMEM;
+    case DPARME_NVME_FAILED:
+      // status code type and status code, without More and Do Not Retry
+      return (result.drive_status & 0x7ff) == NVME_SC_INVALID_FIELD;
+    default:
+      return false;
+  }
+}
+
 } // namespace nvme
 } // namespace dparm
 } // namespace jcu
@@ -141,16 +141,6 @@ int apt_sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
   return dev->apt_data.id.sg16_func(dev, rw, dma, tf, data, data_bytes, timeout_secs);
 }
 
-static void dump_bytes(scsi_sg_device *dev, const char *prefix, unsigned char *p, int len) {
-  int i;
-
-  if (prefix)
-    sgio_dbgprintf(dev, "%s: ", prefix);
-  for (i = 0; i < len; ++i)
-    sgio_dbgprintf(dev, " %02x", p[i]);
-  sgio_dbgprintf(dev, "\n");
-}
-
 /***** JMicron support ********/
 static int apt_jmicron_int_sg(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
                               void *data, unsigned int data_bytes, unsigned int timeout_secs,
@@ -196,12 +186,14 @@ static int apt_jmicron_int_sg(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_
   io_hdr.cmd_len = sizeof(cdb);
 
   if (dev->apt_data.verbose >= jcu::dparm::kVerboseDebug)
-    dump_bytes(dev, "outgoing cdb", cdb, sizeof(cdb));
+    sgio_dump_bytes(dev, "outgoing cdb", cdb, sizeof(cdb));
   if (ioctl(dev->fd, SG_IO, &io_hdr) == -1) {
+    dev->last_resid = io_hdr.dxfer_len;
     if (dev->apt_data.verbose >= jcu::dparm::kVerboseError)
       perror("ioctl(fd,SG_IO)");
     return -1;      /* SG_IO not supported */
   }
+  dev->last_resid = io_hdr.resid;
   if (dev->apt_data.verbose >= jcu::dparm::kVerboseDebug)
     sgio_dbgprintf(dev, "SG_IO: ATA_%u status=0x%x, host_status=0x%x, driver_status=0x%x\n",
             io_hdr.cmd_len, io_hdr.status, io_hdr.host_status, io_hdr.driver_status);
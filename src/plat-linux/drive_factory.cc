@@ -9,23 +9,39 @@
 
 #include <map>
 #include <list>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
 
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <linux/limits.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/major.h>
 
 #include <jcu-dparm/drive_factory.h>
 #include <jcu-dparm/drive_handle.h>
+#include <jcu-dparm/drive_inventory.h>
 
 #include "../drive_driver_handle.h"
 #include "../drive_handle_base.h"
+#include "../intl_utils.h"
+#include "../identity_cache.h"
+#include "../drive_filter.h"
+#include "../shared_handle_cache.h"
 
 #include "driver_base.h"
 #include "drivers/sg_driver.h"
 #include "drivers/nvme_driver.h"
 
+#include "sysfs_utils.h"
 #include "volume_finder.h"
+#include "uevent_source.h"
+#include "sg_async_queue.h"
 
 namespace jcu {
 namespace dparm {
@@ -45,10 +61,25 @@ class LinuxDriveHandle : public DriveHandleBase {
  public:
   LinuxDriveHandle(const DriveFactoryOptions& options, const std::string& path, std::unique_ptr<LinuxDriverHandle> handle, DparmResult open_result)
       : DriveHandleBase(options, path, open_result), handle_(std::move(handle)), last_error_(open_result) {
+    if (!path.compare(0, 5, "/dev/")) {
+      drive_info_.linux_dev_name = path.substr(5);
+    }
+  }
+
+  bool init(const EnumDrivesFilter* filter) {
+    return afterOpen(filter);
+  }
+
+  bool initFromCache(const IdentityCacheEntry& cached, const EnumDrivesFilter* filter) {
+    return afterOpen(cached, filter);
   }
 
-  void init() {
-    afterOpen();
+  /**
+   * copy the fields which only sysfs knows
+   */
+  void mergeSysfsInfo(const DriveInfo& sysfs_info) {
+    drive_info_.wwid = sysfs_info.wwid;
+    drive_info_.is_removable = sysfs_info.is_removable;
   }
 
   bool isOpen() const override {
@@ -71,6 +102,108 @@ class LinuxDriveFactory : public DriveFactory {
  private:
   const DriveFactoryOptions options_;
   std::list<std::unique_ptr<DriverBase>> drivers_;
+  std::unique_ptr<IdentityCache> identity_cache_;
+  mutable SharedHandleCache shared_handles_;
+
+  // dev_t -> driver which opened it last time
+  mutable std::mutex affinity_mutex_;
+  mutable std::map<dev_t, DriverBase*> driver_affinity_;
+
+  DriverBase* findDriver(const std::string& driver_name) const {
+    for (auto drv_it = drivers_.cbegin(); drv_it != drivers_.cend(); drv_it++) {
+      if ((*drv_it)->getDriverName() == driver_name) {
+        return drv_it->get();
+      }
+    }
+    return nullptr;
+  }
+
+  static bool isScsiMajor(unsigned int dev_major) {
+    return (dev_major == SCSI_DISK0_MAJOR) ||
+        (dev_major >= SCSI_DISK1_MAJOR && dev_major <= SCSI_DISK7_MAJOR) ||
+        (dev_major >= SCSI_DISK8_MAJOR && dev_major <= SCSI_DISK15_MAJOR) ||
+        (dev_major == SCSI_CDROM_MAJOR) ||
+        (dev_major == SCSI_GENERIC_MAJOR);
+  }
+
+  /**
+   * guess the driver without opening the device
+   *
+   * @return nullptr if unknown
+   */
+  DriverBase* hintDriver(const struct stat& s) const {
+    unsigned int dev_major = major(s.st_rdev);
+    if (S_ISCHR(s.st_mode)) {
+      // /dev/nvmeX controller or /dev/sgN
+      return findDriver((dev_major == SCSI_GENERIC_MAJOR) ? drivers::SgDriver::kDriverName : drivers::NvmeDriver::kDriverName);
+    }
+    if (isScsiMajor(dev_major)) {
+      return findDriver(drivers::SgDriver::kDriverName);
+    }
+
+    // dynamic majors (nvme namespaces use blkext)
+    char link_buf[PATH_MAX];
+    char sys_path[64];
+    snprintf(sys_path, sizeof(sys_path), "/sys/dev/block/%u:%u/device/subsystem", dev_major, minor(s.st_rdev));
+    ssize_t link_len = readlink(sys_path, link_buf, sizeof(link_buf) - 1);
+    if (link_len > 0) {
+      link_buf[link_len] = 0;
+      const char* subsystem = strrchr(link_buf, '/');
+      subsystem = subsystem ? subsystem + 1 : link_buf;
+      if (!strcmp(subsystem, "nvme")) {
+        return findDriver(drivers::NvmeDriver::kDriverName);
+      } else if (!strcmp(subsystem, "scsi")) {
+        return findDriver(drivers::SgDriver::kDriverName);
+      }
+    }
+    return nullptr;
+  }
+
+  /**
+   * memoized driver, then hinted driver, then the others in registration order
+   *
+   * @return true if order[0] is the memoized or hinted driver
+   */
+  bool getProbeOrder(const char *drive_path, std::vector<DriverBase*>& order, dev_t* rdev) const {
+    struct stat s = {0};
+    *rdev = 0;
+    if (stat(drive_path, &s) != -1 && (S_ISBLK(s.st_mode) || S_ISCHR(s.st_mode))) {
+      *rdev = s.st_rdev;
+      DriverBase* preferred = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(affinity_mutex_);
+        auto it = driver_affinity_.find(s.st_rdev);
+        if (it != driver_affinity_.end()) {
+          preferred = it->second;
+        }
+      }
+      if (!preferred) {
+        preferred = hintDriver(s);
+      }
+      if (preferred) {
+        order.push_back(preferred);
+      }
+    }
+    bool preferred = !order.empty();
+    for (auto drv_it = drivers_.cbegin(); drv_it != drivers_.cend(); drv_it++) {
+      if (order.empty() || order[0] != drv_it->get()) {
+        order.push_back(drv_it->get());
+      }
+    }
+    return preferred;
+  }
+
+  void setDriverAffinity(dev_t rdev, DriverBase* driver) const {
+    if (!rdev) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(affinity_mutex_);
+    if (driver) {
+      driver_affinity_[rdev] = driver;
+    } else {
+      driver_affinity_.erase(rdev);
+    }
+  }
 
  public:
   LinuxDriveFactory(const DriveFactoryOptions& options)
@@ -78,26 +211,283 @@ class LinuxDriveFactory : public DriveFactory {
   {
     drivers_.emplace_back(std::unique_ptr<DriverBase>(new drivers::NvmeDriver(options_)));
     drivers_.emplace_back(std::unique_ptr<DriverBase>(new drivers::SgDriver(options_)));
+    if (!options_.identity_cache_file.empty()) {
+      identity_cache_.reset(new IdentityCache(options_.identity_cache_file));
+      identity_cache_->load();
+    }
   }
 
   std::unique_ptr<DriveHandle> open(const char *drive_path) const override {
+    std::unique_ptr<LinuxDriveHandle> drive_handle(openDrive(drive_path, nullptr));
+    if (identity_cache_) {
+      identity_cache_->save();
+    }
+    return std::move(drive_handle);
+  }
+
+  std::shared_ptr<DriveHandle> openShared(const char *drive_path) const override {
+    struct stat s = {0};
+    if (stat(drive_path, &s) == -1) {
+      invalidateShared(drive_path);
+      return open(drive_path);
+    }
+    return shared_handles_.get(drive_path, s.st_rdev, [this, drive_path]() -> std::unique_ptr<DriveHandle> {
+      return open(drive_path);
+    });
+  }
+
+  void invalidateShared(const char *drive_path) const override {
+    shared_handles_.invalidate(drive_path);
+  }
+
+  /**
+   * @param filter (in) nullable
+   * @return nullptr if the drive is excluded by the filter
+   */
+  std::unique_ptr<LinuxDriveHandle> openDrive(const char *drive_path, const EnumDrivesFilter* filter) const {
     DparmReturn<std::unique_ptr<LinuxDriverHandle>> driver_handle;
+    IdentityCacheEntry cached;
+    bool use_cache = false;
 
-    for (auto drv_it = drivers_.cbegin(); drv_it != drivers_.cend(); drv_it++) {
-      driver_handle = std::move((*drv_it)->open(drive_path));
-      if (driver_handle.isOk()) {
-        break;
+    if (identity_cache_ && readOsIdentity(drive_path, cached)) {
+      std::string os_identity = cached.os_identity;
+      if (identity_cache_->find(cached.device_key, os_identity, &cached)) {
+        DriverBase* driver = findDriver(cached.driver_name);
+        if (driver) {
+          driver_handle = std::move(driver->open(drive_path, cached));
+          use_cache = driver_handle.isOk();
+        }
+        if (!use_cache) {
+          identity_cache_->remove(cached.device_key);
+        }
+      }
+    }
+
+    if (!use_cache) {
+      std::vector<DriverBase*> probe_order;
+      DriverBase* opened_driver = nullptr;
+      dev_t rdev;
+      bool preferred = getProbeOrder(drive_path, probe_order, &rdev);
+      DparmResult preferred_result;
+      for (auto drv_it = probe_order.cbegin(); drv_it != probe_order.cend(); drv_it++) {
+        driver_handle = std::move((*drv_it)->open(drive_path));
+        if (driver_handle.isOk()) {
+          opened_driver = *drv_it;
+          break;
+        }
+        if (drv_it == probe_order.cbegin()) {
+          preferred_result = driver_handle;
+        }
+      }
+      if (!opened_driver && preferred) {
+        // the error of the driver which matches the device tells more than the last one
+        driver_handle = DparmReturn<std::unique_ptr<LinuxDriverHandle>>(preferred_result, nullptr);
       }
+      setDriverAffinity(rdev, opened_driver);
     }
 
     std::unique_ptr<LinuxDriveHandle> drive_handle(new LinuxDriveHandle(options_, drive_path, std::move(driver_handle.value), driver_handle));
     if (driver_handle.isOk()) {
-      drive_handle->init();
+      if (use_cache) {
+        if (!drive_handle->initFromCache(cached, filter)) {
+          return nullptr;
+        }
+      } else {
+        if (!drive_handle->init(filter)) {
+          return nullptr;
+        }
+        // an entry is complete only after TCG Discovery 0
+        if (identity_cache_ && !cached.os_identity.empty() && !drive_handle->isTcgDiscoveryPending() &&
+            drive_handle->getDriveInfo().tcg_support >= 0) {
+          drive_handle->exportIdentity(cached);
+          identity_cache_->put(cached);
+        }
+      }
+    } else if (filter) {
+      // nothing is known but the path
+      const DriveInfo& drive_info = drive_handle->getDriveInfo();
+      if (!matchDriveFilter(*filter, kFilterStageIdentify, drive_info) || !matchDriveFilter(*filter, kFilterStageTcg, drive_info)) {
+        return nullptr;
+      }
     }
-    return std::move(drive_handle);
+    return drive_handle;
+  }
+
+  /**
+   * read the device number and the identity which the kernel knows without any command.
+   * The firmware revision is a part of the identity, so an updated drive is probed again.
+   *
+   * @return true if entry->device_key and entry->os_identity are filled
+   */
+  static bool readOsIdentity(const char *drive_path, IdentityCacheEntry& entry) {
+    static const char* const identity_attrs[] = { "device/wwid", "wwid", "device/serial", "serial" };
+    static const char* const firmware_attrs[] = { "device/firmware_rev", "device/rev" };
+    struct stat s = {0};
+    if (stat(drive_path, &s) == -1 || !S_ISBLK(s.st_mode)) {
+      return false;
+    }
+
+    char sys_path[64];
+    snprintf(sys_path, sizeof(sys_path), "/sys/dev/block/%u:%u/", major(s.st_rdev), minor(s.st_rdev));
+    for (size_t i = 0; i < sizeof(identity_attrs) / sizeof(identity_attrs[0]); i++) {
+      std::string value;
+      if (!sysfs_read_string(std::string(sys_path) + identity_attrs[i], &value)) {
+        value = intl::trimString(value);
+        if (!value.empty()) {
+          entry.device_key = s.st_rdev;
+          entry.os_identity = identity_attrs[i];
+          entry.os_identity.append(":");
+          entry.os_identity.append(value);
+          break;
+        }
+      }
+    }
+    if (entry.os_identity.empty()) {
+      return false;
+    }
+    for (size_t i = 0; i < sizeof(firmware_attrs) / sizeof(firmware_attrs[0]); i++) {
+      std::string value;
+      if (!sysfs_read_string(std::string(sys_path) + firmware_attrs[i], &value)) {
+        value = intl::trimString(value);
+        if (!value.empty()) {
+          entry.os_identity.append(";rev:");
+          entry.os_identity.append(value);
+          break;
+        }
+      }
+    }
+    return true;
   }
 
   int enumDrives(std::list<DriveInfo> &result_list) const override {
+    return enumDrives(result_list, EnumDrivesOptions());
+  }
+
+  int enumDrives(std::list<DriveInfo> &result_list, const EnumDrivesOptions& options) const override {
+    std::vector<std::string> dev_names;
+    int rc = findBlockDevices(dev_names);
+    if (rc) {
+      return rc;
+    }
+
+    std::vector<DriveInfo> drive_infos(dev_names.size());
+    std::vector<char> matched(dev_names.size(), 0);
+    intl::parallelFor(dev_names.size(), options.parallel, [this, &options, &dev_names, &drive_infos, &matched](size_t index) -> void {
+      matched[index] = (probeDevName(dev_names[index], options, &drive_infos[index], nullptr) == 0);
+    });
+    if (identity_cache_) {
+      identity_cache_->save();
+    }
+
+    for (size_t i = 0; i < drive_infos.size(); i++) {
+      if (matched[i]) {
+        result_list.emplace_back(std::move(drive_infos[i]));
+      }
+    }
+    return 0;
+  }
+
+  int enumDrives(const EnumDrivesCallback& callback, const EnumDrivesOptions& options) const override {
+    std::vector<std::string> dev_names;
+    int rc = findBlockDevices(dev_names);
+    if (rc) {
+      return rc;
+    }
+
+    std::mutex callback_mutex;
+    std::atomic<bool> stopped(false);
+    intl::parallelFor(dev_names.size(), options.parallel, [this, &options, &dev_names, &callback, &callback_mutex, &stopped](size_t index) -> void {
+      if (stopped) {
+        return;
+      }
+      std::unique_ptr<DriveHandle> handle;
+      DriveInfo basic_info;
+      if (probeDevName(dev_names[index], options, (options.level == kEnumBasic) ? &basic_info : nullptr, &handle)) {
+        return;
+      }
+      if (handle) {
+        handle->runPendingTcgDiscovery();
+      }
+      // a copy: the handle may be moved out and closed by the callback
+      DriveInfo drive_info = handle ? handle->getDriveInfo() : std::move(basic_info);
+      std::lock_guard<std::mutex> lock(callback_mutex);
+      if (!stopped && !callback(drive_info, handle)) {
+        stopped = true;
+      }
+    });
+    if (identity_cache_) {
+      identity_cache_->save();
+    }
+    return 0;
+  }
+
+  int probeDrive(const char *drive_path, DriveInfo &drive_info, const EnumDrivesOptions &options) const override {
+    std::string dev_name(drive_path);
+    size_t pos = dev_name.rfind('/');
+    if (pos != std::string::npos) {
+      dev_name = dev_name.substr(pos + 1);
+    }
+    if (dev_name.empty()) {
+      return EINVAL;
+    }
+    return probeDevName(dev_name, options, &drive_info, nullptr);
+  }
+
+  std::unique_ptr<DeviceEventSource> createDeviceEventSource() const override {
+    std::unique_ptr<UeventSource> source(new UeventSource());
+    if (source->init()) {
+      return nullptr;
+    }
+    return std::move(source);
+  }
+
+  std::unique_ptr<AsyncCommandQueue> createAsyncCommandQueue() const override {
+    return std::unique_ptr<AsyncCommandQueue>(new SgAsyncQueue(options_));
+  }
+
+  /**
+   * sysfs stage, then open with the filter unless kEnumBasic
+   *
+   * @param drive_info (out) nullable
+   * @param handle     (out) nullable. opened handle (nullptr with kEnumBasic)
+   * @return zero if successful, ENODEV if the drive is excluded by options.filter, otherwise errno.
+   */
+  int probeDevName(const std::string& dev_name, const EnumDrivesOptions& options, DriveInfo* drive_info, std::unique_ptr<DriveHandle>* handle) const {
+    std::string devpath = "/dev/" + dev_name;
+    DriveInfo sysfs_info;
+    if (access(("/sys/block/" + dev_name).c_str(), F_OK) == -1) {
+      return errno;
+    }
+    sysfs_info.device_path = devpath;
+    sysfs_info.linux_dev_name = dev_name;
+    readSysfsDriveInfo(dev_name, sysfs_info);
+    if (!matchDriveFilter(options.filter, kFilterStageSysfs, sysfs_info)) {
+      return ENODEV;
+    }
+
+    if (options.level == kEnumBasic) {
+      if (drive_info) {
+        *drive_info = std::move(sysfs_info);
+      }
+      return 0;
+    }
+
+    auto drive_handle = openDrive(devpath.c_str(), &options.filter);
+    if (!drive_handle) {
+      return ENODEV;
+    }
+    drive_handle->mergeSysfsInfo(sysfs_info);
+    if (drive_info) {
+      drive_handle->runPendingTcgDiscovery();
+      *drive_info = drive_handle->getDriveInfo();
+    }
+    if (handle) {
+      *handle = std::move(drive_handle);
+    }
+    return 0;
+  }
+
+  static int findBlockDevices(std::vector<std::string>& dev_names) {
     DIR* block_dir = opendir("/sys/block/");
     struct dirent* entry;
     if (!block_dir) {
@@ -110,15 +500,74 @@ class LinuxDriveFactory : public DriveFactory {
       devpath.append(entry->d_name);
       if (!strstr(entry->d_name, "loop") && (stat(devpath.c_str(), &s) != -1)) {
         if (S_ISBLK(s.st_mode)) {
-          auto handle = open(devpath.c_str());
-          result_list.emplace_back(handle->getDriveInfo());
+          dev_names.emplace_back(entry->d_name);
         }
       }
     }
     closedir(block_dir);
+
+    // readdir order is not stable
+    std::sort(dev_names.begin(), dev_names.end());
     return 0;
   }
 
+  /**
+   * fill DriveInfo from /sys/block/<dev_name> without any passthrough command
+   */
+  static void readSysfsDriveInfo(const std::string& dev_name, DriveInfo& drive_info) {
+    std::string block_path = "/sys/block/" + dev_name;
+    std::string device_path = block_path + "/device";
+    std::string value;
+
+    char link_buf[PATH_MAX];
+    ssize_t link_len = readlink((device_path + "/subsystem").c_str(), link_buf, sizeof(link_buf) - 1);
+    if (link_len > 0) {
+      link_buf[link_len] = 0;
+      const char* subsystem = strrchr(link_buf, '/');
+      subsystem = subsystem ? subsystem + 1 : link_buf;
+      if (!strcmp(subsystem, "nvme")) {
+        drive_info.driving_type = kDrivingNvme;
+      } else if (!strcmp(subsystem, "scsi")) {
+        // libata exposes "ATA" as the vendor of SATA disks
+        if (!sysfs_read_string(device_path + "/vendor", &value) && value == "ATA") {
+          drive_info.driving_type = kDrivingAtapi;
+        }
+      }
+    }
+
+    if (!sysfs_read_string(device_path + "/model", &value)) {
+      drive_info.model = intl::trimString(value);
+    }
+
+    if (!sysfs_read_string(device_path + "/serial", &value) || !sysfs_read_string(block_path + "/serial", &value)) {
+      drive_info.serial = intl::trimString(value);
+    } else if (!sysfs_read_string(device_path + "/vpd_pg80", &value) && value.size() > 4) {
+      // Unit Serial Number VPD page: 4 bytes header
+      drive_info.serial = intl::trimString(value.substr(4));
+    }
+
+    if (!sysfs_read_string(device_path + "/firmware_rev", &value) || !sysfs_read_string(device_path + "/rev", &value)) {
+      drive_info.firmware_revision = intl::trimString(value);
+    }
+
+    if (!sysfs_read_string(device_path + "/wwid", &value) || !sysfs_read_string(block_path + "/wwid", &value)) {
+      drive_info.wwid = intl::trimString(value);
+    }
+
+    if (!sysfs_read_string(block_path + "/size", &value)) {
+      // always 512-byte sectors
+      drive_info.total_capacity = strtoll(value.c_str(), nullptr, 10) * 512;
+    }
+
+    if (!sysfs_read_string(block_path + "/queue/rotational", &value)) {
+      drive_info.is_ssd = (value == "0");
+    }
+
+    if (!sysfs_read_string(block_path + "/removable", &value)) {
+      drive_info.is_removable = (value == "1");
+    }
+  }
+
   std::unique_ptr<EnumVolumesContext> enumVolumes() const override {
     std::unique_ptr<LinuxEnumVolumesContext> ctx(new LinuxEnumVolumesContext());
     ctx->init();
@@ -140,11 +589,15 @@ static int debugToStderrPuts(const std::string& text) {
   return fputs(text.c_str(), stderr);
 }
 
+static DriveFactoryOptions systemFactoryOptions() {
+  DriveFactoryOptions options;
+  options.debug_puts = debugToStderrPuts;
+  options.verbose = kVerboseInfo;
+  return options;
+}
+
 DriveFactory* DriveFactory::getSystemFactory() {
-  static DriveFactoryOptions options = {
-      debugToStderrPuts,
-      kVerboseInfo
-  };
+  static DriveFactoryOptions options = systemFactoryOptions();
   static plat_linux::LinuxDriveFactory INSTANCE(options);
   return &INSTANCE;
 }
@@ -16,6 +16,7 @@
 #include <jcu-dparm/err.h>
 
 #include "../drive_driver_handle.h"
+#include "../identity_cache.h"
 
 namespace jcu {
 namespace dparm {
@@ -36,7 +37,13 @@ class DriverBase {
  public:
   DriverBase(const DriveFactoryOptions& options) : options_(options) {}
   virtual ~DriverBase() {}
+  virtual std::string getDriverName() const = 0;
   virtual DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char* path) = 0;
+  /**
+   * open the device known to be of this driver by the cache entry.
+   * The driver may use identify data of the entry instead of issuing IDENTIFY.
+   */
+  virtual DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char* path, const IdentityCacheEntry& cached) = 0;
 };
 
 } // namespace plat_win
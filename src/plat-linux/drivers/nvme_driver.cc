@@ -7,36 +7,135 @@
  *            of the Apache License 2.0.  See the LICENSE file for details.
  */
 
+#include <stddef.h>
 #include <unistd.h>
 #include <sys/fcntl.h>
+#include <sys/uio.h>
 
 #include "nvme_driver.h"
 #include "nvme_ioctl.h"
+#include "../sysfs_utils.h"
 
 namespace jcu {
 namespace dparm {
 namespace plat_linux {
 namespace drivers {
 
+const char* const NvmeDriver::kDriverName = "LinuxNvmeDriver";
+
+// DparmIoVec is passed to NVME_IOCTL_IO64_CMD_VEC as struct iovec
+static_assert(sizeof(DparmIoVec) == sizeof(struct iovec) &&
+              offsetof(DparmIoVec, base) == offsetof(struct iovec, iov_base) &&
+              offsetof(DparmIoVec, length) == offsetof(struct iovec, iov_len),
+              "DparmIoVec must match struct iovec");
+
 class NvmeDriverHandle : public LinuxDriverHandle {
  private:
   int fd_;
   int ns_id_;
+  TraceRing *trace_ring_;
+  LatencyStats *latency_stats_;
+  /**
+   * used for commands without timeout_ms. 0 : kernel default
+   */
+  uint32_t default_timeout_ms_;
+
+  template<class T>
+  void trace(TraceRecordType type, const T& data, uint64_t issued_ns, int rc, int err) {
+    TraceNvmeCmd cmd = {0};
+    cmd.opcode = data.opcode;
+    cmd.flags = data.flags;
+    cmd.nsid = data.nsid;
+    cmd.cdw10[0] = data.cdw10;
+    cmd.cdw10[1] = data.cdw11;
+    cmd.cdw10[2] = data.cdw12;
+    cmd.cdw10[3] = data.cdw13;
+    cmd.cdw10[4] = data.cdw14;
+    cmd.cdw10[5] = data.cdw15;
+    trace_ring_->record(
+        type, issued_ns, (uint32_t) ((TraceRing::now() - issued_ns) / 1000),
+        (rc == -1) ? -err : rc, &cmd, sizeof(cmd));
+  }
+
+  /**
+   * @param request (in) NVME_IOCTL_ADMIN64_CMD, NVME_IOCTL_IO64_CMD or NVME_IOCTL_IO64_CMD_VEC
+   * @param addr    (in) data buffer, or struct iovec array for the vectored command
+   * @param length  (in) data bytes, or number of segments for the vectored command
+   */
+  DparmReturn<int> doPassthru64(unsigned long request, nvme::nvme_passthru_cmd64_t *cmd, uint64_t addr, uint32_t length) {
+    bool admin = (request == NVME_IOCTL_ADMIN64_CMD);
+    nvme_ioctl_passthru_cmd64_t data = {0};
+    data.opcode = cmd->opcode;
+    data.flags = cmd->flags;
+    data.rsvd1 = cmd->rsvd1;
+    data.nsid = cmd->nsid;
+    data.cdw2 = cmd->cdw2;
+    data.cdw3 = cmd->cdw3;
+    data.metadata = cmd->metadata;
+    data.addr = addr;
+    data.metadata_len = cmd->metadata_len;
+    data.data_len = length;
+    data.cdw10 = cmd->cdw10;
+    data.cdw11 = cmd->cdw11;
+    data.cdw12 = cmd->cdw12;
+    data.cdw13 = cmd->cdw13;
+    data.cdw14 = cmd->cdw14;
+    data.cdw15 = cmd->cdw15;
+    data.timeout_ms = cmd->timeout_ms ? cmd->timeout_ms : default_timeout_ms_;
+    data.result = cmd->result;
+    uint64_t issued_ns = (trace_ring_ || latency_stats_) ? TraceRing::now() : 0;
+    int rc = ioctl(fd_, request, &data);
+    if (latency_stats_ || trace_ring_) {
+      int err = errno;
+      if (latency_stats_) {
+        latency_stats_->record(admin ? kLatencyNvmeAdmin : kLatencyNvmeIo, data.opcode, (TraceRing::now() - issued_ns) / 1000, rc != 0);
+      }
+      if (trace_ring_) {
+        trace(admin ? kTraceNvmeAdmin : kTraceNvmeIo, data, issued_ns, rc, err);
+      }
+      errno = err;
+    }
+    if (rc == -1) {
+      // kernels without the 64-bit or the vectored command
+      return { (errno == ENOTTY) ? DPARME_NOT_SUPPORTED : DPARME_IOCTL_FAILED, errno };
+    }
+    cmd->result = data.result;
+    if (rc) {
+      return { DPARME_NVME_FAILED, 0, rc, {} };
+    }
+    return { DPARME_OK, 0, rc, rc };
+  }
 
  public:
   std::string getDriverName() const override {
-    return "LinuxNvmeDriver";
+    return NvmeDriver::kDriverName;
   }
 
-  NvmeDriverHandle(int fd, int nsid)
-      : fd_(fd), ns_id_(nsid) {
+  NvmeDriverHandle(int fd, int nsid, uint32_t default_timeout_ms)
+      : fd_(fd), ns_id_(nsid), trace_ring_(nullptr), latency_stats_(nullptr), default_timeout_ms_(default_timeout_ms) {
     driving_type_ = kDrivingNvme;
   }
 
+  void setTraceRing(TraceRing *trace_ring) override {
+    trace_ring_ = trace_ring;
+  }
+
+  void setLatencyStats(LatencyStats *latency_stats) override {
+    latency_stats_ = latency_stats;
+  }
+
   int getFD() const override {
     return fd_;
   }
 
+  uint32_t getMaxTransferBytes() const override {
+    unsigned int max_hw_sectors_kb = 0;
+    if (sysfs_get_attr(fd_, "queue/max_hw_sectors_kb", "%u", &max_hw_sectors_kb, nullptr, 0)) {
+      return 0;
+    }
+    return max_hw_sectors_kb * 1024;
+  }
+
   void close() override {
     if (fd_ > 0) {
       ::close(fd_);
@@ -60,6 +159,10 @@ class NvmeDriverHandle : public LinuxDriverHandle {
     return result;
   }
 
+  void setIdentify(const std::vector<unsigned char>& identify_buf) {
+    nvme_identify_device_buf_ = identify_buf;
+  }
+
   bool driverIsNvmeAdminPassthruSupported() const override {
     return true;
   }
@@ -82,12 +185,24 @@ class NvmeDriverHandle : public LinuxDriverHandle {
     data.cdw13 = cmd->cdw13;
     data.cdw14 = cmd->cdw14;
     data.cdw15 = cmd->cdw15;
-    data.timeout_ms = cmd->timeout_ms;
+    data.timeout_ms = cmd->timeout_ms ? cmd->timeout_ms : default_timeout_ms_;
     data.result = cmd->result;
+    uint64_t issued_ns = (trace_ring_ || latency_stats_) ? TraceRing::now() : 0;
     int rc = ioctl(fd_, NVME_IOCTL_ADMIN_CMD, &data);
+    if (latency_stats_ || trace_ring_) {
+      int err = errno;
+      if (latency_stats_) {
+        latency_stats_->record(kLatencyNvmeAdmin, data.opcode, (TraceRing::now() - issued_ns) / 1000, rc != 0);
+      }
+      if (trace_ring_) {
+        trace(kTraceNvmeAdmin, data, issued_ns, rc, err);
+      }
+      errno = err;
+    }
     if (rc == -1) {
       return { DPARME_IOCTL_FAILED, errno };
     }
+    cmd->result = data.result;
     if (rc) {
       return { DPARME_NVME_FAILED, 0, rc, {} };
     }
@@ -116,12 +231,24 @@ class NvmeDriverHandle : public LinuxDriverHandle {
     data.cdw13 = cmd->cdw13;
     data.cdw14 = cmd->cdw14;
     data.cdw15 = cmd->cdw15;
-    data.timeout_ms = cmd->timeout_ms;
+    data.timeout_ms = cmd->timeout_ms ? cmd->timeout_ms : default_timeout_ms_;
     data.result = cmd->result;
+    uint64_t issued_ns = (trace_ring_ || latency_stats_) ? TraceRing::now() : 0;
     int rc = ioctl(fd_, NVME_IOCTL_IO_CMD, &data);
+    if (latency_stats_ || trace_ring_) {
+      int err = errno;
+      if (latency_stats_) {
+        latency_stats_->record(kLatencyNvmeIo, data.opcode, (TraceRing::now() - issued_ns) / 1000, rc != 0);
+      }
+      if (trace_ring_) {
+        trace(kTraceNvmeIo, data, issued_ns, rc, err);
+      }
+      errno = err;
+    }
     if (rc == -1) {
       return { DPARME_IOCTL_FAILED, errno };
     }
+    cmd->result = data.result;
     if (rc) {
       return { DPARME_NVME_FAILED, 0, rc, {} };
     }
@@ -132,6 +259,29 @@ class NvmeDriverHandle : public LinuxDriverHandle {
     return true;
   }
 
+  bool driverIsNvmePassthru64Supported() const override {
+    return true;
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru64(nvme::nvme_passthru_cmd64_t *cmd) override {
+    return doPassthru64(NVME_IOCTL_ADMIN64_CMD, cmd, cmd->addr, cmd->data_len);
+  }
+
+  DparmReturn<int> doNvmeIoPassthru64(nvme::nvme_passthru_cmd64_t *cmd) override {
+    return doPassthru64(NVME_IOCTL_IO64_CMD, cmd, cmd->addr, cmd->data_len);
+  }
+
+  DparmReturn<int> doNvmeIoPassthru64V(nvme::nvme_passthru_cmd64_t *cmd, const DparmIoVec *iov, unsigned int iov_count) override {
+    if (!iov || !iov_count) {
+      return { DPARME_ILLEGAL_DATA, EINVAL };
+    }
+    return doPassthru64(NVME_IOCTL_IO64_CMD_VEC, cmd, (uint64_t) (uintptr_t) iov, iov_count);
+  }
+
+  uint32_t getNvmeNamespaceId() const override {
+    return (ns_id_ > 0) ? (uint32_t) ns_id_ : 0;
+  }
+
   DparmReturn<int> doNvmeIo(nvme::nvme_user_io_t *io) override {
     nvme_ioctl_user_io_t data = {0};
     data.opcode = io->opcode;
@@ -146,7 +296,13 @@ class NvmeDriverHandle : public LinuxDriverHandle {
     data.reftag = io->reftag;
     data.apptag = io->apptag;
     data.appmask = io->appmask;
+    uint64_t issued_ns = latency_stats_ ? TraceRing::now() : 0;
     int rc = ioctl(fd_, NVME_IOCTL_SUBMIT_IO, &data);
+    if (latency_stats_) {
+      int err = errno;
+      latency_stats_->record(kLatencyNvmeIo, data.opcode, (TraceRing::now() - issued_ns) / 1000, rc != 0);
+      errno = err;
+    }
     if (rc == -1) {
       return { DPARME_IOCTL_FAILED, errno };
     }
@@ -157,7 +313,22 @@ class NvmeDriverHandle : public LinuxDriverHandle {
   }
 };
 
+std::string NvmeDriver::getDriverName() const {
+  return kDriverName;
+}
+
 DparmReturn<std::unique_ptr<LinuxDriverHandle>> NvmeDriver::open(const char *path) {
+  return open(path, nullptr);
+}
+
+DparmReturn<std::unique_ptr<LinuxDriverHandle>> NvmeDriver::open(const char *path, const IdentityCacheEntry& cached) {
+  if (cached.nvme_identify.size() != 4096) {
+    return { DPARME_ILLEGAL_DATA, 0 };
+  }
+  return open(path, &cached.nvme_identify);
+}
+
+DparmReturn<std::unique_ptr<LinuxDriverHandle>> NvmeDriver::open(const char *path, const std::vector<unsigned char> *cached_identify) {
   std::string strpath(path);
   DparmResult result;
   int fd;
@@ -176,7 +347,11 @@ DparmReturn<std::unique_ptr<LinuxDriverHandle>> NvmeDriver::open(const char *pat
       break;
     }
 
-    std::unique_ptr<NvmeDriverHandle> driver_handle(new NvmeDriverHandle(fd, nsid));
+    std::unique_ptr<NvmeDriverHandle> driver_handle(new NvmeDriverHandle(fd, nsid, options_.retry_policy.timeout_secs[kTimeoutDefault] * 1000));
+    if (cached_identify) {
+      driver_handle->setIdentify(*cached_identify);
+      return {DPARME_OK, 0, 0, std::move(driver_handle)};
+    }
     auto identify_result = driver_handle->readIdentify();
     result = identify_result;
     return {result.code, result.sys_error, result.drive_status, std::move(driver_handle)};
@@ -10,6 +10,8 @@
 #ifndef JCU_DPARM_SRC_PLAT_LINUX_DRIVERS_NVME_DRIVER_H_
 #define JCU_DPARM_SRC_PLAT_LINUX_DRIVERS_NVME_DRIVER_H_
 
+#include <vector>
+
 #include "../driver_base.h"
 
 namespace jcu {
@@ -18,9 +20,16 @@ namespace plat_linux {
 namespace drivers {
 
 class NvmeDriver : public DriverBase {
+ private:
+  DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char *path, const std::vector<unsigned char> *cached_identify);
+
  public:
+  static const char* const kDriverName;
+
   NvmeDriver(const DriveFactoryOptions& options) : DriverBase(options) {}
+  std::string getDriverName() const override;
   DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char *path) override;
+  DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char *path, const IdentityCacheEntry& cached) override;
 };
 
 } // naemspace drivers
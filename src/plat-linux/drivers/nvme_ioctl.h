@@ -93,6 +93,7 @@ enum NvmeIoctl {
   NVME_IOCTL_RESCAN = _IO('N', 0x46),
   NVME_IOCTL_ADMIN64_CMD = _IOWR('N', 0x47, nvme_ioctl_passthru_cmd64_t),
   NVME_IOCTL_IO64_CMD = _IOWR('N', 0x48, nvme_ioctl_passthru_cmd64_t),
+  NVME_IOCTL_IO64_CMD_VEC = _IOWR('N', 0x49, nvme_ioctl_passthru_cmd64_t),
 };
 
 } // namespace drivers
@@ -28,6 +28,8 @@ namespace dparm {
 namespace plat_linux {
 namespace drivers {
 
+const char* const SgDriver::kDriverName = "LinuxSgDriver";
+
 class SgDriverHandle : public LinuxDriverHandle {
  private:
   scsi_sg_device dev_;
@@ -35,10 +37,10 @@ class SgDriverHandle : public LinuxDriverHandle {
 
  public:
   std::string getDriverName() const override {
-    return "LinuxSgDriver";
+    return SgDriver::kDriverName;
   }
 
-  SgDriverHandle(const scsi_sg_device& dev, const std::string& path, ata::ata_identify_device_data_t *identify_device_data)
+  SgDriverHandle(const scsi_sg_device& dev, const std::string& path, const ata::ata_identify_device_data_t *identify_device_data)
       : dev_(dev), path_(path) {
     const unsigned char *raw_identify_device_data = (const unsigned char *)identify_device_data;
     driving_type_ = kDrivingAtapi;
@@ -61,6 +63,22 @@ class SgDriverHandle : public LinuxDriverHandle {
     }
   }
 
+  void setTraceRing(TraceRing *trace_ring) override {
+    dev_.trace = trace_ring;
+  }
+
+  void setLatencyStats(LatencyStats *latency_stats) override {
+    dev_.latency = latency_stats;
+  }
+
+  void setReadZeroing(bool enabled) override {
+    dev_.no_read_zeroing = !enabled;
+  }
+
+  int getLastResid() const override {
+    return dev_.last_resid;
+  }
+
   int reopenWritable() override {
     int new_fd = ::open(path_.c_str(), O_RDWR | O_NONBLOCK);
     if (new_fd < 0) {
@@ -111,7 +129,76 @@ class SgDriverHandle : public LinuxDriverHandle {
     if (dma < 0) {
       dma = ata::is_dma(tf->command);
     }
-    int rc = sg16(&dev_, rw, dma, tf, data, data_bytes, timeout_secs, sense_data, sizeof(sense_data));
+    int rc = sg16(&dev_, rw, dma, tf, data, data_bytes, timeout_secs, sense_data, sizeof(sense_data), nullptr);
+
+    if (rc > 0) {
+      return { DPARME_ATA_FAILED, rc };
+    }else if (rc < 0 ) {
+      return { DPARME_SYS, errno };
+    }
+    return { DPARME_OK, 0 };
+  }
+
+  DparmResult doTaskfileCmdWithCompletion(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      void *data,
+      unsigned int data_bytes,
+      unsigned int timeout_secs,
+      AtaCompletion *completion
+  ) override {
+    unsigned char sense_data[32] = { 0 };
+    if (dma < 0) {
+      dma = ata::is_dma(tf->command);
+    }
+    int rc = sg16(&dev_, rw, dma, tf, data, data_bytes, timeout_secs, sense_data, sizeof(sense_data), completion);
+
+    if (rc > 0) {
+      return { DPARME_ATA_FAILED, rc };
+    }else if (rc < 0 ) {
+      return { DPARME_SYS, errno, completion->ata_status };
+    }
+    return { DPARME_OK, 0 };
+  }
+
+  bool driverIsVectoredCmdSupported() const override {
+    return true;
+  }
+
+  DparmResult doAtaCmdV(
+      int rw,
+      unsigned char* cdb,
+      unsigned int cdb_bytes,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      int pack_id,
+      unsigned int timeout_secs,
+      unsigned char *sense_buf,
+      unsigned int sense_buf_bytes
+  ) override {
+    int rc = do_sg_ata_v(&dev_, rw, cdb, cdb_bytes, iov, iov_count, pack_id, timeout_secs, sense_buf, sense_buf_bytes);
+    if (rc > 0) {
+      return { DPARME_ATA_FAILED, rc };
+    }else if (rc < 0 ) {
+      return { DPARME_SYS, errno };
+    }
+    return { DPARME_OK, 0 };
+  }
+
+  DparmResult doTaskfileCmdV(
+      int rw,
+      int dma,
+      ata::ata_tf_t *tf,
+      const DparmIoVec *iov,
+      unsigned int iov_count,
+      unsigned int timeout_secs
+  ) override {
+    unsigned char sense_data[32] = { 0 };
+    if (dma < 0) {
+      dma = ata::is_dma(tf->command);
+    }
+    int rc = sg16v(&dev_, rw, dma, tf, iov, iov_count, timeout_secs, sense_data, sizeof(sense_data), nullptr);
 
     if (rc > 0) {
       return { DPARME_ATA_FAILED, rc };
@@ -151,7 +238,7 @@ class SgDriverHandle : public LinuxDriverHandle {
       io_hdr.dxfer_direction = SG_DXFER_FROM_DEV;
       io_hdr.sbp = sense;
       io_hdr.mx_sb_len = sizeof(sense);
-      io_hdr.timeout = 5000;
+      io_hdr.timeout = dev_.retry.getTimeoutSecs(kTimeoutIdentify) * 1000;
 
       result = ioctl(dev_.fd, SG_IO, &io_hdr);
       if (result < 0) {
@@ -177,6 +264,15 @@ class SgDriverHandle : public LinuxDriverHandle {
   }
 };
 
+std::string SgDriver::getDriverName() const {
+  return kDriverName;
+}
+
+DparmReturn<std::unique_ptr<LinuxDriverHandle>> SgDriver::open(const char *path, const IdentityCacheEntry& cached) {
+  // IDENTIFY DEVICE is always issued: the security state must not come from a previous boot
+  return open(path);
+}
+
 DparmReturn<std::unique_ptr<LinuxDriverHandle>> SgDriver::open(const char *path) {
   std::string strpath(path);
   DparmResult result;
@@ -192,12 +288,13 @@ DparmReturn<std::unique_ptr<LinuxDriverHandle>> SgDriver::open(const char *path)
 
     dev.debug_puts = options_.debug_puts;
     dev.verbose = options_.verbose;
+    dev.retry = options_.retry_policy;
     apt_detect(&dev);
 
     ata::ata_tf_t tf = {0};
     ata::ata_identify_device_data_t temp = {0};
     tf.command = 0xec;
-    if (sg16(&dev, 0, 0, &tf, &temp, sizeof(temp), 3, sense_data, sizeof(sense_data)) == -1) {
+    if (sg16(&dev, 0, 0, &tf, &temp, sizeof(temp), dev.retry.getTimeoutSecs(kTimeoutIdentify), sense_data, sizeof(sense_data), nullptr) == -1) {
       result = { DPARME_SYS, dev.last_errno };
       break;
     }
@@ -20,8 +20,12 @@ namespace drivers {
 class SgDriver : public DriverBase {
 
  public:
+  static const char* const kDriverName;
+
   SgDriver(const DriveFactoryOptions& options) : DriverBase(options) {}
+  std::string getDriverName() const override;
   DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char *path) override;
+  DparmReturn<std::unique_ptr<LinuxDriverHandle>> open(const char *path, const IdentityCacheEntry& cached) override;
 };
 
 } // naemspace drivers
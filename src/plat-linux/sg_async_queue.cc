@@ -0,0 +1,244 @@
+/**
+ * @file	sg_async_queue.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <chrono>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <linux/major.h>
+
+#include <jcu-dparm/ata_utils.h>
+
+#include "sg_async_queue.h"
+
+namespace jcu {
+namespace dparm {
+namespace plat_linux {
+
+int sg_find_node(const char *drive_path, std::string *sg_path) {
+  struct stat st;
+  if (stat(drive_path, &st) != 0) {
+    return errno;
+  }
+
+  if (S_ISCHR(st.st_mode) && major(st.st_rdev) == SCSI_GENERIC_MAJOR) {
+    *sg_path = drive_path;
+    return 0;
+  }
+  if (!S_ISBLK(st.st_mode)) {
+    return ENOTSUP;
+  }
+
+  char dir_path[64];
+  snprintf(dir_path, sizeof(dir_path), "/sys/dev/block/%u:%u/device/scsi_generic", major(st.st_rdev), minor(st.st_rdev));
+  DIR *dir = opendir(dir_path);
+  if (!dir) {
+    // not a SCSI disk (nvme, virtio, ...)
+    return (errno == ENOENT) ? ENOTSUP : errno;
+  }
+  int err = ENOTSUP;
+  struct dirent *ent;
+  while ((ent = readdir(dir)) != nullptr) {
+    if (ent->d_name[0] == '.') {
+      continue;
+    }
+    *sg_path = std::string("/dev/") + ent->d_name;
+    err = 0;
+    break;
+  }
+  closedir(dir);
+  return err;
+}
+
+SgAsyncQueue::SgAsyncQueue(const DriveFactoryOptions &options)
+    : options_(options), next_pack_id_(1)
+{
+}
+
+SgAsyncQueue::~SgAsyncQueue() {
+  // sg uses indirect I/O: the kernel drops unread results on close without touching user buffers.
+  for (auto it = drives_.begin(); it != drives_.end(); it++) {
+    ::close(it->dev.fd);
+  }
+}
+
+DparmReturn<int> SgAsyncQueue::addDrive(const char *drive_path) {
+  std::string sg_path;
+  int err = sg_find_node(drive_path, &sg_path);
+  if (err) {
+    return { (err == ENOTSUP) ? DPARME_NOT_SUPPORTED : DPARME_SYS, err };
+  }
+
+  if (sg_path != drive_path) {
+    // APT bridges need their own vendor commands, which are issued by SG_IO only.
+    scsi_sg_device dev = {};
+    dev.fd = ::open(drive_path, O_RDONLY | O_NONBLOCK);
+    if (dev.fd == -1) {
+      return { DPARME_SYS, errno };
+    }
+    dev.verbose = options_.verbose;
+    dev.debug_puts = options_.debug_puts;
+    dev.retry = options_.retry_policy;
+    apt_detect(&dev);
+    ::close(dev.fd);
+    if (apt_is_apt(&dev)) {
+      return { DPARME_NOT_SUPPORTED, ENOTSUP };
+    }
+  }
+
+  // write() of sg_io_hdr requires O_RDWR
+  int fd = ::open(sg_path.c_str(), O_RDWR | O_NONBLOCK);
+  if (fd == -1) {
+    return { DPARME_SYS, errno };
+  }
+  return { DPARME_OK, 0, 0, adoptDrive(sg_path, fd) };
+}
+
+int SgAsyncQueue::adoptDrive(const std::string &sg_path, int fd) {
+  Drive drive;
+  drive.sg_path = sg_path;
+  drive.inflight = 0;
+  drive.dev.fd = fd;
+  drive.dev.apt_data = {};
+  drive.dev.verbose = options_.verbose;
+  drive.dev.last_errno = 0;
+  drive.dev.debug_puts = options_.debug_puts;
+  drive.dev.trace = nullptr;
+  drive.dev.latency = nullptr;
+  drive.dev.retry = options_.retry_policy;
+  drive.dev.no_read_zeroing = 0;
+  drive.dev.last_resid = 0;
+
+  drives_.push_back(std::move(drive));
+  return (int) (drives_.size() - 1);
+}
+
+DparmResult SgAsyncQueue::submit(const AsyncAtaCommand &command) {
+  if (command.drive < 0 || command.drive >= (int) drives_.size()) {
+    return { DPARME_SYS, EINVAL };
+  }
+  Drive& drive = drives_[command.drive];
+
+  while (pending_.find(next_pack_id_) != pending_.end()) {
+    next_pack_id_ = (next_pack_id_ == 0x7fffffff) ? 1 : (next_pack_id_ + 1);
+  }
+  int pack_id = next_pack_id_;
+  next_pack_id_ = (next_pack_id_ == 0x7fffffff) ? 1 : (next_pack_id_ + 1);
+
+  Pending& pending = pending_[pack_id];
+  pending.drive = command.drive;
+  pending.user_data = command.user_data;
+  pending.tf = command.tf;
+
+  int dma = (command.dma < 0) ? ata::is_dma(command.tf.command) : command.dma;
+  drive.dev.no_read_zeroing = command.no_read_zeroing;
+  if (sg16_submit(
+      &drive.dev, command.rw, dma, &pending.tf,
+      command.data, command.data_bytes, command.timeout_secs,
+      pending.sense_data, sizeof(pending.sense_data),
+      pack_id, nullptr) == -1) {
+    int err = drive.dev.last_errno;
+    pending_.erase(pack_id);
+    // EDOM: the queue of the sg fd is full
+    return { DPARME_SYS, (err == EDOM) ? EAGAIN : err };
+  }
+
+  drive.inflight++;
+  return { DPARME_OK, 0 };
+}
+
+int SgAsyncQueue::reapDrive(int drive_index, std::vector<AsyncAtaCompletion> &completions, size_t *count) {
+  Drive& drive = drives_[drive_index];
+  struct scsi_sg_io_hdr io_hdr;
+
+  while (drive.inflight) {
+    if (sg16_reap(&drive.dev, &io_hdr) == -1) {
+      int err = drive.dev.last_errno;
+      return (err == EAGAIN) ? 0 : err;
+    }
+
+    auto it = pending_.find(io_hdr.pack_id);
+    if (it == pending_.end() || it->second.drive != drive_index) {
+      continue;
+    }
+    drive.inflight--;
+
+    AsyncAtaCompletion completion;
+    completion.drive = drive_index;
+    completion.user_data = it->second.user_data;
+    completion.tf = it->second.tf;
+    int rc = sg16_complete(&drive.dev, &io_hdr, &completion.tf, &completion.detail);
+    if (rc > 0) {
+      completion.result = { DPARME_ATA_FAILED, rc };
+    } else if (rc < 0) {
+      completion.result = { DPARME_SYS, errno };
+    }
+    pending_.erase(it);
+
+    completions.push_back(completion);
+    (*count)++;
+  }
+  return 0;
+}
+
+int SgAsyncQueue::reap(std::vector<AsyncAtaCompletion> &completions, size_t min_completions, int timeout_ms) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  std::vector<struct pollfd> pfds;
+  size_t count = 0;
+
+  if (min_completions > pending_.size()) {
+    min_completions = pending_.size();
+  }
+
+  for (;;) {
+    pfds.clear();
+    for (size_t i = 0; i < drives_.size(); i++) {
+      int err = reapDrive((int) i, completions, &count);
+      if (err) {
+        return err;
+      }
+      if (drives_[i].inflight) {
+        struct pollfd pfd = {drives_[i].dev.fd, POLLIN, 0};
+        pfds.push_back(pfd);
+      }
+    }
+
+    if (count >= min_completions) {
+      return 0;
+    }
+
+    int wait_ms = -1;
+    if (timeout_ms >= 0) {
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (remaining.count() <= 0) {
+        return ETIMEDOUT;
+      }
+      wait_ms = (int) remaining.count();
+    }
+
+    int rc = poll(pfds.data(), pfds.size(), wait_ms);
+    if (rc < 0 && errno != EINTR) {
+      return errno;
+    }
+  }
+}
+
+size_t SgAsyncQueue::getInflightCount() const {
+  return pending_.size();
+}
+
+} // namespace plat_linux
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,91 @@
+/**
+ * @file	sg_async_queue.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_PLAT_LINUX_SG_ASYNC_QUEUE_H_
+#define JCU_DPARM_SRC_PLAT_LINUX_SG_ASYNC_QUEUE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <jcu-dparm/types.h>
+#include <jcu-dparm/async_command_queue.h>
+
+#include "sgio.h"
+
+namespace jcu {
+namespace dparm {
+namespace plat_linux {
+
+/**
+ * AsyncCommandQueue on the sg v3 interface:
+ * write() of sg_io_hdr queues a command and read() returns a finished one,
+ * matched by pack_id. poll() waits on all drives at once.
+ *
+ * The kernel queues up to 16 commands per sg fd.
+ */
+class SgAsyncQueue : public AsyncCommandQueue {
+ private:
+  struct Drive {
+    std::string sg_path;
+    scsi_sg_device dev;
+    size_t inflight;
+  };
+
+  struct Pending {
+    int drive;
+    uint64_t user_data;
+    ata::ata_tf_t tf;
+    unsigned char sense_data[32];
+  };
+
+  DriveFactoryOptions options_;
+  std::vector<Drive> drives_;
+  // key: pack_id
+  std::map<int, Pending> pending_;
+  int next_pack_id_;
+
+  /**
+   * read all finished commands of the drive
+   *
+   * @return zero or errno
+   */
+  int reapDrive(int drive, std::vector<AsyncAtaCompletion>& completions, size_t *count);
+
+ public:
+  SgAsyncQueue(const DriveFactoryOptions& options);
+  ~SgAsyncQueue() override;
+
+  DparmReturn<int> addDrive(const char *drive_path) override;
+
+  /**
+   * add an opened sg fd (O_RDWR | O_NONBLOCK). The queue closes it.
+   *
+   * @return drive index
+   */
+  int adoptDrive(const std::string& sg_path, int fd);
+  DparmResult submit(const AsyncAtaCommand& command) override;
+  int reap(std::vector<AsyncAtaCompletion>& completions, size_t min_completions, int timeout_ms) override;
+  size_t getInflightCount() const override;
+};
+
+/**
+ * find the sg node of a SCSI disk
+ *
+ * @param drive_path (in)  /dev/sdX or /dev/sgN
+ * @param sg_path    (out) /dev/sgN
+ * @return zero if successful, otherwise errno.
+ */
+int sg_find_node(const char *drive_path, std::string *sg_path);
+
+} // namespace plat_linux
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_PLAT_LINUX_SG_ASYNC_QUEUE_H_
@@ -19,6 +19,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdarg.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -50,7 +51,12 @@ using namespace jcu::dparm;
 
 static const int prefer_ata12 = 0;
 
-static const unsigned int default_timeout_secs = 15;
+
+// DparmIoVec is passed to SG_IO as sg_iovec_t
+static_assert(sizeof(DparmIoVec) == sizeof(sg_iovec_t) &&
+              offsetof(DparmIoVec, base) == offsetof(sg_iovec_t, iov_base) &&
+              offsetof(DparmIoVec, length) == offsetof(sg_iovec_t, iov_len),
+              "DparmIoVec layout");
 
 /*
  * Taskfile layout for SG_ATA_16 cdb:
@@ -198,75 +204,243 @@ enum {
   SG_CDB2_CHECK_COND = 1 << 5,
 };
 
-static void dump_bytes(scsi_sg_device *dev, const char *prefix, const void *in, int len) {
-  int i;
+void sgio_dump_bytes(scsi_sg_device *dev, const char *prefix, const void *in, int len) {
+  static const char hex[] = "0123456789abcdef";
   const unsigned char *p = (const unsigned char *)in;
-
-  if (prefix)
-    sgio_dbgprintf(dev, "%s: ", prefix);
-  for (i = 0; i < len; ++i)
-    sgio_dbgprintf(dev, " %02x", p[i]);
-  sgio_dbgprintf(dev, "\n");
+  std::string line;
+
+  if (!dev->debug_puts)
+    return;
+  line.reserve((prefix ? strlen(prefix) + 2 : 0) + len * 3 + 1);
+  if (prefix) {
+    line.append(prefix);
+    line.append(": ");
+  }
+  for (int i = 0; i < len; ++i) {
+    line.push_back(' ');
+    line.push_back(hex[p[i] >> 4]);
+    line.push_back(hex[p[i] & 0x0f]);
+  }
+  line.push_back('\n');
+  dev->debug_puts(line);
 }
 
 int sgio_dbgprintf(scsi_sg_device *dev, const char* fmt, ...) {
-  std::vector<char> buffer(strlen(fmt) + 256);
+  if (!dev->debug_puts) {
+    return 0;
+  }
+  char buffer[256];
   va_list args;
   va_start(args, fmt);
-  int length = vsnprintf(buffer.data(), buffer.size(), fmt, args);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
   va_end(args);
-  if (dev->debug_puts) {
-    return dev->debug_puts(std::string(buffer.data(), length));
+  if (length < 0) {
+    return 0;
   }
-  return 0;
+  if ((size_t) length < sizeof(buffer)) {
+    return dev->debug_puts(std::string(buffer, length));
+  }
+  std::vector<char> large(length + 1);
+  va_start(args, fmt);
+  vsnprintf(large.data(), large.size(), fmt, args);
+  va_end(args);
+  return dev->debug_puts(std::string(large.data(), length));
 }
 
-int do_sg_ata(
-    scsi_sg_device *dev,
-    int rw,
-    unsigned char* cdb, unsigned int cdb_bytes,
-    void *data, unsigned int data_bytes,
-    int pack_id,
-    unsigned int timeout_secs,
-    unsigned char *sense_data, unsigned int sense_buf_size
-) {
-  unsigned char sb[32], *desc;
-  unsigned char *sb_ptr = sense_data ? sense_data : sb;
-  int sb_size = sense_data ? sense_buf_size : sizeof(sb);
-  int return_code = 0;
-  struct scsi_sg_io_hdr io_hdr;
+/**
+ * record the cdb and the result of a finished SG_IO in dev->trace
+ */
+static void sg_trace(scsi_sg_device *dev, const struct scsi_sg_io_hdr *io_hdr, uint64_t issued_ns, int ioctl_rc) {
+  unsigned char result[36];
+  unsigned int sb_len = io_hdr->sb_len_wr;
+
+  if (sb_len > sizeof(result) - 4)
+    sb_len = sizeof(result) - 4;
+  if (sb_len > io_hdr->mx_sb_len)
+    sb_len = io_hdr->mx_sb_len;
+
+  result[0] = io_hdr->status;
+  result[1] = (unsigned char) io_hdr->host_status;
+  result[2] = (unsigned char) io_hdr->driver_status;
+  result[3] = (unsigned char) sb_len;
+  if (sb_len)
+    memcpy(result + 4, io_hdr->sbp, sb_len);
+
+  dev->trace->record(kTraceSgCdb, issued_ns, 0, io_hdr->pack_id, io_hdr->cmdp, io_hdr->cmd_len);
+  dev->trace->record(kTraceSgResult, issued_ns, (uint32_t) ((TraceRing::now() - issued_ns) / 1000), ioctl_rc, result, 4 + sb_len);
+}
 
-  unsigned char res_status = 0;
-  unsigned char res_error = 0;
+/**
+ * count a finished SG_IO in dev->latency, keyed by the ATA command of ATA PASS-THROUGH cdbs
+ *
+ * @param failed (in) the command failed (ioctl, transport or ATA error)
+ */
+static void sg_latency(scsi_sg_device *dev, const struct scsi_sg_io_hdr *io_hdr, uint64_t duration_us, bool failed) {
+  const unsigned char *cdb = io_hdr->cmdp;
 
-  memset(sb_ptr, 0, sb_size);
-  memset(&io_hdr, 0, sizeof(struct scsi_sg_io_hdr));
-  if (data && data_bytes && !rw)
-    memset(data, 0, data_bytes);
+  if (cdb[0] == SG_ATA_16 && io_hdr->cmd_len >= SG_ATA_16_LEN)
+    dev->latency->record(kLatencyAta, cdb[14], duration_us, failed);
+  else if (cdb[0] == SG_ATA_12 && io_hdr->cmd_len >= SG_ATA_12_LEN)
+    dev->latency->record(kLatencyAta, cdb[9], duration_us, failed);
+  else
+    dev->latency->record(kLatencyScsi, cdb[0], duration_us, failed);
+}
 
-  io_hdr.interface_id = 'S';
-  io_hdr.mx_sb_len = sb_size;
-  io_hdr.dxfer_direction = data ? (rw ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV) : SG_DXFER_NONE;
-  io_hdr.dxfer_len = data ? data_bytes : 0;
-  io_hdr.dxferp = data;
-  io_hdr.cmdp = cdb;
-  io_hdr.cmd_len = cdb_bytes;
-  io_hdr.sbp = sb_ptr;
-  io_hdr.pack_id = pack_id;
-  io_hdr.timeout = (timeout_secs ? timeout_secs : default_timeout_secs) * 1000; /* msecs */
+/**
+ * @return true if the finished SG_IO may succeed when issued again (see AtaCompletion::isTransient)
+ */
+static bool sg_is_transient(const struct scsi_sg_io_hdr *io_hdr) {
+  AtaCompletion completion;
+  const unsigned char *cdb = io_hdr->cmdp;
+  unsigned int sb_len = io_hdr->sb_len_wr;
+
+  if (sb_len > io_hdr->mx_sb_len)
+    sb_len = io_hdr->mx_sb_len;
+  completion.scsi_status = io_hdr->status;
+  completion.host_status = io_hdr->host_status;
+  if (sb_len)
+    decodeSenseData((const unsigned char *) io_hdr->sbp, sb_len, cdb[0] == SG_ATA_16 || cdb[0] == SG_ATA_12, &completion);
+  return completion.isTransient();
+}
 
-  if (dev->verbose >= jcu::dparm::kVerboseDebug) {
-    dump_bytes(dev, "outgoing cdb", cdb, cdb_bytes);
-    if (rw && data)
-      dump_bytes(dev, "outgoing_data", data, data_bytes);
+/**
+ * a retry does not start with less time left before the deadline
+ */
+static const unsigned int kSgMinAttemptMs = 1000;
+
+/**
+ * SG_IO with the retries and the deadline of dev->retry. Each attempt is traced and counted.
+ * The caller counts the last attempt in dev->latency if the ioctl succeeded.
+ *
+ * @param issued_ns   (out) start of the last attempt (0 if not measured)
+ * @param duration_us (out) duration of the last attempt (0 if not measured)
+ * @return result of the last ioctl, errno is kept
+ */
+static int sg_ioctl(scsi_sg_device *dev, struct scsi_sg_io_hdr *io_hdr, uint64_t *issued_ns, uint64_t *duration_us) {
+  const CommandRetryPolicy& policy = dev->retry;
+  bool timed = dev->trace || dev->latency || policy.deadline_ms;
+  uint64_t started_ns = timed ? TraceRing::now() : 0;
+  unsigned int timeout_ms = io_hdr->timeout;
+  unsigned int backoff_ms = policy.backoff_ms;
+  int ioctl_rc;
+
+  for (unsigned int attempt = 0; ; attempt++) {
+    uint64_t elapsed_ms = 0;
+    if (policy.deadline_ms) {
+      elapsed_ms = (TraceRing::now() - started_ns) / 1000000;
+      uint64_t left_ms = (elapsed_ms < policy.deadline_ms) ? (policy.deadline_ms - elapsed_ms) : 1;
+      io_hdr->timeout = (left_ms < timeout_ms) ? (unsigned int) left_ms : timeout_ms;
+    }
+
+    *issued_ns = timed ? TraceRing::now() : 0;
+    ioctl_rc = dev->sg_io ? dev->sg_io(dev->fd, io_hdr) : ioctl(dev->fd, SG_IO, io_hdr);
+    int err = errno;
+    *duration_us = timed ? (TraceRing::now() - *issued_ns) / 1000 : 0;
+    if (dev->trace)
+      sg_trace(dev, io_hdr, *issued_ns, (ioctl_rc == -1) ? -err : 0);
+
+    bool retry = (ioctl_rc != -1) && (attempt < policy.max_retries) && sg_is_transient(io_hdr);
+    if (retry && policy.deadline_ms) {
+      elapsed_ms = (TraceRing::now() - started_ns) / 1000000;
+      retry = (elapsed_ms + backoff_ms + kSgMinAttemptMs) <= policy.deadline_ms;
+    }
+    if (dev->latency && (ioctl_rc == -1 || retry))
+      sg_latency(dev, io_hdr, *duration_us, true);
+    if (!retry) {
+      errno = err;
+      return ioctl_rc;
+    }
+
+    if (dev->verbose >= jcu::dparm::kVerboseInfo)
+      sgio_dbgprintf(dev, "SG_IO: transient status=0x%x host_status=0x%x, retry %u after %ums\n",
+                     io_hdr->status, io_hdr->host_status, attempt + 1, backoff_ms);
+    if (backoff_ms)
+      usleep(backoff_ms * 1000);
+    backoff_ms *= 2;
+    memset(io_hdr->sbp, 0, io_hdr->mx_sb_len);
+    io_hdr->sb_len_wr = 0;
   }
+}
 
-  if (ioctl(dev->fd, SG_IO, &io_hdr) == -1) {
-    dev->last_errno = errno;
-    if (dev->verbose >= jcu::dparm::kVerboseError)
-      perror("ioctl(fd,SG_IO)");
-    return -1;    /* SG_IO not supported */
+/**
+ * set the data buffer of io_hdr and clear it for reads (unless dev->no_read_zeroing)
+ *
+ * @param data        (in) buffer, or DparmIoVec array if iovec_count > 0
+ * @param data_bytes  (in) buffer size (total of the segments)
+ * @param iovec_count (in) number of DparmIoVec
+ */
+static void sg_set_data(scsi_sg_device *dev, struct scsi_sg_io_hdr *io_hdr, int rw, void *data, unsigned int data_bytes, unsigned short iovec_count) {
+  if (data && data_bytes && !rw && !dev->no_read_zeroing) {
+    if (iovec_count) {
+      const DparmIoVec *iov = (const DparmIoVec *) data;
+      for (unsigned short i = 0; i < iovec_count; i++)
+        memset(iov[i].base, 0, iov[i].length);
+    } else {
+      memset(data, 0, data_bytes);
+    }
+  }
+  io_hdr->dxfer_direction = data ? (rw ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV) : SG_DXFER_NONE;
+  io_hdr->dxfer_len = data ? data_bytes : 0;
+  io_hdr->dxferp = data;
+  io_hdr->iovec_count = data ? iovec_count : 0;
+}
+
+static void dump_data(scsi_sg_device *dev, const char *prefix, const struct scsi_sg_io_hdr *io_hdr) {
+  if (io_hdr->iovec_count) {
+    const DparmIoVec *iov = (const DparmIoVec *) io_hdr->dxferp;
+    for (unsigned short i = 0; i < io_hdr->iovec_count; i++)
+      sgio_dump_bytes(dev, prefix, iov[i].base, iov[i].length);
+  } else {
+    sgio_dump_bytes(dev, prefix, io_hdr->dxferp, io_hdr->dxfer_len);
   }
+}
+
+unsigned int sg_iovec_bytes(const DparmIoVec *iov, unsigned int iov_count) {
+  unsigned long long total = 0;
+  if (!iov || !iov_count || iov_count > 0xffff) {
+    errno = EINVAL;
+    return 0;
+  }
+  for (unsigned int i = 0; i < iov_count; i++)
+    total += iov[i].length;
+  if (!total || total > 0xffffffffULL) {
+    errno = EINVAL;
+    return 0;
+  }
+  return (unsigned int) total;
+}
+
+void sg_iovec_gather(const DparmIoVec *iov, unsigned int iov_count, unsigned char *buffer) {
+  for (unsigned int i = 0; i < iov_count; i++) {
+    memcpy(buffer, iov[i].base, iov[i].length);
+    buffer += iov[i].length;
+  }
+}
+
+void sg_iovec_scatter(const unsigned char *buffer, const DparmIoVec *iov, unsigned int iov_count) {
+  for (unsigned int i = 0; i < iov_count; i++) {
+    memcpy(iov[i].base, buffer, iov[i].length);
+    buffer += iov[i].length;
+  }
+}
+
+/**
+ * check the status and the ATA return descriptor of a finished do_sg_ata_io
+ *
+ * @return zero if successful, 1 if the sense data is missing, -1 with errno on error
+ */
+static int sg_ata_result(
+    scsi_sg_device *dev,
+    const struct scsi_sg_io_hdr *io_hdr_ptr,
+    int rw, void *data,
+    unsigned char *sb_ptr, int sb_size
+) {
+  const struct scsi_sg_io_hdr& io_hdr = *io_hdr_ptr;
+  unsigned char *desc;
+  int return_code = 0;
+
+  unsigned char res_status = 0;
+  unsigned char res_error = 0;
 
   if (dev->verbose >= jcu::dparm::kVerboseDebug)
     sgio_dbgprintf(dev, "SG_IO: ATA_%u status=0x%x, host_status=0x%x, driver_status=0x%x\n",
@@ -285,9 +459,9 @@ int do_sg_ata(
     return -1;
   }
   if (dev->verbose >= jcu::dparm::kVerboseDebug) {
-    dump_bytes(dev, "SG_IO: sb[]", sb_ptr, sb_size);
+    sgio_dump_bytes(dev, "SG_IO: sb[]", sb_ptr, sb_size);
     if (!rw && data)
-      dump_bytes(dev, "incoming_data", data, data_bytes);
+      dump_data(dev, "incoming_data", &io_hdr);
   }
 
   if (io_hdr.driver_status && (io_hdr.driver_status != SG_DRIVER_SENSE)) {
@@ -309,7 +483,7 @@ int do_sg_ata(
     }
   } else if (sb_ptr[0] != 0x72 || sb_ptr[7] < 14 || desc[0] != 0x09 || desc[1] < 0x0c) {
     if (dev->verbose >= jcu::dparm::kVerboseError) {
-      dump_bytes(dev, "SG_IO: bad/missing sense data, sb_ptr[]", sb_ptr, sb_size);
+      sgio_dump_bytes(dev, "SG_IO: bad/missing sense data, sb_ptr[]", sb_ptr, sb_size);
     }
     return_code = 1;
   }
@@ -318,7 +492,7 @@ int do_sg_ata(
     unsigned int len = desc[1] + 2, maxlen = sb_size - 8 - 2;
     if (len > maxlen)
       len = maxlen;
-    dump_bytes(dev, "SG_IO: desc[]", desc, len);
+    sgio_dump_bytes(dev, "SG_IO: desc[]", desc, len);
   }
 
   res_status = desc[13];
@@ -339,47 +513,95 @@ int do_sg_ata(
   return return_code;
 }
 
-/**
- * SCSI ATA PASSTHROUGH
- *
- * @param dev            (in) device context
- * @param rw             (in) SG_READ(0) / SG_WRITE(1)
- * @param dma            (in) SG_PIO(0) / SG_DMA(1)
- * @param tf             (in/out) Task File structure
- * @param data           (in/out) Data Buffer
- * @param data_bytes     (in)     Data Size
- * @param timeout_secs   (in)     timeout seconds
- * @param sense_data     (out)    Sense Buffer
- * @param sense_buf_size (in)     Sense Buffer Size
- * @return               zero if successful
- * @see https://www.t10.org/ftp/t10/document.04/04-262r8.pdf
- *      TABLE 5 - ATA PASS-THROUGH (16) command CDB format
- */
-int sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
-         void *data, unsigned int data_bytes, unsigned int timeout_secs,
-         unsigned char *sense_data, int sense_buf_size
-    ) {
-  unsigned char cdb[SG_ATA_16_LEN];
-  unsigned char sb[32], *desc;
+static int do_sg_ata_io(
+    scsi_sg_device *dev,
+    int rw,
+    unsigned char* cdb, unsigned int cdb_bytes,
+    void *data, unsigned int data_bytes, unsigned short iovec_count,
+    int pack_id,
+    unsigned int timeout_secs,
+    unsigned char *sense_data, unsigned int sense_buf_size
+) {
+  unsigned char sb[32];
   unsigned char *sb_ptr = sense_data ? sense_data : sb;
   int sb_size = sense_data ? sense_buf_size : sizeof(sb);
-  int return_code = 0;
-
   struct scsi_sg_io_hdr io_hdr;
-  int prefer12 = prefer_ata12, demanded_sense = 0;
 
-  if (tf->command == ata::ATA_OP_PIDENTIFY)
-    prefer12 = 0;
+  memset(sb_ptr, 0, sb_size);
+  memset(&io_hdr, 0, sizeof(struct scsi_sg_io_hdr));
+  sg_set_data(dev, &io_hdr, rw, data, data_bytes, iovec_count);
 
-  if (apt_is_apt(dev)) {
-    return apt_sg16(dev, rw, dma, tf, data, data_bytes, timeout_secs);
+  io_hdr.interface_id = 'S';
+  io_hdr.mx_sb_len = sb_size;
+  io_hdr.cmdp = cdb;
+  io_hdr.cmd_len = cdb_bytes;
+  io_hdr.sbp = sb_ptr;
+  io_hdr.pack_id = pack_id;
+  io_hdr.timeout = (timeout_secs ? timeout_secs : dev->retry.getTimeoutSecs(kTimeoutDefault)) * 1000; /* msecs */
+
+  if (dev->verbose >= jcu::dparm::kVerboseDebug) {
+    sgio_dump_bytes(dev, "outgoing cdb", cdb, cdb_bytes);
+    if (rw && data)
+      dump_data(dev, "outgoing_data", &io_hdr);
   }
 
-  memset(&cdb, 0, sizeof(cdb));
-  memset(sb_ptr, 0, sb_size);
-  memset(&io_hdr, 0, sizeof(struct scsi_sg_io_hdr));
-  if (data && data_bytes && !rw)
-    memset(data, 0, data_bytes);
+  uint64_t issued_ns, duration_us;
+  if (sg_ioctl(dev, &io_hdr, &issued_ns, &duration_us) == -1) {
+    dev->last_resid = io_hdr.dxfer_len;
+    dev->last_errno = errno;
+    if (dev->verbose >= jcu::dparm::kVerboseError)
+      perror("ioctl(fd,SG_IO)");
+    return -1;    /* SG_IO not supported */
+  }
+  dev->last_resid = io_hdr.resid;
+
+  int rc = sg_ata_result(dev, &io_hdr, rw, data, sb_ptr, sb_size);
+  if (dev->latency)
+    sg_latency(dev, &io_hdr, duration_us, rc < 0);
+  return rc;
+}
+
+int do_sg_ata(
+    scsi_sg_device *dev,
+    int rw,
+    unsigned char* cdb, unsigned int cdb_bytes,
+    void *data, unsigned int data_bytes,
+    int pack_id,
+    unsigned int timeout_secs,
+    unsigned char *sense_data, unsigned int sense_buf_size
+) {
+  return do_sg_ata_io(dev, rw, cdb, cdb_bytes, data, data_bytes, 0, pack_id, timeout_secs, sense_data, sense_buf_size);
+}
+
+int do_sg_ata_v(
+    scsi_sg_device *dev,
+    int rw,
+    unsigned char* cdb, unsigned int cdb_bytes,
+    const DparmIoVec *iov, unsigned int iov_count,
+    int pack_id,
+    unsigned int timeout_secs,
+    unsigned char *sense_data, unsigned int sense_buf_size
+) {
+  unsigned int data_bytes = sg_iovec_bytes(iov, iov_count);
+  if (!data_bytes) {
+    dev->last_errno = errno;
+    return -1;
+  }
+  return do_sg_ata_io(dev, rw, cdb, cdb_bytes, (void *) iov, data_bytes, iov_count, pack_id, timeout_secs, sense_data, sense_buf_size);
+}
+
+/**
+ * build the ATA PASS-THROUGH cdb of sg16
+ *
+ * @return cdb length
+ */
+static unsigned int sg16_build_cdb(int rw, int dma, const ata::ata_tf_t *tf, const void *data, unsigned char *cdb) {
+  int prefer12 = prefer_ata12;
+
+  if (tf->command == ata::ATA_OP_PIDENTIFY)
+    prefer12 = 0;
+
+  memset(cdb, 0, SG_ATA_16_LEN);
 
   if (dma) {
     //cdb[1] = data ? (rw ? SG_ATA_PROTO_UDMA_OUT : SG_ATA_PROTO_UDMA_IN) : SG_ATA_PROTO_NON_DATA;
@@ -413,73 +635,230 @@ int sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
       cdb[9] = tf->hob.lbam;
       cdb[11] = tf->hob.lbah;
     }
-    io_hdr.cmd_len = SG_ATA_16_LEN;
-  } else {
-    cdb[0] = SG_ATA_12;
-    cdb[3] = tf->lob.feat;
-    cdb[4] = tf->lob.nsect;
-    cdb[5] = tf->lob.lbal;
-    cdb[6] = tf->lob.lbam;
-    cdb[7] = tf->lob.lbah;
-    cdb[8] = tf->dev;
-    cdb[9] = tf->command;
-    io_hdr.cmd_len = SG_ATA_12_LEN;
+    return SG_ATA_16_LEN;
   }
 
-  io_hdr.interface_id = 'S';
-  io_hdr.mx_sb_len = sb_size;
-  io_hdr.dxfer_direction = data ? (rw ? SG_DXFER_TO_DEV : SG_DXFER_FROM_DEV) : SG_DXFER_NONE;
-  io_hdr.dxfer_len = data ? data_bytes : 0;
-  io_hdr.dxferp = data;
-  io_hdr.cmdp = cdb;
-  io_hdr.sbp = sb_ptr;
-  io_hdr.pack_id = tf_to_lba(tf);
-  io_hdr.timeout = (timeout_secs ? timeout_secs : default_timeout_secs) * 1000; /* msecs */
+  cdb[0] = SG_ATA_12;
+  cdb[3] = tf->lob.feat;
+  cdb[4] = tf->lob.nsect;
+  cdb[5] = tf->lob.lbal;
+  cdb[6] = tf->lob.lbam;
+  cdb[7] = tf->lob.lbah;
+  cdb[8] = tf->dev;
+  cdb[9] = tf->command;
+  return SG_ATA_12_LEN;
+}
+
+/**
+ * fill io_hdr of sg16 and clear the buffers
+ */
+static void sg16_prepare(scsi_sg_device *dev, struct scsi_sg_io_hdr *io_hdr,
+                         int rw, int dma, ata::ata_tf_t *tf, unsigned char *cdb,
+                         void *data, unsigned int data_bytes, unsigned short iovec_count,
+                         unsigned int timeout_secs, unsigned char *sb_ptr, int sb_size
+) {
+  memset(sb_ptr, 0, sb_size);
+  memset(io_hdr, 0, sizeof(struct scsi_sg_io_hdr));
+  sg_set_data(dev, io_hdr, rw, data, data_bytes, iovec_count);
+
+  io_hdr->cmd_len = sg16_build_cdb(rw, dma, tf, data, cdb);
+  io_hdr->interface_id = 'S';
+  io_hdr->mx_sb_len = sb_size;
+  io_hdr->cmdp = cdb;
+  io_hdr->sbp = sb_ptr;
+  io_hdr->pack_id = tf_to_lba(tf);
+  io_hdr->timeout = (timeout_secs ? timeout_secs : dev->retry.getTimeoutSecs(kTimeoutDefault)) * 1000; /* msecs */
 
   if (dev->verbose >= jcu::dparm::kVerboseDebug) {
-    dump_bytes(dev, "outgoing cdb", cdb, sizeof(cdb));
+    sgio_dump_bytes(dev, "outgoing cdb", cdb, io_hdr->cmd_len);
     if (rw && data)
-      dump_bytes(dev, "outgoing_data", data, data_bytes);
+      dump_data(dev, "outgoing_data", io_hdr);
   }
+}
+
+/**
+ * SCSI ATA PASSTHROUGH
+ *
+ * @param dev            (in) device context
+ * @param rw             (in) SG_READ(0) / SG_WRITE(1)
+ * @param dma            (in) SG_PIO(0) / SG_DMA(1)
+ * @param tf             (in/out) Task File structure
+ * @param data           (in/out) Data Buffer
+ * @param data_bytes     (in)     Data Size
+ * @param timeout_secs   (in)     timeout seconds
+ * @param sense_data     (out)    Sense Buffer
+ * @param sense_buf_size (in)     Sense Buffer Size
+ * @return               zero if successful
+ * @see https://www.t10.org/ftp/t10/document.04/04-262r8.pdf
+ *      TABLE 5 - ATA PASS-THROUGH (16) command CDB format
+ */
+static int sg16_io(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
+                   void *data, unsigned int data_bytes, unsigned short iovec_count, unsigned int timeout_secs,
+                   unsigned char *sense_data, int sense_buf_size, AtaCompletion *completion
+    ) {
+  unsigned char cdb[SG_ATA_16_LEN];
+  unsigned char sb[32];
+  unsigned char *sb_ptr = sense_data ? sense_data : sb;
+  int sb_size = sense_data ? sense_buf_size : sizeof(sb);
 
-  if (ioctl(dev->fd, SG_IO, &io_hdr) == -1) {
+  struct scsi_sg_io_hdr io_hdr;
+
+  sg16_prepare(dev, &io_hdr, rw, dma, tf, cdb, data, data_bytes, iovec_count, timeout_secs, sb_ptr, sb_size);
+
+  uint64_t issued_ns, duration_us;
+  if (sg_ioctl(dev, &io_hdr, &issued_ns, &duration_us) == -1) {
+    dev->last_resid = io_hdr.dxfer_len;
     dev->last_errno = errno;
     if (dev->verbose >= jcu::dparm::kVerboseError)
       perror("ioctl(fd,SG_IO)");
     return -1;    /* SG_IO not supported */
   }
+  dev->last_resid = io_hdr.resid;
+
+  int rc = sg16_complete(dev, &io_hdr, tf, completion);
+  if (dev->trace)
+    dev->trace->record(kTraceTaskfile, issued_ns, 0, rc, tf, sizeof(*tf));
+  if (dev->latency)
+    sg_latency(dev, &io_hdr, duration_us, rc < 0);
+  return rc;
+}
+
+int sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
+         void *data, unsigned int data_bytes, unsigned int timeout_secs,
+         unsigned char *sense_data, int sense_buf_size, AtaCompletion *completion
+    ) {
+  if (apt_is_apt(dev)) {
+    unsigned char command = tf->command;
+    uint64_t issued_ns = dev->latency ? TraceRing::now() : 0;
+    int rc = apt_sg16(dev, rw, dma, tf, data, data_bytes, timeout_secs);
+    if (dev->latency)
+      dev->latency->record(kLatencyAta, command, (TraceRing::now() - issued_ns) / 1000, rc < 0);
+    if (completion) {
+      *completion = AtaCompletion();
+      completion->setAtaReturn(*tf);
+    }
+    return rc;
+  }
+  return sg16_io(dev, rw, dma, tf, data, data_bytes, 0, timeout_secs, sense_data, sense_buf_size, completion);
+}
+
+int sg16v(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
+          const DparmIoVec *iov, unsigned int iov_count, unsigned int timeout_secs,
+          unsigned char *sense_data, int sense_buf_size, AtaCompletion *completion
+    ) {
+  unsigned int data_bytes = sg_iovec_bytes(iov, iov_count);
+  if (!data_bytes) {
+    dev->last_errno = errno;
+    return -1;
+  }
+
+  if (apt_is_apt(dev)) {
+    // APT bridges take one buffer: bounce through a contiguous copy
+    std::vector<unsigned char> buffer(data_bytes);
+    if (rw) {
+      sg_iovec_gather(iov, iov_count, buffer.data());
+    }
+    int rc = apt_sg16(dev, rw, dma, tf, buffer.data(), data_bytes, timeout_secs);
+    if (!rw) {
+      sg_iovec_scatter(buffer.data(), iov, iov_count);
+    }
+    if (completion) {
+      *completion = AtaCompletion();
+      completion->setAtaReturn(*tf);
+    }
+    return rc;
+  }
+
+  return sg16_io(dev, rw, dma, tf, (void *) iov, data_bytes, iov_count, timeout_secs, sense_data, sense_buf_size, completion);
+}
+
+int sg16_submit(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
+                void *data, unsigned int data_bytes, unsigned int timeout_secs,
+                unsigned char *sense_data, int sense_buf_size,
+                int pack_id, void *usr_ptr
+) {
+  unsigned char cdb[SG_ATA_16_LEN];
+  struct scsi_sg_io_hdr io_hdr;
+
+  if (apt_is_apt(dev)) {
+    errno = ENOTSUP;
+    dev->last_errno = errno;
+    return -1;
+  }
+
+  sg16_prepare(dev, &io_hdr, rw, dma, tf, cdb, data, data_bytes, 0, timeout_secs, sense_data, sense_buf_size);
+  io_hdr.pack_id = pack_id;
+  io_hdr.usr_ptr = usr_ptr;
+
+  // the cdb is copied by write(); data and sense buffers are used until read()
+  if (write(dev->fd, &io_hdr, sizeof(io_hdr)) != (ssize_t) sizeof(io_hdr)) {
+    dev->last_errno = errno;
+    if (dev->verbose >= jcu::dparm::kVerboseError)
+      sgio_dbgprintf(dev, "SG write: %s\n", strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int sg16_reap(scsi_sg_device *dev, struct scsi_sg_io_hdr *io_hdr) {
+  memset(io_hdr, 0, sizeof(struct scsi_sg_io_hdr));
+  io_hdr->interface_id = 'S';
+  io_hdr->pack_id = -1;
+  if (read(dev->fd, io_hdr, sizeof(struct scsi_sg_io_hdr)) != (ssize_t) sizeof(struct scsi_sg_io_hdr)) {
+    dev->last_errno = errno;
+    return -1;
+  }
+  return 0;
+}
+
+int sg16_complete(scsi_sg_device *dev, const struct scsi_sg_io_hdr *io_hdr, ata::ata_tf_t *tf, AtaCompletion *completion) {
+  unsigned char *sb_ptr = (unsigned char *) io_hdr->sbp;
+  int sb_size = io_hdr->mx_sb_len;
+  int rw = (io_hdr->dxfer_direction == SG_DXFER_TO_DEV);
+  void *data = io_hdr->dxferp;
+  int return_code = 0;
+  int demanded_sense = 0;
+  AtaCompletion local_completion;
+
+  if (!completion)
+    completion = &local_completion;
+  completion->scsi_status = io_hdr->status;
+  completion->host_status = io_hdr->host_status;
+  completion->driver_status = io_hdr->driver_status;
+  completion->resid = io_hdr->resid;
+  completion->duration_ms = io_hdr->duration;
+  decodeSenseData(sb_ptr, sb_size, true, completion);
 
   if (dev->verbose >= jcu::dparm::kVerboseDebug)
     sgio_dbgprintf(dev, "SG_IO: ATA_%u status=0x%x, host_status=0x%x, driver_status=0x%x\n",
-            io_hdr.cmd_len, io_hdr.status, io_hdr.host_status, io_hdr.driver_status);
+            io_hdr->cmd_len, io_hdr->status, io_hdr->host_status, io_hdr->driver_status);
 
-  if (io_hdr.status && io_hdr.status != SG_CHECK_CONDITION) {
+  if (io_hdr->status && io_hdr->status != SG_CHECK_CONDITION) {
     if (dev->verbose >= jcu::dparm::kVerboseError)
-      sgio_dbgprintf(dev, "SG_IO: bad status: 0x%x\n", io_hdr.status);
+      sgio_dbgprintf(dev, "SG_IO: bad status: 0x%x\n", io_hdr->status);
     errno = EBADE;
     return -1;
   }
-  if (io_hdr.host_status) {
+  if (io_hdr->host_status) {
     if (dev->verbose >= jcu::dparm::kVerboseError)
-      sgio_dbgprintf(dev, "SG_IO: bad host status: 0x%x\n", io_hdr.host_status);
+      sgio_dbgprintf(dev, "SG_IO: bad host status: 0x%x\n", io_hdr->host_status);
     errno = EBADE;
     return -1;
   }
   if (dev->verbose >= jcu::dparm::kVerboseDebug) {
-    dump_bytes(dev, "SG_IO: sb[]", sb_ptr, sb_size);
+    sgio_dump_bytes(dev, "SG_IO: sb[]", sb_ptr, sb_size);
     if (!rw && data)
-      dump_bytes(dev, "incoming_data", data, data_bytes);
+      dump_data(dev, "incoming_data", io_hdr);
   }
 
-  if (io_hdr.driver_status && (io_hdr.driver_status != SG_DRIVER_SENSE)) {
+  if (io_hdr->driver_status && (io_hdr->driver_status != SG_DRIVER_SENSE)) {
     if (dev->verbose >= jcu::dparm::kVerboseError)
-      sgio_dbgprintf(dev, "SG_IO: bad driver status: 0x%x\n", io_hdr.driver_status);
+      sgio_dbgprintf(dev, "SG_IO: bad driver status: 0x%x\n", io_hdr->driver_status);
     errno = EBADE;
     return -1;
   }
 
-  desc = sb_ptr + 8;
-  if (io_hdr.driver_status != SG_DRIVER_SENSE) {
+  if (io_hdr->driver_status != SG_DRIVER_SENSE) {
     if (sb_ptr[0] | sb_ptr[1] | sb_ptr[2] | sb_ptr[3] | sb_ptr[4] | sb_ptr[5] | sb_ptr[6] | sb_ptr[7] | sb_ptr[8] | sb_ptr[9]) {
       static int second_try = 0;
       if (!second_try++) {
@@ -495,42 +874,21 @@ int sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
         }
       }
     }
-  } else if (sb_ptr[0] != 0x72 || sb_ptr[7] < 14 || desc[0] != 0x09 || desc[1] < 0x0c) {
-    dump_bytes(dev, "SG_IO: bad/missing sense data, sb_ptr[]", sb_ptr, sb_size);
+  } else if (!completion->has_ata_return) {
+    sgio_dump_bytes(dev, "SG_IO: bad/missing sense data, sb_ptr[]", sb_ptr, sb_size);
     return_code = 1;
   }
 
-  if (dev->verbose >= jcu::dparm::kVerboseDebug) {
-    unsigned int len = desc[1] + 2, maxlen = sb_size - 8 - 2;
-    if (len > maxlen)
-      len = maxlen;
-    dump_bytes(dev, "SG_IO: desc[]", desc, len);
-  }
-
-  tf->is_lba48 = desc[2] & 1;
-  tf->error = desc[3];
-  tf->lob.nsect = desc[5];
-  tf->lob.lbal = desc[7];
-  tf->lob.lbam = desc[9];
-  tf->lob.lbah = desc[11];
-  tf->dev = desc[12];
-  tf->status = desc[13];
-  tf->hob.feat = 0;
-  if (tf->is_lba48) {
-    tf->hob.nsect = desc[4];
-    tf->hob.lbal = desc[6];
-    tf->hob.lbam = desc[8];
-    tf->hob.lbah = desc[10];
-  } else {
-    tf->hob.nsect = 0;
-    tf->hob.lbal = 0;
-    tf->hob.lbam = 0;
-    tf->hob.lbah = 0;
-  }
+  if (dev->verbose >= jcu::dparm::kVerboseDebug && completion->sense_response_code)
+    sgio_dbgprintf(dev, "SG_IO: sense key=0x%x asc=0x%02x ascq=0x%02x\n",
+            completion->sense_key, completion->asc, completion->ascq);
+
+  // descriptor or fixed format (SAT-3 12.2.2.6, 12.2.2.7). all zero without sense data.
+  completion->getAtaReturn(tf);
 
   if (dev->verbose >= jcu::dparm::kVerboseDebug)
     sgio_dbgprintf(dev, "      ATA_%u stat=%02x err=%02x nsect=%02x lbal=%02x lbam=%02x lbah=%02x dev=%02x\n",
-            io_hdr.cmd_len, tf->status, tf->error, tf->lob.nsect, tf->lob.lbal, tf->lob.lbam, tf->lob.lbah, tf->dev);
+            io_hdr->cmd_len, tf->status, tf->error, tf->lob.nsect, tf->lob.lbal, tf->lob.lbam, tf->lob.lbah, tf->dev);
 
   if (tf->status & (ATA_STAT_ERR | ATA_STAT_DRQ)) {
     if (dev->verbose >= jcu::dparm::kVerboseError) {
@@ -18,7 +18,11 @@
 
 #include <linux/types.h>
 
+#include <jcu-dparm/types.h>
 #include <jcu-dparm/ata_types.h>
+#include <jcu-dparm/trace_ring.h>
+#include <jcu-dparm/latency_stats.h>
+#include <jcu-dparm/sense_data.h>
 
 #include "apt.h"
 
@@ -208,6 +212,28 @@ struct scsi_sg_device {
   int verbose;
   int last_errno;
   std::function<int(const std::string&)> debug_puts;
+  /**
+   * nullable
+   */
+  TraceRing *trace;
+  /**
+   * nullable
+   */
+  LatencyStats *latency;
+  CommandRetryPolicy retry;
+  /**
+   * do not clear read buffers before the transfer.
+   * Only the first (dxfer_len - last_resid) bytes are valid then.
+   */
+  int no_read_zeroing;
+  /**
+   * resid of the last SG_IO (bytes not transferred)
+   */
+  int last_resid;
+  /**
+   * nullable. Issues SG_IO instead of ioctl(fd, SG_IO, io_hdr) (tests)
+   */
+  std::function<int(int fd, struct scsi_sg_io_hdr *io_hdr)> sg_io;
 };
 
 #ifndef SG_DXFER_NONE
@@ -252,6 +278,22 @@ int do_sg_ata(
     unsigned char *sense_data, unsigned int sense_buf_size
     );
 
+/**
+ * do_sg_ata with a scatter-gather data buffer (SG_IO iovec_count)
+ *
+ * @param iov       (in) data segments, at most 65535
+ * @param iov_count (in) number of segments
+ */
+int do_sg_ata_v(
+    scsi_sg_device *dev,
+    int rw,
+    unsigned char* cdb, unsigned int cdb_bytes,
+    const DparmIoVec *iov, unsigned int iov_count,
+    int pack_id,
+    unsigned int timeout_secs,
+    unsigned char *sense_data, unsigned int sense_buf_size
+    );
+
 /**
  *
  * @param dev
@@ -263,9 +305,61 @@ int do_sg_ata(
  * @param timeout_secs
  * @param sense_buf min 32 bytes
  * @param sense_buf_size 32
+ * @param completion (out) nullable. decoded SCSI status, sense and ATA return
  * @return
  */
-int sg16 (scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf, void *data, unsigned int data_bytes, unsigned int timeout_secs, unsigned char *sense_data, int sense_buf_size);
+int sg16 (scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf, void *data, unsigned int data_bytes, unsigned int timeout_secs, unsigned char *sense_data, int sense_buf_size, AtaCompletion *completion);
+
+/**
+ * @return total bytes, or 0 with errno if the list can not be passed to SG_IO
+ */
+unsigned int sg_iovec_bytes(const DparmIoVec *iov, unsigned int iov_count);
+
+/**
+ * copy the segments to a contiguous buffer of sg_iovec_bytes() bytes
+ */
+void sg_iovec_gather(const DparmIoVec *iov, unsigned int iov_count, unsigned char *buffer);
+
+/**
+ * copy a contiguous buffer of sg_iovec_bytes() bytes to the segments
+ */
+void sg_iovec_scatter(const unsigned char *buffer, const DparmIoVec *iov, unsigned int iov_count);
+
+/**
+ * sg16 with a scatter-gather data buffer
+ *
+ * The segments go to the kernel as they are. APT devices fall back to a contiguous bounce buffer.
+ */
+int sg16v (scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf, const DparmIoVec *iov, unsigned int iov_count, unsigned int timeout_secs, unsigned char *sense_data, int sense_buf_size, AtaCompletion *completion);
+
+/**
+ * queue sg16 on a /dev/sgN node (opened O_RDWR) without waiting
+ *
+ * data and sense_data must stay valid until the command is reaped.
+ * APT devices are not supported (ENOTSUP).
+ *
+ * @param pack_id (in) returned in scsi_sg_io_hdr.pack_id by sg16_reap
+ * @param usr_ptr (in) returned in scsi_sg_io_hdr.usr_ptr by sg16_reap
+ * @return zero if queued, otherwise -1 with errno
+ */
+int sg16_submit (scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf, void *data, unsigned int data_bytes, unsigned int timeout_secs, unsigned char *sense_data, int sense_buf_size, int pack_id, void *usr_ptr);
+
+/**
+ * read one finished command of sg16_submit (the oldest one)
+ *
+ * @return zero if successful, otherwise -1 with errno (EAGAIN: nothing finished on a O_NONBLOCK fd)
+ */
+int sg16_reap (scsi_sg_device *dev, struct scsi_sg_io_hdr *io_hdr);
+
+/**
+ * check the result of a finished sg16 command
+ *
+ * @param io_hdr     (in)  header filled by the kernel
+ * @param tf         (out) result Task File
+ * @param completion (out) nullable
+ * @return same as sg16
+ */
+int sg16_complete (scsi_sg_device *dev, const struct scsi_sg_io_hdr *io_hdr, ata::ata_tf_t *tf, AtaCompletion *completion);
 int do_drive_cmd (scsi_sg_device *dev, unsigned char *args, unsigned int timeout);
 int do_taskfile_cmd (scsi_sg_device *dev, struct hdio_taskfile *r, unsigned int timeout_secs);
 //int dev_has_sgio (scsi_sg_device *dev);
@@ -279,6 +373,10 @@ int apt_sg16(scsi_sg_device *dev, int rw, int dma, ata::ata_tf_t *tf,
 		void *data, unsigned int data_bytes, unsigned int timeout_secs);
 
 int sgio_dbgprintf(scsi_sg_device *dev, const char* fmt, ...);
+/**
+ * debug_puts one line of "prefix: xx xx ..."
+ */
+void sgio_dump_bytes(scsi_sg_device *dev, const char *prefix, const void *in, int len);
 
 } // namespace dparm
 } // namespace jcu
@@ -0,0 +1,177 @@
+/**
+ * @file	sysfs_resolver.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/17
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+
+#include "sysfs_resolver.h"
+
+namespace jcu {
+namespace dparm {
+
+static const int kMaxAncestorDepth = 20;
+
+/**
+ * @return true if the "dev" attribute of dir_fd is still the device (a device number may be reused after hot-unplug)
+ */
+static bool isDevice(int dir_fd, dev_t dev) {
+  char buffer[32];
+  unsigned int maj, min;
+  int fd = openat(dir_fd, "dev", O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+  ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (length <= 0)
+    return false;
+  buffer[length] = 0;
+  if (sscanf(buffer, "%u:%u", &maj, &min) != 2)
+    return false;
+  return maj == (unsigned) major(dev) && min == (unsigned) minor(dev);
+}
+
+static bool isStopDirectory(int dir_fd, const struct stat *stop) {
+  struct stat st;
+  if (fstat(dir_fd, &st) != 0)
+    return true;
+  return st.st_dev == stop->st_dev && st.st_ino == stop->st_ino;
+}
+
+/**
+ * @param depth (in) number of ".." from the device directory
+ * @return directory fd, or -1 with errno
+ */
+static int openParent(int device_fd, int depth) {
+  int fd = openat(device_fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  while (fd != -1 && --depth > 0) {
+    int parent_fd = openat(fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    close(fd);
+    fd = parent_fd;
+  }
+  return fd;
+}
+
+SysfsResolver::SysfsResolver(const std::string& root)
+    : root_(root) {
+}
+
+int SysfsResolver::resolve(const Key& key, std::string *path, int verbose) const {
+  char link[64];
+  char *real;
+
+  snprintf(link, sizeof(link), "/dev/%s/%u:%u", key.first ? "char" : "block", major(key.second), minor(key.second));
+  real = realpath((root_ + link).c_str(), NULL);
+  if (!real) {
+    int err = errno;
+    if (verbose)
+      fprintf(stderr, "%u,%u: device not found in %s\n", major(key.second), minor(key.second), root_.c_str());
+    return err;
+  }
+  path->assign(real);
+  free(real);
+  return 0;
+}
+
+int SysfsResolver::openDevice(dev_t dev, bool is_char, int verbose) {
+  Key key(is_char, dev);
+  std::string path;
+  int fd;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+      path = it->second.path;
+  }
+  if (!path.empty()) {
+    fd = ::open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd != -1 && isDevice(fd, dev))
+      return fd;
+    if (fd != -1)
+      close(fd);
+  }
+
+  int err = resolve(key, &path, verbose);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  fd = ::open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[key];
+  if (entry.path != path) {
+    entry.path = path;
+    entry.ancestor_depth.clear();
+  }
+  return fd;
+}
+
+int SysfsResolver::openAncestor(dev_t dev, bool is_char, int device_fd, const char *attr) {
+  Key key(is_char, dev);
+  int depth = 0;
+  int fd;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      auto depth_it = it->second.ancestor_depth.find(attr);
+      if (depth_it != it->second.ancestor_depth.end())
+        depth = depth_it->second;
+    }
+  }
+  if (depth > 0) {
+    fd = openParent(device_fd, depth);
+    if (fd != -1 && faccessat(fd, attr, R_OK, 0) == 0)
+      return fd;
+    if (fd != -1)
+      close(fd);
+  }
+
+  struct stat stop;
+  if (stat((root_ + "/devices").c_str(), &stop) != 0)
+    return -1;
+
+  depth = -1;
+  fd = openat(device_fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  for (int level = 1; fd != -1 && level <= kMaxAncestorDepth; level++) {
+    if (isStopDirectory(fd, &stop))
+      break;
+    if (faccessat(fd, attr, R_OK, 0) == 0) {
+      depth = level;
+      break;
+    }
+    int parent_fd = openat(fd, "..", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    close(fd);
+    fd = parent_fd;
+  }
+  if (depth < 0) {
+    if (fd != -1)
+      close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end())
+    it->second.ancestor_depth[attr] = depth;
+  return fd;
+}
+
+} // namespace dparm
+} // namespace jcu
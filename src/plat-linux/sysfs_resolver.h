@@ -0,0 +1,76 @@
+/**
+ * @file	sysfs_resolver.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/17
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_PLAT_LINUX_SYSFS_RESOLVER_H_
+#define JCU_DPARM_SRC_PLAT_LINUX_SYSFS_RESOLVER_H_
+
+#include <sys/types.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace jcu {
+namespace dparm {
+
+/**
+ * sysfs directories of devices, cached by device number
+ *
+ * The device directory is resolved through {root}/dev/{block,char}/MAJ:MIN and
+ * attributes are read with openat() relative to directory fds, so no path buffer is shared.
+ * The lock only guards the cache; lookups and reads run concurrently (EnumDrivesOptions::parallel).
+ */
+class SysfsResolver {
+ private:
+  typedef std::pair<bool, dev_t> Key;
+
+  struct Entry {
+    /**
+     * canonical sysfs directory of the device
+     */
+    std::string path;
+    /**
+     * attribute -> number of ".." up to the directory holding it.
+     * Misses are not cached: the attribute may appear later (e.g. a bridge driver bound after open).
+     */
+    std::map<std::string, int> ancestor_depth;
+  };
+
+  std::string root_;
+  std::mutex mutex_;
+  std::map<Key, Entry> entries_;
+
+  int resolve(const Key& key, std::string *path, int verbose) const;
+
+ public:
+  /**
+   * @param root (in) sysfs mount point
+   */
+  explicit SysfsResolver(const std::string& root = "/sys");
+
+  /**
+   * @return O_PATH directory fd of the device, or -1 with errno
+   */
+  int openDevice(dev_t dev, bool is_char, int verbose);
+
+  /**
+   * find the nearest parent directory of the device holding attr (e.g. the USB device of a bridge),
+   * below {root}/devices
+   *
+   * @param device_fd (in) fd returned by openDevice
+   * @return O_PATH directory fd, or -1 with errno
+   */
+  int openAncestor(dev_t dev, bool is_char, int device_fd, const char *attr);
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_PLAT_LINUX_SYSFS_RESOLVER_H_
@@ -10,13 +10,32 @@
 #ifndef JCU_DPARM_SRC_PLAT_LINUX_SYSFS_UTILS_H_
 #define JCU_DPARM_SRC_PLAT_LINUX_SYSFS_UTILS_H_
 
+#include <string>
+
 namespace jcu {
 namespace dparm {
 
+/*
+ * The sysfs directory of the device of fd is cached by device number.
+ * These functions are reentrant.
+ */
+
 int sysfs_get_attr (int fd, const char *attr, const char *fmt, void *val1, void *val2, int verbose);
 int sysfs_set_attr (int fd, const char *attr, const char *fmt, void *val_p, int verbose);
+/**
+ * read attr of the nearest parent directory of the device holding it (e.g. idVendor of a USB bridge)
+ */
 int sysfs_get_attr_recursive (int fd, const char *attr, const char *fmt, void *val1, void *val2, int verbose);
 
+/**
+ * read whole sysfs attribute file
+ *
+ * @param path  (in)  attribute file path
+ * @param value (out) file content. trailing whitespaces and newline are removed.
+ * @return zero if successful, otherwise errno.
+ */
+int sysfs_read_string (const std::string& path, std::string *value);
+
 } // namespace dparm
 } // namespace jcu
 
@@ -0,0 +1,165 @@
+/**
+ * @file	uevent_source.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "uevent_source.h"
+
+namespace jcu {
+namespace dparm {
+namespace plat_linux {
+
+bool uevent_parse(const char *buf, size_t length, DeviceEvent *event) {
+  const char *end = buf + length;
+  const char *p = buf;
+  std::string action;
+  std::string subsystem;
+  std::string devtype;
+  std::string devname;
+
+  // kernel messages begin with "ACTION@DEVPATH". (udevd ones begin with "libudev")
+  size_t header_len = strnlen(p, length);
+  if (header_len == length || !memchr(p, '@', header_len)) {
+    return false;
+  }
+  p += header_len + 1;
+
+  while (p < end) {
+    size_t len = strnlen(p, end - p);
+    const char *eq = (const char *) memchr(p, '=', len);
+    if (eq) {
+      std::string key(p, eq - p);
+      std::string value(eq + 1, p + len);
+      if (key == "ACTION") {
+        action = value;
+      } else if (key == "SUBSYSTEM") {
+        subsystem = value;
+      } else if (key == "DEVTYPE") {
+        devtype = value;
+      } else if (key == "DEVNAME") {
+        devname = value;
+      }
+    }
+    p += len + 1;
+  }
+
+  if (subsystem != "block" || devtype != "disk" || devname.empty()) {
+    return false;
+  }
+  // same as enumDrives
+  if (devname.find("loop") != std::string::npos) {
+    return false;
+  }
+
+  if (action == "add") {
+    event->action = kDeviceAdd;
+  } else if (action == "remove") {
+    event->action = kDeviceRemove;
+  } else if (action == "change") {
+    event->action = kDeviceChange;
+  } else {
+    return false;
+  }
+
+  event->dev_name = devname;
+  event->device_path = "/dev/" + devname;
+  return true;
+}
+
+UeventSource::UeventSource()
+    : fd_(-1)
+{
+}
+
+UeventSource::~UeventSource() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+int UeventSource::init() {
+  struct sockaddr_nl addr = {0};
+
+  fd_ = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+  if (fd_ < 0) {
+    return errno;
+  }
+
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1; // kernel events
+  if (bind(fd_, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+    int err = errno;
+    ::close(fd_);
+    fd_ = -1;
+    return err;
+  }
+
+  return 0;
+}
+
+int UeventSource::readEvent(DeviceEvent &event, int timeout_ms) {
+  char buf[8192];
+
+  if (fd_ < 0) {
+    return EBADF;
+  }
+
+  for (;;) {
+    struct sockaddr_nl sender = {0};
+    struct iovec iov = { buf, sizeof(buf) - 1 };
+    struct msghdr msg = {0};
+    msg.msg_name = &sender;
+    msg.msg_namelen = sizeof(sender);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    ssize_t len = recvmsg(fd_, &msg, 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return errno;
+      }
+
+      struct pollfd pfd = { fd_, POLLIN, 0 };
+      int rc = poll(&pfd, 1, timeout_ms);
+      if (rc < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errno;
+      }
+      if (rc == 0) {
+        return ETIMEDOUT;
+      }
+      continue;
+    }
+
+    // accept only messages from the kernel
+    if (sender.nl_pid != 0 || (msg.msg_flags & MSG_TRUNC)) {
+      continue;
+    }
+
+    buf[len] = 0;
+    if (uevent_parse(buf, len, &event)) {
+      return 0;
+    }
+  }
+}
+
+} // namespace plat_linux
+} // namespace dparm
+} // namespace jcu
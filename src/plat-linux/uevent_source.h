@@ -0,0 +1,51 @@
+/**
+ * @file	uevent_source.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_PLAT_LINUX_UEVENT_SOURCE_H_
+#define JCU_DPARM_SRC_PLAT_LINUX_UEVENT_SOURCE_H_
+
+#include <stddef.h>
+
+#include <jcu-dparm/drive_inventory.h>
+
+namespace jcu {
+namespace dparm {
+namespace plat_linux {
+
+/**
+ * parse a kernel uevent message ("ACTION@DEVPATH\0KEY=VALUE\0...")
+ *
+ * @param buf    (in)  message
+ * @param length (in)  message length
+ * @param event  (out) event
+ * @return true if it is an add/remove/change event of a whole disk (SUBSYSTEM=block, DEVTYPE=disk, except loop)
+ */
+bool uevent_parse(const char *buf, size_t length, DeviceEvent *event);
+
+class UeventSource : public DeviceEventSource {
+ private:
+  int fd_;
+
+ public:
+  UeventSource();
+  ~UeventSource() override;
+
+  /**
+   * @return zero if successful, otherwise errno.
+   */
+  int init();
+
+  int readEvent(DeviceEvent &event, int timeout_ms) override;
+};
+
+} // namespace plat_linux
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_PLAT_LINUX_UEVENT_SOURCE_H_
@@ -9,12 +9,20 @@
 
 #include <map>
 #include <list>
+#include <vector>
+#include <mutex>
+#include <atomic>
 
 #include <jcu-dparm/drive_factory.h>
 #include <jcu-dparm/drive_handle.h>
+#include <jcu-dparm/drive_inventory.h>
+#include <jcu-dparm/async_command_queue.h>
 
 #include "../drive_driver_handle.h"
 #include "../drive_handle_base.h"
+#include "../intl_utils.h"
+#include "../drive_filter.h"
+#include "../shared_handle_cache.h"
 
 #include "driver_base.h"
 #include "drivers/scsi_driver.h"
@@ -46,8 +54,8 @@ class Win32DriveHandle : public DriveHandleBase {
       : DriveHandleBase(options, path, open_result), handle_(std::move(handle)), last_error_(open_result) {
   }
 
-  void init() {
-    afterOpen();
+  bool init(const EnumDrivesFilter* filter) {
+    return afterOpen(filter);
   }
 
   bool isOpen() const override {
@@ -70,6 +78,7 @@ class Win32DriveFactory : public DriveFactory {
  private:
   const DriveFactoryOptions options_;
   std::list<std::unique_ptr<DriverBase>> drivers_;
+  mutable SharedHandleCache shared_handles_;
 
  public:
   Win32DriveFactory(const DriveFactoryOptions &options)
@@ -94,12 +103,26 @@ class Win32DriveFactory : public DriveFactory {
 
     std::unique_ptr<Win32DriveHandle> drive_handle(new Win32DriveHandle(options_, drive_path, std::move(driver_handle.value), driver_handle));
     if (driver_handle.isOk()) {
-      drive_handle->init();
+      drive_handle->init(nullptr);
     }
     return std::move(drive_handle);
   }
 
-  std::unique_ptr<DriveHandle> open(const WindowsPhysicalDrive &drive_info) const {
+  std::shared_ptr<DriveHandle> openShared(const char *drive_path) const override {
+    return shared_handles_.get(drive_path, 0, [this, drive_path]() -> std::unique_ptr<DriveHandle> {
+      return open(drive_path);
+    });
+  }
+
+  void invalidateShared(const char *drive_path) const override {
+    shared_handles_.invalidate(drive_path);
+  }
+
+  /**
+   * @param filter (in) nullable
+   * @return nullptr if the drive is excluded by the filter
+   */
+  std::unique_ptr<DriveHandle> open(const WindowsPhysicalDrive &drive_info, const EnumDrivesFilter* filter) const {
     DparmReturn<std::unique_ptr<WindowsDriverHandle>> driver_handle;
     std::string found_device_path;
 
@@ -117,26 +140,99 @@ class Win32DriveFactory : public DriveFactory {
 
     std::unique_ptr<Win32DriveHandle> drive_handle(new Win32DriveHandle(options_, found_device_path, std::move(driver_handle.value), driver_handle));
     if (driver_handle.isOk()) {
-      drive_handle->init();
+      if (!drive_handle->init(filter)) {
+        return nullptr;
+      }
+    } else if (filter) {
+      const DriveInfo& info = drive_handle->getDriveInfo();
+      if (!matchDriveFilter(*filter, kFilterStageIdentify, info) || !matchDriveFilter(*filter, kFilterStageTcg, info)) {
+        return nullptr;
+      }
     }
     return std::move(drive_handle);
   }
 
   int enumDrives(std::list<DriveInfo>& result_list) const override {
+    return enumDrives(result_list, EnumDrivesOptions());
+  }
+
+  int enumDrives(std::list<DriveInfo>& result_list, const EnumDrivesOptions& options) const override {
     int rc;
-    std::list<WindowsPhysicalDrive> devices;
-    rc = enumPhysicalDrives(devices);
+    std::list<WindowsPhysicalDrive> device_list;
+    rc = enumPhysicalDrives(device_list);
     if (rc)
       return rc;
 
-    for (auto it = devices.cbegin(); it != devices.cend(); it++) {
-      auto handle = open(*it);
-      result_list.emplace_back(handle->getDriveInfo());
+    std::vector<WindowsPhysicalDrive> devices(device_list.cbegin(), device_list.cend());
+    std::vector<DriveInfo> drive_infos(devices.size());
+    std::vector<char> matched(devices.size(), 0);
+    intl::parallelFor(devices.size(), options.parallel, [this, &options, &devices, &drive_infos, &matched](size_t index) -> void {
+      auto handle = open(devices[index], &options.filter);
+      if (handle) {
+        handle->runPendingTcgDiscovery();
+        drive_infos[index] = handle->getDriveInfo();
+        matched[index] = 1;
+      }
+    });
+
+    for (size_t i = 0; i < drive_infos.size(); i++) {
+      if (matched[i]) {
+        result_list.emplace_back(std::move(drive_infos[i]));
+      }
     }
 
     return rc;
   }
 
+  int enumDrives(const EnumDrivesCallback& callback, const EnumDrivesOptions& options) const override {
+    int rc;
+    std::list<WindowsPhysicalDrive> device_list;
+    rc = enumPhysicalDrives(device_list);
+    if (rc)
+      return rc;
+
+    std::vector<WindowsPhysicalDrive> devices(device_list.cbegin(), device_list.cend());
+    std::mutex callback_mutex;
+    std::atomic<bool> stopped(false);
+    intl::parallelFor(devices.size(), options.parallel, [this, &options, &devices, &callback, &callback_mutex, &stopped](size_t index) -> void {
+      if (stopped) {
+        return;
+      }
+      auto handle = open(devices[index], &options.filter);
+      if (!handle) {
+        return;
+      }
+      handle->runPendingTcgDiscovery();
+      // a copy: the handle may be moved out and closed by the callback
+      DriveInfo drive_info = handle->getDriveInfo();
+      std::lock_guard<std::mutex> lock(callback_mutex);
+      if (!stopped && !callback(drive_info, handle)) {
+        stopped = true;
+      }
+    });
+
+    return rc;
+  }
+
+  int probeDrive(const char *drive_path, DriveInfo& drive_info, const EnumDrivesOptions& options) const override {
+    auto handle = open(drive_path);
+    handle->runPendingTcgDiscovery();
+    drive_info = handle->getDriveInfo();
+    if (!matchDriveFilter(options.filter, kFilterStageIdentify, drive_info) ||
+        !matchDriveFilter(options.filter, kFilterStageTcg, drive_info)) {
+      return ENODEV;
+    }
+    return 0;
+  }
+
+  std::unique_ptr<DeviceEventSource> createDeviceEventSource() const override {
+    return nullptr;
+  }
+
+  std::unique_ptr<AsyncCommandQueue> createAsyncCommandQueue() const override {
+    return nullptr;
+  }
+
   std::unique_ptr<EnumVolumesContext> enumVolumes() const override {
     std::unique_ptr<Win32EnumVolumesContext> ctx(new Win32EnumVolumesContext());
     ctx->init();
@@ -158,10 +254,14 @@ static int debugToStderrPuts(const std::string& text) {
   return fputs(text.c_str(), stderr);
 }
 
+static DriveFactoryOptions systemFactoryOptions() {
+  DriveFactoryOptions options;
+  options.debug_puts = debugToStderrPuts;
+  return options;
+}
+
 DriveFactory* DriveFactory::getSystemFactory() {
-  static DriveFactoryOptions options = {
-      debugToStderrPuts
-  };
+  static DriveFactoryOptions options = systemFactoryOptions();
   static plat_win::Win32DriveFactory INSTANCE(options);
   return &INSTANCE;
 }
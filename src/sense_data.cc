@@ -0,0 +1,159 @@
+/**
+ * @file	sense_data.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <jcu-dparm/sense_data.h>
+
+namespace jcu {
+namespace dparm {
+
+static void clear_sense(AtaCompletion *completion) {
+  completion->sense_response_code = 0;
+  completion->sense_key = 0;
+  completion->asc = 0;
+  completion->ascq = 0;
+  completion->has_ata_return = false;
+  completion->ata_extend = false;
+  completion->ata_upper_unknown = false;
+  completion->ata_status = 0;
+  completion->ata_error = 0;
+  completion->ata_device = 0;
+  completion->ata_count = 0;
+  completion->ata_lba = 0;
+}
+
+/**
+ * @see SAT-3 12.2.2.6 ATA Status Return sense data descriptor
+ */
+static void decode_ata_return_descriptor(const unsigned char *desc, AtaCompletion *completion) {
+  completion->has_ata_return = true;
+  completion->ata_extend = desc[2] & 0x01;
+  completion->ata_error = desc[3];
+  completion->ata_count = desc[5];
+  completion->ata_lba = ((uint64_t) desc[7]) | ((uint64_t) desc[9] << 8) | ((uint64_t) desc[11] << 16);
+  if (completion->ata_extend) {
+    completion->ata_count |= (uint16_t) (desc[4] << 8);
+    completion->ata_lba |= ((uint64_t) desc[6] << 24) | ((uint64_t) desc[8] << 32) | ((uint64_t) desc[10] << 40);
+  }
+  completion->ata_device = desc[12];
+  completion->ata_status = desc[13];
+}
+
+bool decodeSenseData(const unsigned char *sense, size_t length, bool ata_pass_through, AtaCompletion *completion) {
+  clear_sense(completion);
+  if (!sense || length < 1) {
+    return false;
+  }
+
+  uint8_t response_code = sense[0] & 0x7f;
+  if (response_code == 0x72 || response_code == 0x73) {
+    if (length < 8) {
+      return false;
+    }
+    completion->sense_response_code = response_code;
+    completion->sense_key = sense[1] & 0x0f;
+    completion->asc = sense[2];
+    completion->ascq = sense[3];
+
+    size_t end = 8 + (size_t) sense[7];
+    if (end > length) {
+      end = length;
+    }
+    for (size_t pos = 8; pos + 2 <= end; pos += 2 + sense[pos + 1]) {
+      if (sense[pos] == 0x09 && sense[pos + 1] >= 0x0c && pos + 14 <= end) {
+        decode_ata_return_descriptor(sense + pos, completion);
+        break;
+      }
+    }
+    return true;
+  }
+
+  if (response_code == 0x70 || response_code == 0x71) {
+    if (length < 3) {
+      return false;
+    }
+    completion->sense_response_code = response_code;
+    completion->sense_key = sense[2] & 0x0f;
+    if (length >= 14) {
+      completion->asc = sense[12];
+      completion->ascq = sense[13];
+    }
+    // SAT-3 12.2.2.7: INFORMATION and COMMAND-SPECIFIC INFORMATION hold the ATA registers,
+    // only with ATA PASS-THROUGH INFORMATION AVAILABLE. Other sense (e.g. ILLEGAL REQUEST) is a SCSI error.
+    if (ata_pass_through && length >= 14 && sense[12] == 0x00 && sense[13] == 0x1d) {
+      completion->has_ata_return = true;
+      completion->ata_error = sense[3];
+      completion->ata_status = sense[4];
+      completion->ata_device = sense[5];
+      completion->ata_count = sense[6];
+      completion->ata_extend = sense[8] & 0x80;
+      completion->ata_upper_unknown = (sense[8] & 0x60) != 0;
+      completion->ata_lba = ((uint64_t) sense[9]) | ((uint64_t) sense[10] << 8) | ((uint64_t) sense[11] << 16);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+bool AtaCompletion::isTransient() const {
+  // SAM status
+  if (scsi_status == 0x08 || scsi_status == 0x28) {
+    return true;
+  }
+  // linux DID_BUS_BUSY, DID_IMM_RETRY, DID_REQUEUE
+  if (host_status == 0x02 || host_status == 0x0c || host_status == 0x0d) {
+    return true;
+  }
+  if (sense_key == kSenseUnitAttention) {
+    return true;
+  }
+  // LOGICAL UNIT IS IN PROCESS OF BECOMING READY
+  return sense_key == kSenseNotReady && asc == 0x04 && ascq == 0x01;
+}
+
+void AtaCompletion::setAtaReturn(const ata::ata_tf_t &tf) {
+  has_ata_return = true;
+  ata_extend = tf.is_lba48;
+  ata_upper_unknown = false;
+  ata_status = tf.status;
+  ata_error = tf.error;
+  ata_device = tf.dev;
+  ata_count = tf.lob.nsect;
+  ata_lba = ((uint64_t) tf.lob.lbal) | ((uint64_t) tf.lob.lbam << 8) | ((uint64_t) tf.lob.lbah << 16);
+  if (tf.is_lba48) {
+    ata_count |= (uint16_t) (tf.hob.nsect << 8);
+    ata_lba |= ((uint64_t) tf.hob.lbal << 24) | ((uint64_t) tf.hob.lbam << 32) | ((uint64_t) tf.hob.lbah << 40);
+  }
+}
+
+void AtaCompletion::getAtaReturn(ata::ata_tf_t *tf) const {
+  tf->is_lba48 = ata_extend;
+  tf->error = ata_error;
+  tf->status = ata_status;
+  tf->dev = ata_device;
+  tf->lob.nsect = (uint8_t) ata_count;
+  tf->lob.lbal = (uint8_t) ata_lba;
+  tf->lob.lbam = (uint8_t) (ata_lba >> 8);
+  tf->lob.lbah = (uint8_t) (ata_lba >> 16);
+  tf->hob.feat = 0;
+  if (ata_extend) {
+    tf->hob.nsect = (uint8_t) (ata_count >> 8);
+    tf->hob.lbal = (uint8_t) (ata_lba >> 24);
+    tf->hob.lbam = (uint8_t) (ata_lba >> 32);
+    tf->hob.lbah = (uint8_t) (ata_lba >> 40);
+  } else {
+    tf->hob.nsect = 0;
+    tf->hob.lbal = 0;
+    tf->hob.lbam = 0;
+    tf->hob.lbah = 0;
+  }
+}
+
+} // namespace dparm
+} // namespace jcu
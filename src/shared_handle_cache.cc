@@ -0,0 +1,49 @@
+/**
+ * @file	shared_handle_cache.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include "shared_handle_cache.h"
+
+namespace jcu {
+namespace dparm {
+
+std::shared_ptr<DriveHandle> SharedHandleCache::get(const std::string &path, uint64_t device_key, const OpenFunction &opener) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+      if (it->second.device_key == device_key && it->second.handle->isOpen()) {
+        return it->second.handle;
+      }
+      // the path points another device now, or the handle was closed
+      entries_.erase(it);
+    }
+  }
+
+  std::shared_ptr<DriveHandle> handle(opener());
+  if (!handle || !handle->isOpen()) {
+    return handle;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto result = entries_.emplace(path, Entry{handle, device_key});
+  // another thread opened it meanwhile: share that one
+  return result.first->second.handle;
+}
+
+void SharedHandleCache::invalidate(const char *path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (path) {
+    entries_.erase(path);
+  } else {
+    entries_.clear();
+  }
+}
+
+} // namespace dparm
+} // namespace jcu
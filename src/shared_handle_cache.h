@@ -0,0 +1,66 @@
+/**
+ * @file	shared_handle_cache.h
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#ifndef JCU_DPARM_SRC_SHARED_HANDLE_CACHE_H_
+#define JCU_DPARM_SRC_SHARED_HANDLE_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+#include <jcu-dparm/drive_handle.h>
+
+namespace jcu {
+namespace dparm {
+
+/**
+ * Open handles kept by path for DriveFactory::openShared
+ *
+ * An entry is checked only against the device number; a drive replaced under the same number
+ * keeps the old handle until invalidate(), which DriveInventory::handleEvent triggers through
+ * DriveFactory::invalidateShared.
+ *
+ * Thread safe.
+ */
+class SharedHandleCache {
+ public:
+  typedef std::function<std::unique_ptr<DriveHandle>()> OpenFunction;
+
+ private:
+  struct Entry {
+    std::shared_ptr<DriveHandle> handle;
+    uint64_t device_key;
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+
+ public:
+  /**
+   * @param path       (in) drive path
+   * @param device_key (in) platform device number of the path. An entry of another key or a closed handle is reopened.
+   * @param opener     (in) called without the lock on a miss
+   * @return the cached handle, or a new handle. A handle failed to open is returned but not cached.
+   */
+  std::shared_ptr<DriveHandle> get(const std::string& path, uint64_t device_key, const OpenFunction& opener);
+
+  /**
+   * @param path (in) nullptr : all entries
+   */
+  void invalidate(const char* path);
+};
+
+} // namespace dparm
+} // namespace jcu
+
+#endif //JCU_DPARM_SRC_SHARED_HANDLE_CACHE_H_
@@ -33,16 +33,16 @@ TcgDeviceType TcgDeviceEnterprise::getDeviceType() const {
 
 uint16_t TcgDeviceEnterprise::getBaseComId() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcEnterprise);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_enterprise_ssc_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcEnterprise);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_enterprise_ssc_feature_t *)descriptor;
   return SWAP16(feature->base_com_id);
 }
 uint16_t TcgDeviceEnterprise::getNumComIds() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcEnterprise);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_enterprise_ssc_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcEnterprise);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_enterprise_ssc_feature_t *)descriptor;
   return SWAP16(feature->number_com_ids);
 }
 
@@ -44,45 +44,45 @@ bool TcgDeviceGeneric::isLockingSupported() const {
 bool TcgDeviceGeneric::isLockingEnabled() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
   if (!drive_info.tcg_locking) return false;
-  auto feat_it = drive_info.tcg_raw_features.find(kFcLocking);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_locking_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcLocking);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_locking_feature_t *)descriptor;
   return feature->locking_enabled ? true : false;
 }
 
 bool TcgDeviceGeneric::isLocked() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
   if (!drive_info.tcg_locking) return false;
-  auto feat_it = drive_info.tcg_raw_features.find(kFcLocking);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_locking_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcLocking);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_locking_feature_t *)descriptor;
   return feature->locked ? true : false;
 }
 
 bool TcgDeviceGeneric::isMBREnabled() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
   if (!drive_info.tcg_locking) return false;
-  auto feat_it = drive_info.tcg_raw_features.find(kFcLocking);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_locking_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcLocking);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_locking_feature_t *)descriptor;
   return feature->mbr_enabled ? true : false;
 }
 
 bool TcgDeviceGeneric::isMBRDone() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
   if (!drive_info.tcg_locking) return false;
-  auto feat_it = drive_info.tcg_raw_features.find(kFcLocking);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_locking_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcLocking);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_locking_feature_t *)descriptor;
   return feature->mbr_done ? true : false;
 }
 
 bool TcgDeviceGeneric::isMediaEncryption() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
   if (!drive_info.tcg_locking) return false;
-  auto feat_it = drive_info.tcg_raw_features.find(kFcLocking);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_locking_feature_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcLocking);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_locking_feature_t *)descriptor;
   return feature->media_encryption ? true : false;
 }
 
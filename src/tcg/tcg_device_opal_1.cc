@@ -29,17 +29,17 @@ TcgDeviceType TcgDeviceOpal1::getDeviceType() const {
 
 uint16_t TcgDeviceOpal1::getBaseComId() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcOpalSscV100);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v100_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcOpalSscV100);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v100_t *)descriptor;
   return SWAP16(feature->base_com_id);
 }
 
 uint16_t TcgDeviceOpal1::getNumComIds() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcOpalSscV100);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v100_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcOpalSscV100);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v100_t *)descriptor;
   return SWAP16(feature->number_com_ids);
 }
 
@@ -29,16 +29,16 @@ TcgDeviceType TcgDeviceOpal2::getDeviceType() const {
 
 uint16_t TcgDeviceOpal2::getBaseComId() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcOpalSscV200);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v200_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcOpalSscV200);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v200_t *)descriptor;
   return SWAP16(feature->base_com_id);
 }
 uint16_t TcgDeviceOpal2::getNumComIds() const {
   const DriveInfo& drive_info = drive_handle_->getDriveInfo();
-  auto feat_it = drive_info.tcg_raw_features.find(kFcOpalSscV200);
-  assert(feat_it != drive_info.tcg_raw_features.cend());
-  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v200_t *)feat_it->second.data();
+  const unsigned char *descriptor = drive_info.tcg_features.find(kFcOpalSscV200);
+  assert(descriptor);
+  const auto *feature = (const tcg::discovery0_opal_ssc_feature_v200_t *)descriptor;
   return SWAP16(feature->num_com_ids);
 }
 
@@ -0,0 +1,167 @@
+/**
+ * @file	trace_ring.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <jcu-dparm/trace_ring.h>
+#include <jcu-dparm/ata_types.h>
+
+namespace jcu {
+namespace dparm {
+
+static_assert(sizeof(TraceRecord) == 64, "TraceRecord size");
+static_assert(sizeof(TraceNvmeCmd) <= sizeof(TraceRecord::payload), "TraceNvmeCmd size");
+static_assert(sizeof(ata::ata_tf_t) <= sizeof(TraceRecord::payload), "ata_tf_t size");
+
+TraceRing::TraceRing(size_t capacity)
+    : mask_(0), head_(0)
+{
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  slots_.reset(new Slot[size]);
+  for (size_t i = 0; i < size; i++) {
+    slots_[i].sequence.store(0, std::memory_order_relaxed);
+  }
+  mask_ = size - 1;
+}
+
+void TraceRing::record(TraceRecordType type, uint64_t timestamp_ns, uint32_t duration_us, int32_t result, const void *payload, size_t length) {
+  uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index & mask_];
+
+  slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (length > sizeof(slot.record.payload)) {
+    length = sizeof(slot.record.payload);
+  }
+  slot.record.index = index;
+  slot.record.timestamp_ns = timestamp_ns;
+  slot.record.duration_us = duration_us;
+  slot.record.result = result;
+  slot.record.type = (uint16_t) type;
+  slot.record.length = (uint16_t) length;
+  if (length) {
+    memcpy(slot.record.payload, payload, length);
+  }
+
+  slot.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+void TraceRing::snapshot(std::vector<TraceRecord> &records) const {
+  uint64_t head = head_.load(std::memory_order_acquire);
+  uint64_t begin = (head > capacity()) ? (head - capacity()) : 0;
+
+  records.reserve(records.size() + (size_t) (head - begin));
+  for (uint64_t index = begin; index < head; index++) {
+    const Slot& slot = slots_[index & mask_];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != index * 2 + 2) {
+      continue;
+    }
+    TraceRecord record;
+    memcpy(&record, &slot.record, sizeof(record));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    records.push_back(record);
+  }
+}
+
+uint64_t TraceRing::now() {
+  return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void append_format(std::string& text, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append_format(std::string& text, const char *fmt, ...) {
+  char buffer[256];
+  va_list args;
+  va_start(args, fmt);
+  int length = vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+  if (length > 0) {
+    text.append(buffer, ((size_t) length < sizeof(buffer)) ? length : (sizeof(buffer) - 1));
+  }
+}
+
+static void append_hex(std::string& text, const uint8_t *data, size_t length) {
+  static const char kHex[] = "0123456789abcdef";
+  for (size_t i = 0; i < length; i++) {
+    text.push_back(' ');
+    text.push_back(kHex[data[i] >> 4]);
+    text.push_back(kHex[data[i] & 0x0f]);
+  }
+}
+
+void decodeTraceRecords(const TraceRecord *records, size_t count, std::string &text) {
+  for (size_t i = 0; i < count; i++) {
+    const TraceRecord& record = records[i];
+    size_t length = (record.length < sizeof(record.payload)) ? record.length : sizeof(record.payload);
+
+    append_format(text, "[%llu.%06llu] #%llu ",
+                  (unsigned long long) (record.timestamp_ns / 1000000000ULL),
+                  (unsigned long long) ((record.timestamp_ns / 1000ULL) % 1000000ULL),
+                  (unsigned long long) record.index);
+
+    switch (record.type) {
+      case kTraceSgCdb:
+        append_format(text, "sg cdb pack_id=%d:", record.result);
+        append_hex(text, record.payload, length);
+        break;
+      case kTraceSgResult:
+        if (length < 4) {
+          text.append("sg result (truncated)");
+          break;
+        }
+        append_format(text, "sg result ioctl=%d %uus status=0x%02x host=0x%02x driver=0x%02x sense:",
+                      record.result, record.duration_us,
+                      record.payload[0], record.payload[1], record.payload[2]);
+        append_hex(text, record.payload + 4, (record.payload[3] < length - 4) ? record.payload[3] : (length - 4));
+        break;
+      case kTraceTaskfile: {
+        ata::ata_tf_t tf = {0};
+        memcpy(&tf, record.payload, (length < sizeof(tf)) ? length : sizeof(tf));
+        append_format(text, "tf rc=%d command=0x%02x status=0x%02x error=0x%02x dev=0x%02x"
+                            " nsect=%02x%02x lba=%02x%02x%02x%02x%02x%02x",
+                      record.result, tf.command, tf.status, tf.error, tf.dev,
+                      tf.hob.nsect, tf.lob.nsect,
+                      tf.hob.lbah, tf.hob.lbam, tf.hob.lbal, tf.lob.lbah, tf.lob.lbam, tf.lob.lbal);
+        break;
+      }
+      case kTraceNvmeAdmin:
+      case kTraceNvmeIo: {
+        TraceNvmeCmd cmd = {0};
+        memcpy(&cmd, record.payload, (length < sizeof(cmd)) ? length : sizeof(cmd));
+        append_format(text, "nvme %s opcode=0x%02x nsid=%u cdw10-15=%08x %08x %08x %08x %08x %08x result=%d %uus",
+                      (record.type == kTraceNvmeAdmin) ? "admin" : "io",
+                      cmd.opcode, cmd.nsid,
+                      cmd.cdw10[0], cmd.cdw10[1], cmd.cdw10[2], cmd.cdw10[3], cmd.cdw10[4], cmd.cdw10[5],
+                      record.result, record.duration_us);
+        break;
+      }
+      default:
+        append_format(text, "type=%u result=%d %uus:", record.type, record.result, record.duration_us);
+        append_hex(text, record.payload, length);
+        break;
+    }
+    text.push_back('\n');
+  }
+}
+
+} // namespace dparm
+} // namespace jcu
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "drive_filter.h"
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+class FakeAtaDriverHandle : public DriveDriverHandle {
+ public:
+  int security_commands;
+
+  FakeAtaDriverHandle() : security_commands(0) {
+    driving_type_ = kDrivingAtapi;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  DparmResult doSecurityCommand(uint8_t protocol, uint16_t com_id, int rw, void *buffer, uint32_t len, int timeout) override {
+    security_commands++;
+    return { DPARME_OK, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeAtaDriverHandle driver_handle;
+
+  FakeDriveHandle()
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()) {
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeAtaDriverHandle *>(&driver_handle);
+  }
+
+  bool init(const EnumDrivesFilter &filter) {
+    return afterOpen(&filter);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+DriveInfo makeInfo(DrivingType driving_type, const std::string &model, int64_t total_capacity) {
+  DriveInfo info;
+  info.driving_type = driving_type;
+  info.model = model;
+  info.total_capacity = total_capacity;
+  return info;
+}
+
+TEST(DriveFilterTest, empty_filter_matches_every_stage) {
+  EnumDrivesFilter filter;
+  EXPECT_FALSE(filter.needsTcgStage());
+  const DriveInfo infos[] = {
+      makeInfo(kDrivingUnknown, "", -1),
+      makeInfo(kDrivingNvme, "NVME MODEL", 1000),
+      makeInfo(kDrivingAtapi, "ATA MODEL", 0),
+  };
+  for (size_t i = 0; i < sizeof(infos) / sizeof(infos[0]); i++) {
+    EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, infos[i])) << i;
+    EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, infos[i])) << i;
+    EXPECT_TRUE(matchDriveFilter(filter, kFilterStageTcg, infos[i])) << i;
+  }
+}
+
+TEST(DriveFilterTest, sysfs_stage_rejects_known_values_only) {
+  EnumDrivesFilter filter;
+  filter.driving_type = kDrivingNvme;
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingNvme, "", 100)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 100)));
+  // e.g. SAS, known after IDENTIFY
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingUnknown, "", 100)));
+
+  filter = EnumDrivesFilter();
+  filter.model_contains = "SAMSUNG";
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingNvme, "INTEL SSD", 100)));
+  // the libata model may be truncated
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "INTEL SSD", 100)));
+
+  filter = EnumDrivesFilter();
+  filter.exclude_removable = true;
+  DriveInfo removable = makeInfo(kDrivingAtapi, "", 100);
+  removable.is_removable = true;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, removable));
+
+  filter = EnumDrivesFilter();
+  filter.min_capacity = 100;
+  filter.max_capacity = 200;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 99)));
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 100)));
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 200)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 201)));
+  // unknown capacity
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", -1)));
+
+  int calls = 0;
+  filter = EnumDrivesFilter();
+  filter.sysfs_predicate = [&calls](const DriveInfo &info) -> bool {
+    calls++;
+    return info.driving_type == kDrivingNvme;
+  };
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingNvme, "", 100)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "", 100)));
+  EXPECT_EQ(calls, 2);
+  // other stages do not call it
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "", 100)));
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageTcg, makeInfo(kDrivingAtapi, "", 100)));
+  EXPECT_EQ(calls, 2);
+}
+
+TEST(DriveFilterTest, identify_stage) {
+  EnumDrivesFilter filter;
+  filter.driving_type = kDrivingAtapi;
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "", 100)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingUnknown, "", 100)));
+
+  filter = EnumDrivesFilter();
+  filter.model_contains = "SAMSUNG";
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "SAMSUNG SSD 870", 100)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "INTEL SSD", 100)));
+  // may be filled by INQUIRY
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "", 100)));
+
+  filter = EnumDrivesFilter();
+  filter.max_capacity = 100;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "", 101)));
+
+  filter = EnumDrivesFilter();
+  filter.identify_predicate = [](const DriveInfo &info) -> bool {
+    return info.model == "A";
+  };
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "A", 100)));
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageIdentify, makeInfo(kDrivingAtapi, "B", 100)));
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageSysfs, makeInfo(kDrivingAtapi, "B", 100)));
+}
+
+TEST(DriveFilterTest, tcg_stage) {
+  EnumDrivesFilter filter;
+  filter.tcg_only = true;
+  EXPECT_TRUE(filter.needsTcgStage());
+  DriveInfo info = makeInfo(kDrivingAtapi, "", 100);
+  info.tcg_support = 1;
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageTcg, info));
+  info.tcg_support = 0;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageTcg, info));
+  info.tcg_support = -1;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageTcg, info));
+  // not known before Discovery 0
+  EXPECT_TRUE(matchDriveFilter(filter, kFilterStageIdentify, info));
+
+  // the model is final after INQUIRY
+  filter = EnumDrivesFilter();
+  filter.model_contains = "SAMSUNG";
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageTcg, makeInfo(kDrivingAtapi, "", 100)));
+
+  filter = EnumDrivesFilter();
+  filter.tcg_predicate = [](const DriveInfo &info) -> bool {
+    return info.tcg_support == 1;
+  };
+  EXPECT_TRUE(filter.needsTcgStage());
+  info.tcg_support = 0;
+  EXPECT_FALSE(matchDriveFilter(filter, kFilterStageTcg, info));
+}
+
+TEST(DriveFilterTest, failed_identify_stage_skips_discovery) {
+  bool tcg_called = false;
+  EnumDrivesFilter filter;
+  filter.identify_predicate = [](const DriveInfo &info) -> bool {
+    return false;
+  };
+  filter.tcg_predicate = [&tcg_called](const DriveInfo &info) -> bool {
+    tcg_called = true;
+    return true;
+  };
+  FakeDriveHandle handle;
+  EXPECT_FALSE(handle.init(filter));
+  EXPECT_EQ(handle.driver_handle.security_commands, 0);
+  EXPECT_FALSE(tcg_called);
+}
+
+TEST(DriveFilterTest, passed_identify_stage_runs_discovery) {
+  bool tcg_called = false;
+  EnumDrivesFilter filter;
+  filter.tcg_predicate = [&tcg_called](const DriveInfo &info) -> bool {
+    tcg_called = true;
+    return false;
+  };
+  FakeDriveHandle handle;
+  EXPECT_FALSE(handle.init(filter));
+  EXPECT_EQ(handle.driver_handle.security_commands, 1);
+  EXPECT_TRUE(tcg_called);
+}
+
+} // namespace
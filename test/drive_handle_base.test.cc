@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+class FakeAtaDriverHandle : public DriveDriverHandle {
+ public:
+  bool read_zeroing;
+  // read zeroing seen by each data command
+  std::vector<bool> zeroing_log;
+  std::vector<int> security_timeouts;
+
+  FakeAtaDriverHandle() : read_zeroing(true) {
+    driving_type_ = kDrivingAtapi;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  void setReadZeroing(bool enabled) override {
+    read_zeroing = enabled;
+  }
+
+  bool driverIsTaskfileCmdSupported() const override {
+    return true;
+  }
+
+  DparmResult doTaskfileCmd(int rw, int dma, ata::ata_tf_t *tf, void *data, unsigned int data_bytes, unsigned int timeout_secs) override {
+    zeroing_log.push_back(read_zeroing);
+    return { DPARME_OK, 0 };
+  }
+
+  DparmResult doSecurityCommand(uint8_t protocol, uint16_t com_id, int rw, void *buffer, uint32_t len, int timeout) override {
+    zeroing_log.push_back(read_zeroing);
+    security_timeouts.push_back(timeout);
+    return { DPARME_OK, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeAtaDriverHandle driver_handle;
+
+  explicit FakeDriveHandle(const DriveFactoryOptions &options = DriveFactoryOptions())
+      : DriveHandleBase(options, "/dev/fake", DparmResult()) {
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeAtaDriverHandle *>(&driver_handle);
+  }
+
+  bool init() {
+    return afterOpen(nullptr);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+/**
+ * fails Get Log Page transfers larger than max_transfer_bytes with the given result
+ */
+class FakeNvmeDriverHandle : public DriveDriverHandle {
+ public:
+  uint32_t max_transfer_bytes;
+  DparmReturn<int> reject;
+  std::vector<uint32_t> transfer_lengths;
+
+  FakeNvmeDriverHandle() : max_transfer_bytes(4096) {
+    driving_type_ = kDrivingNvme;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  bool driverIsNvmeAdminPassthruSupported() const override {
+    return true;
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru(nvme::nvme_admin_cmd_t *cmd) override {
+    transfer_lengths.push_back(cmd->data_len);
+    if (cmd->data_len > max_transfer_bytes) {
+      return reject;
+    }
+    uint64_t offset = cmd->cdw12 | ((uint64_t) cmd->cdw13 << 32);
+    unsigned char *data = (unsigned char *) cmd->addr;
+    for (uint32_t i = 0; i < cmd->data_len; i++) {
+      data[i] = (unsigned char) ((offset + i) >> 2);
+    }
+    return { DPARME_OK, 0, 0, 0 };
+  }
+};
+
+class FakeNvmeDriveHandle : public DriveHandleBase {
+ public:
+  FakeNvmeDriverHandle driver_handle;
+
+  explicit FakeNvmeDriveHandle(uint32_t log_chunk_bytes)
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()) {
+    nvme_log_chunk_bytes_ = log_chunk_bytes;
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeNvmeDriverHandle *>(&driver_handle);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+bool isLogData(const std::vector<unsigned char> &log) {
+  for (size_t i = 0; i < log.size(); i++) {
+    if (log[i] != (unsigned char) (i >> 2)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(DriveHandleBaseTest, internal_reads_clear_buffers) {
+  FakeDriveHandle handle;
+  handle.setReadZeroing(false);
+  EXPECT_FALSE(handle.driver_handle.read_zeroing);
+
+  unsigned char buffer[512];
+  handle.doSecurityCommand(0, 0, 0x01, 0x0001, buffer, sizeof(buffer));
+  handle.readAtaSmartStatus();
+  handle.readDcoIdentify();
+  ASSERT_EQ(handle.driver_handle.zeroing_log.size(), 4);
+  for (auto it = handle.driver_handle.zeroing_log.cbegin(); it != handle.driver_handle.zeroing_log.cend(); it++) {
+    EXPECT_TRUE(*it);
+  }
+  // the setting of the caller is restored
+  EXPECT_FALSE(handle.driver_handle.read_zeroing);
+
+  // caller's own passthrough keeps the setting
+  ata::ata_tf_t tf = {0};
+  handle.doTaskfileCmd(0, 0, &tf, buffer, sizeof(buffer), 5);
+  EXPECT_FALSE(handle.driver_handle.zeroing_log.back());
+}
+
+TEST(DriveHandleBaseTest, security_timeout_from_retry_policy) {
+  unsigned char buffer[512];
+  FakeDriveHandle builtin;
+  builtin.doSecurityCommand(0, 0, 0x01, 0x0001, buffer, sizeof(buffer));
+  ASSERT_EQ(builtin.driver_handle.security_timeouts.size(), 1);
+  EXPECT_EQ(builtin.driver_handle.security_timeouts[0], 5);
+
+  DriveFactoryOptions options;
+  options.retry_policy.timeout_secs[kTimeoutSecurity] = 42;
+  FakeDriveHandle configured(options);
+  configured.doSecurityCommand(0, 0, 0x01, 0x0001, buffer, sizeof(buffer));
+  ASSERT_EQ(configured.driver_handle.security_timeouts.size(), 1);
+  EXPECT_EQ(configured.driver_handle.security_timeouts[0], 42);
+}
+
+TEST(DriveHandleBaseTest, tcg_support_is_unknown_while_discovery_is_pending) {
+  DriveFactoryOptions options;
+  options.lazy_tcg_discovery = true;
+  FakeDriveHandle handle(options);
+  handle.init();
+  EXPECT_TRUE(handle.isTcgDiscoveryPending());
+  EXPECT_EQ(handle.getDriveInfo().tcg_support, -1);
+  EXPECT_TRUE(handle.driver_handle.security_timeouts.empty());
+
+  EXPECT_TRUE(handle.runPendingTcgDiscovery().isOk());
+  EXPECT_FALSE(handle.isTcgDiscoveryPending());
+  EXPECT_EQ(handle.getDriveInfo().tcg_support, 1);
+  EXPECT_EQ(handle.driver_handle.security_timeouts.size(), 1);
+}
+
+TEST(DriveHandleBaseTest, log_page_host_limit_falls_back_for_the_drive) {
+  FakeNvmeDriveHandle handle(65536);
+  handle.driver_handle.reject = { DPARME_IOCTL_FAILED, EINVAL };
+
+  std::vector<unsigned char> log(20000);
+  ASSERT_TRUE(handle.doNvmeGetLogPage(0xFFFFFFFFU, 0x0D, false, log.size(), log.data()).isOk());
+  EXPECT_TRUE(isLogData(log));
+  EXPECT_EQ(handle.driver_handle.transfer_lengths.size(), 6);
+  EXPECT_EQ(handle.getNvmeLogChunkBytes(), 4096);
+}
+
+TEST(DriveHandleBaseTest, log_page_invalid_field_falls_back_once) {
+  FakeNvmeDriveHandle handle(65536);
+  handle.driver_handle.reject = { DPARME_NVME_FAILED, 0, 0x4000 | nvme::NVME_SC_INVALID_FIELD };
+
+  std::vector<unsigned char> log(20000);
+  ASSERT_TRUE(handle.doNvmeGetLogPage(0xFFFFFFFFU, 0x0D, false, log.size(), log.data()).isOk());
+  EXPECT_TRUE(isLogData(log));
+  // the limit may be of this log page only
+  EXPECT_EQ(handle.getNvmeLogChunkBytes(), 65536);
+}
+
+TEST(DriveHandleBaseTest, log_page_other_errors_do_not_fall_back) {
+  FakeNvmeDriveHandle handle(65536);
+  handle.driver_handle.reject = { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INTERNAL };
+
+  std::vector<unsigned char> log(20000);
+  DparmResult res = handle.doNvmeGetLogPage(0xFFFFFFFFU, 0x0D, false, log.size(), log.data());
+  EXPECT_EQ(res.code, DPARME_NVME_FAILED);
+  EXPECT_EQ(handle.driver_handle.transfer_lengths.size(), 1);
+  EXPECT_EQ(handle.getNvmeLogChunkBytes(), 65536);
+
+  handle.driver_handle.transfer_lengths.clear();
+  handle.driver_handle.reject = { DPARME_IOCTL_FAILED, EIO };
+  res = handle.doNvmeGetLogPage(0xFFFFFFFFU, 0x0D, false, log.size(), log.data());
+  EXPECT_EQ(res.code, DPARME_IOCTL_FAILED);
+  EXPECT_EQ(handle.driver_handle.transfer_lengths.size(), 1);
+}
+
+} // namespace
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+/**
+ * controller with the namespaces of `sizes` (nsid : nsze), and a Changed Namespace List log
+ * which is cleared by reading it
+ */
+class FakeNvmeDriverHandle : public DriveDriverHandle {
+ public:
+  std::map<uint32_t, uint64_t> sizes;
+  std::vector<uint32_t> changed_log;
+  // the Changed Namespace List log is not supported
+  bool fail_changed_log;
+  // start nsid of each Identify Active Namespace ID list
+  std::vector<uint32_t> list_starts;
+  std::vector<uint32_t> identified;
+
+  FakeNvmeDriverHandle() : fail_changed_log(false) {
+    driving_type_ = kDrivingNvme;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  bool driverIsNvmeAdminPassthruSupported() const override {
+    return true;
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru(nvme::nvme_admin_cmd_t *cmd) override {
+    memset(cmd->addr, 0, cmd->data_len);
+    if (cmd->opcode == nvme::NVME_ADMIN_OP_GET_LOG_PAGE) {
+      if ((cmd->cdw10 & 0xff) != nvme::NVME_GET_LOG_PAGE_CHANGED_NS_LIST || fail_changed_log) {
+        return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INVALID_FIELD, 0 };
+      }
+      memcpy(cmd->addr, changed_log.data(), std::min<size_t>(changed_log.size() * 4, cmd->data_len));
+      changed_log.clear();
+      return { DPARME_OK, 0, 0, 0 };
+    }
+    if (cmd->opcode != nvme::NVME_ADMIN_OP_IDENTIFY) {
+      return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INVALID_OPCODE, 0 };
+    }
+
+    if (cmd->cdw10 == nvme::NVME_IDENTIFY_CNS_NS_ACTIVE_LIST) {
+      list_starts.push_back(cmd->nsid);
+      uint32_t *list = (uint32_t *) cmd->addr;
+      size_t count = 0;
+      for (auto it = sizes.upper_bound(cmd->nsid); it != sizes.end() && count < cmd->data_len / 4; it++) {
+        list[count++] = it->first;
+      }
+      return { DPARME_OK, 0, 0, 0 };
+    }
+    if (cmd->cdw10 == nvme::NVME_IDENTIFY_CNS_NS) {
+      auto it = sizes.find(cmd->nsid);
+      if (it == sizes.end()) {
+        return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INVALID_NS, 0 };
+      }
+      identified.push_back(cmd->nsid);
+      nvme::nvme_identify_namespace_t *identify = (nvme::nvme_identify_namespace_t *) cmd->addr;
+      identify->nsze = it->second;
+      identify->ncap = it->second;
+      identify->lbaf[0].lbads = 12;
+      return { DPARME_OK, 0, 0, 0 };
+    }
+    return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INVALID_FIELD, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeNvmeDriverHandle driver_handle;
+
+  FakeDriveHandle()
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()) {
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeNvmeDriverHandle *>(&driver_handle);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+std::vector<uint32_t> nsidsOf(const std::vector<NvmeNamespaceInfo> &namespaces) {
+  std::vector<uint32_t> nsids;
+  for (auto it = namespaces.cbegin(); it != namespaces.cend(); it++) {
+    nsids.push_back(it->nsid);
+  }
+  return nsids;
+}
+
+TEST(DriveHandleNvmeNamespaceTest, active_list_is_paged) {
+  FakeDriveHandle handle;
+  for (uint32_t nsid = 1; nsid <= 2500; nsid++) {
+    handle.driver_handle.sizes[nsid] = nsid;
+  }
+
+  std::vector<uint32_t> nsids;
+  ASSERT_TRUE(handle.readNvmeActiveNamespaces(nsids).isOk());
+  ASSERT_EQ(nsids.size(), 2500);
+  EXPECT_EQ(nsids.front(), 1);
+  EXPECT_EQ(nsids.back(), 2500);
+  // the next list starts after the last entry of a full one
+  EXPECT_EQ(handle.driver_handle.list_starts, std::vector<uint32_t>({ 0, 1024, 2048 }));
+}
+
+TEST(DriveHandleNvmeNamespaceTest, active_list_ends_at_last_nsid) {
+  FakeDriveHandle handle;
+  for (uint32_t nsid = 1; nsid <= 1023; nsid++) {
+    handle.driver_handle.sizes[nsid] = nsid;
+  }
+  // a full list ending with the largest valid nsid is the last one
+  handle.driver_handle.sizes[0xFFFFFFFEU] = 1;
+
+  std::vector<uint32_t> nsids;
+  ASSERT_TRUE(handle.readNvmeActiveNamespaces(nsids).isOk());
+  EXPECT_EQ(nsids.size(), 1024);
+  EXPECT_EQ(handle.driver_handle.list_starts.size(), 1);
+
+  // a full list is followed by an empty one
+  handle.driver_handle.sizes.erase(0xFFFFFFFEU);
+  handle.driver_handle.sizes[1024] = 1024;
+  handle.driver_handle.list_starts.clear();
+  ASSERT_TRUE(handle.readNvmeActiveNamespaces(nsids).isOk());
+  EXPECT_EQ(nsids.size(), 1024);
+  EXPECT_EQ(handle.driver_handle.list_starts, std::vector<uint32_t>({ 0, 1024 }));
+}
+
+TEST(DriveHandleNvmeNamespaceTest, refresh_merges_the_cache) {
+  FakeDriveHandle handle;
+  FakeNvmeDriverHandle &drive = handle.driver_handle;
+  drive.sizes[1] = 100;
+  drive.sizes[2] = 200;
+  drive.sizes[3] = 300;
+
+  DparmReturn<std::vector<NvmeNamespaceInfo>> namespaces = handle.getNvmeNamespaces();
+  ASSERT_TRUE(namespaces.isOk());
+  EXPECT_EQ(nsidsOf(namespaces.value), std::vector<uint32_t>({ 1, 2, 3 }));
+  EXPECT_EQ(namespaces.value[1].size_lbas, 200);
+  EXPECT_EQ(namespaces.value[1].lba_bytes, 4096);
+  EXPECT_EQ(drive.identified.size(), 3);
+
+  // cached
+  drive.identified.clear();
+  ASSERT_TRUE(handle.getNvmeNamespaces().isOk());
+  EXPECT_TRUE(drive.identified.empty());
+
+  // 2 deleted, 4 created, 3 resized and listed in the log
+  drive.sizes.erase(2);
+  drive.sizes[4] = 400;
+  drive.sizes[3] = 310;
+  drive.changed_log = { 3 };
+  ASSERT_TRUE(handle.refreshNvmeNamespaces(0).isOk());
+  EXPECT_EQ(drive.identified, std::vector<uint32_t>({ 3, 4 }));
+  namespaces = handle.getNvmeNamespaces();
+  EXPECT_EQ(nsidsOf(namespaces.value), std::vector<uint32_t>({ 1, 3, 4 }));
+  EXPECT_EQ(namespaces.value[0].size_lbas, 100);
+  EXPECT_EQ(namespaces.value[1].size_lbas, 310);
+
+  // the nsid of the event, when the log was consumed by someone else
+  drive.sizes[1] = 110;
+  drive.identified.clear();
+  ASSERT_TRUE(handle.refreshNvmeNamespaces(1).isOk());
+  EXPECT_EQ(drive.identified, std::vector<uint32_t>({ 1 }));
+  EXPECT_EQ(handle.getNvmeNamespaces().value[0].size_lbas, 110);
+}
+
+TEST(DriveHandleNvmeNamespaceTest, refresh_reads_all) {
+  FakeDriveHandle handle;
+  FakeNvmeDriverHandle &drive = handle.driver_handle;
+  drive.sizes[1] = 100;
+  drive.sizes[2] = 200;
+  ASSERT_TRUE(handle.getNvmeNamespaces().isOk());
+
+  drive.identified.clear();
+  ASSERT_TRUE(handle.refreshNvmeNamespaces(0xFFFFFFFFU).isOk());
+  EXPECT_EQ(drive.identified, std::vector<uint32_t>({ 1, 2 }));
+
+  // more than 1024 changed namespaces
+  drive.identified.clear();
+  drive.changed_log = { 0xFFFFFFFFU };
+  ASSERT_TRUE(handle.refreshNvmeNamespaces(0).isOk());
+  EXPECT_EQ(drive.identified, std::vector<uint32_t>({ 1, 2 }));
+
+  // the log can not tell which ones changed
+  drive.identified.clear();
+  drive.fail_changed_log = true;
+  drive.sizes[1] = 110;
+  ASSERT_TRUE(handle.refreshNvmeNamespaces(2).isOk());
+  EXPECT_EQ(drive.identified, std::vector<uint32_t>({ 1, 2 }));
+  EXPECT_EQ(handle.getNvmeNamespaces().value[0].size_lbas, 110);
+}
+
+} // namespace
@@ -0,0 +1,272 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <jcu-dparm/drive_factory.h>
+#include <jcu-dparm/drive_handle.h>
+#include <jcu-dparm/drive_inventory.h>
+#include <jcu-dparm/async_command_queue.h>
+
+#ifndef _WIN32
+#include "plat-linux/uevent_source.h"
+#endif
+
+using namespace jcu::dparm;
+
+namespace {
+
+class FakeDriveFactory : public DriveFactory {
+ public:
+  std::set<std::string> present;
+  mutable int probe_count;
+
+  FakeDriveFactory() : probe_count(0) {}
+
+  std::unique_ptr<DriveHandle> open(const char *drive_path) const override {
+    return nullptr;
+  }
+
+  std::shared_ptr<DriveHandle> openShared(const char *drive_path) const override {
+    return nullptr;
+  }
+
+  void invalidateShared(const char *drive_path) const override {
+  }
+
+  int enumDrives(std::list<DriveInfo> &result_list) const override {
+    return enumDrives(result_list, EnumDrivesOptions());
+  }
+
+  int enumDrives(std::list<DriveInfo> &result_list, const EnumDrivesOptions &options) const override {
+    for (auto it = present.cbegin(); it != present.cend(); it++) {
+      DriveInfo drive_info;
+      probeDrive(it->c_str(), drive_info, options);
+      result_list.emplace_back(std::move(drive_info));
+    }
+    return 0;
+  }
+
+  int enumDrives(const EnumDrivesCallback &callback, const EnumDrivesOptions &options) const override {
+    return ENOTSUP;
+  }
+
+  int probeDrive(const char *drive_path, DriveInfo &drive_info, const EnumDrivesOptions &options) const override {
+    probe_count++;
+    if (present.find(drive_path) == present.end()) {
+      return ENOENT;
+    }
+    drive_info.device_path = drive_path;
+    drive_info.serial = std::string("SN-") + drive_path;
+    return 0;
+  }
+
+  std::unique_ptr<DeviceEventSource> createDeviceEventSource() const override {
+    return nullptr;
+  }
+
+  std::unique_ptr<AsyncCommandQueue> createAsyncCommandQueue() const override {
+    return nullptr;
+  }
+
+  std::unique_ptr<EnumVolumesContext> enumVolumes() const override {
+    return nullptr;
+  }
+};
+
+class FakeEventSource : public DeviceEventSource {
+ public:
+  std::deque<DeviceEvent> *queue;
+
+  FakeEventSource(std::deque<DeviceEvent> *q) : queue(q) {}
+
+  int readEvent(DeviceEvent &event, int timeout_ms) override {
+    if (queue->empty()) {
+      return ETIMEDOUT;
+    }
+    event = queue->front();
+    queue->pop_front();
+    return 0;
+  }
+};
+
+DeviceEvent makeEvent(DeviceEventAction action, const std::string &dev_name) {
+  DeviceEvent event;
+  event.action = action;
+  event.dev_name = dev_name;
+  event.device_path = "/dev/" + dev_name;
+  return event;
+}
+
+TEST(DriveInventoryTest, IncrementalUpdate) {
+  FakeDriveFactory factory;
+  std::deque<DeviceEvent> queue;
+  std::vector<std::pair<DriveChangeType, std::string>> changes;
+
+  factory.present.insert("/dev/sda");
+  factory.present.insert("/dev/sdb");
+
+  DriveInventory inventory(&factory, std::unique_ptr<DeviceEventSource>(new FakeEventSource(&queue)), EnumDrivesOptions());
+  inventory.setChangeCallback([&changes](DriveChangeType change, const DriveInfo &drive_info) -> void {
+    changes.emplace_back(change, drive_info.device_path);
+  });
+
+  ASSERT_EQ(inventory.refresh(), 0);
+  EXPECT_EQ(inventory.getDrives().size(), 2);
+  EXPECT_EQ(changes.size(), 2);
+  EXPECT_EQ(inventory.processEvents(0), ETIMEDOUT);
+
+  changes.clear();
+  factory.probe_count = 0;
+  factory.present.insert("/dev/sdc");
+  factory.present.erase("/dev/sda");
+  queue.push_back(makeEvent(kDeviceAdd, "sdc"));
+  queue.push_back(makeEvent(kDeviceRemove, "sda"));
+  ASSERT_EQ(inventory.processEvents(0), 0);
+
+  // only the added drive is probed
+  EXPECT_EQ(factory.probe_count, 1);
+  ASSERT_EQ(changes.size(), 2);
+  EXPECT_EQ(changes[0].first, kDriveAdded);
+  EXPECT_EQ(changes[0].second, "/dev/sdc");
+  EXPECT_EQ(changes[1].first, kDriveRemoved);
+  EXPECT_EQ(changes[1].second, "/dev/sda");
+
+  DriveInfo drive_info;
+  EXPECT_FALSE(inventory.findDrive("/dev/sda", &drive_info));
+  ASSERT_TRUE(inventory.findDrive("/dev/sdc", &drive_info));
+  EXPECT_EQ(drive_info.serial, "SN-/dev/sdc");
+  EXPECT_EQ(inventory.getDrives().size(), 2);
+
+  changes.clear();
+  queue.push_back(makeEvent(kDeviceAdd, "sdb"));
+  queue.push_back(makeEvent(kDeviceRemove, "sdz"));
+  ASSERT_EQ(inventory.processEvents(0), 0);
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].first, kDriveChanged);
+
+  // a known drive which fails to probe again is removed
+  changes.clear();
+  factory.present.erase("/dev/sdb");
+  queue.push_back(makeEvent(kDeviceAdd, "sdb"));
+  queue.push_back(makeEvent(kDeviceChange, "sdy"));
+  ASSERT_EQ(inventory.processEvents(0), 0);
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].first, kDriveRemoved);
+  EXPECT_EQ(changes[0].second, "/dev/sdb");
+  EXPECT_FALSE(inventory.findDrive("/dev/sdb", nullptr));
+  EXPECT_EQ(inventory.getDrives().size(), 1);
+}
+
+TEST(DriveInventoryTest, ChangeOfKnownDriveIsIgnored) {
+  FakeDriveFactory factory;
+  std::deque<DeviceEvent> queue;
+  std::vector<std::pair<DriveChangeType, std::string>> changes;
+
+  factory.present.insert("/dev/nvme0n1");
+  DriveInventory inventory(&factory, std::unique_ptr<DeviceEventSource>(new FakeEventSource(&queue)), EnumDrivesOptions());
+  inventory.setChangeCallback([&changes](DriveChangeType change, const DriveInfo &drive_info) -> void {
+    changes.emplace_back(change, drive_info.device_path);
+  });
+  ASSERT_EQ(inventory.refresh(), 0);
+
+  // the change caused by the probe itself
+  changes.clear();
+  factory.probe_count = 0;
+  queue.push_back(makeEvent(kDeviceChange, "nvme0n1"));
+  queue.push_back(makeEvent(kDeviceChange, "nvme0n1"));
+  ASSERT_EQ(inventory.processEvents(0), 0);
+  EXPECT_EQ(factory.probe_count, 0);
+  EXPECT_TRUE(changes.empty());
+  EXPECT_TRUE(inventory.findDrive("/dev/nvme0n1", nullptr));
+
+  // a drive not known yet, e.g. media inserted in a reader, is probed
+  factory.present.insert("/dev/sdd");
+  queue.push_back(makeEvent(kDeviceChange, "sdd"));
+  ASSERT_EQ(inventory.processEvents(0), 0);
+  EXPECT_EQ(factory.probe_count, 1);
+  ASSERT_EQ(changes.size(), 1);
+  EXPECT_EQ(changes[0].first, kDriveAdded);
+  EXPECT_EQ(changes[0].second, "/dev/sdd");
+}
+
+TEST(DriveInventoryTest, NoEventSource) {
+  FakeDriveFactory factory;
+  DriveInventory inventory(&factory, nullptr, EnumDrivesOptions());
+  EXPECT_EQ(inventory.processEvents(0), ENOTSUP);
+}
+
+#ifndef _WIN32
+
+std::string makeUevent(const std::vector<std::string> &fields) {
+  std::string message;
+  for (auto it = fields.cbegin(); it != fields.cend(); it++) {
+    message.append(*it);
+    message.push_back('\0');
+  }
+  return message;
+}
+
+TEST(UeventParseTest, DiskAdd) {
+  std::string message = makeUevent({
+    "add@/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda",
+    "ACTION=add",
+    "DEVPATH=/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda",
+    "SUBSYSTEM=block",
+    "MAJOR=8",
+    "MINOR=0",
+    "DEVNAME=sda",
+    "DEVTYPE=disk",
+    "SEQNUM=4321",
+  });
+  DeviceEvent event;
+  ASSERT_TRUE(jcu::dparm::plat_linux::uevent_parse(message.data(), message.size(), &event));
+  EXPECT_EQ(event.action, kDeviceAdd);
+  EXPECT_EQ(event.dev_name, "sda");
+  EXPECT_EQ(event.device_path, "/dev/sda");
+}
+
+TEST(UeventParseTest, NvmeRemove) {
+  std::string message = makeUevent({
+    "remove@/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0/nvme0n1",
+    "ACTION=remove",
+    "SUBSYSTEM=block",
+    "DEVNAME=nvme0n1",
+    "DEVTYPE=disk",
+  });
+  DeviceEvent event;
+  ASSERT_TRUE(jcu::dparm::plat_linux::uevent_parse(message.data(), message.size(), &event));
+  EXPECT_EQ(event.action, kDeviceRemove);
+  EXPECT_EQ(event.device_path, "/dev/nvme0n1");
+}
+
+TEST(UeventParseTest, Ignored) {
+  DeviceEvent event;
+
+  std::string partition = makeUevent({"add@/block/sda/sda1", "ACTION=add", "SUBSYSTEM=block", "DEVNAME=sda1", "DEVTYPE=partition"});
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(partition.data(), partition.size(), &event));
+
+  std::string loop = makeUevent({"change@/devices/virtual/block/loop0", "ACTION=change", "SUBSYSTEM=block", "DEVNAME=loop0", "DEVTYPE=disk"});
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(loop.data(), loop.size(), &event));
+
+  std::string usb = makeUevent({"add@/devices/usb1/1-1", "ACTION=add", "SUBSYSTEM=usb", "DEVNAME=bus/usb/001/002", "DEVTYPE=usb_device"});
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(usb.data(), usb.size(), &event));
+
+  std::string bind = makeUevent({"bind@/block/sdb", "ACTION=bind", "SUBSYSTEM=block", "DEVNAME=sdb", "DEVTYPE=disk"});
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(bind.data(), bind.size(), &event));
+
+  std::string udev = makeUevent({"libudev", "ACTION=add", "SUBSYSTEM=block", "DEVNAME=sdb", "DEVTYPE=disk"});
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(udev.data(), udev.size(), &event));
+
+  std::string truncated("add@/block/sdb");
+  EXPECT_FALSE(jcu::dparm::plat_linux::uevent_parse(truncated.data(), truncated.size(), &event));
+}
+
+#endif
+
+} // namespace
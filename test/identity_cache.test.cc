@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "identity_cache.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+class IdentityCacheTest : public ::testing::Test {
+ protected:
+  std::string path_;
+
+  void SetUp() override {
+    path_ = ::testing::TempDir() + "jcu_dparm_identity_cache_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    ::remove(path_.c_str());
+  }
+
+  void TearDown() override {
+    ::remove(path_.c_str());
+    ::remove((path_ + ".tmp").c_str());
+  }
+
+  std::vector<unsigned char> readFile() const {
+    std::vector<unsigned char> data;
+    FILE *fp = fopen(path_.c_str(), "rb");
+    if (fp) {
+      unsigned char buffer[4096];
+      size_t length;
+      while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        data.insert(data.end(), buffer, buffer + length);
+      }
+      fclose(fp);
+    }
+    return data;
+  }
+
+  void writeFile(const std::vector<unsigned char> &data) const {
+    FILE *fp = fopen(path_.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    if (!data.empty()) {
+      ASSERT_EQ(fwrite(data.data(), 1, data.size(), fp), data.size());
+    }
+    fclose(fp);
+  }
+};
+
+IdentityCacheEntry makeEntry(uint64_t device_key, const std::string &serial) {
+  IdentityCacheEntry entry;
+  entry.device_key = device_key;
+  entry.os_identity = "wwid:" + serial + ";rev:1.0";
+  entry.driver_name = "nvme";
+  entry.nvme_identify.assign(4096, 0x5a);
+  entry.model = "MODEL";
+  entry.serial = serial;
+  entry.tcg_support = 1;
+  entry.tcg_features.assign(16, 0x01);
+  return entry;
+}
+
+TEST_F(IdentityCacheTest, round_trip) {
+  IdentityCache cache(path_);
+  ASSERT_EQ(cache.load(), 0);
+  cache.put(makeEntry(0x801, "A"));
+  cache.put(makeEntry(0x802, "B"));
+  ASSERT_EQ(cache.save(), 0);
+
+  IdentityCache loaded(path_);
+  ASSERT_EQ(loaded.load(), 0);
+  IdentityCacheEntry entry;
+  ASSERT_TRUE(loaded.find(0x802, "wwid:B;rev:1.0", &entry));
+  EXPECT_EQ(entry.device_key, 0x802);
+  EXPECT_EQ(entry.driver_name, "nvme");
+  EXPECT_EQ(entry.nvme_identify, std::vector<unsigned char>(4096, 0x5a));
+  EXPECT_EQ(entry.model, "MODEL");
+  EXPECT_EQ(entry.serial, "B");
+  EXPECT_EQ(entry.tcg_support, 1);
+  EXPECT_EQ(entry.tcg_features, std::vector<unsigned char>(16, 0x01));
+  EXPECT_TRUE(loaded.find(0x801, "wwid:A;rev:1.0", &entry));
+}
+
+TEST_F(IdentityCacheTest, changed_os_identity_misses) {
+  IdentityCache cache(path_);
+  cache.put(makeEntry(0x801, "A"));
+
+  IdentityCacheEntry entry;
+  // another drive under the same device number, or new firmware
+  EXPECT_FALSE(cache.find(0x801, "wwid:C;rev:1.0", &entry));
+  EXPECT_FALSE(cache.find(0x801, "wwid:A;rev:2.0", &entry));
+  EXPECT_FALSE(cache.find(0x802, "wwid:A;rev:1.0", &entry));
+}
+
+TEST_F(IdentityCacheTest, missing_file_is_empty) {
+  IdentityCache cache(path_);
+  EXPECT_EQ(cache.load(), 0);
+  IdentityCacheEntry entry;
+  EXPECT_FALSE(cache.find(0x801, "wwid:A;rev:1.0", &entry));
+
+  // nothing to write
+  EXPECT_EQ(cache.save(), 0);
+  EXPECT_TRUE(readFile().empty());
+}
+
+TEST_F(IdentityCacheTest, truncated_file_keeps_complete_entries) {
+  IdentityCache cache(path_);
+  cache.put(makeEntry(0x801, "A"));
+  cache.put(makeEntry(0x802, "B"));
+  ASSERT_EQ(cache.save(), 0);
+
+  std::vector<unsigned char> data = readFile();
+  data.resize(data.size() - 10);
+  writeFile(data);
+
+  IdentityCache loaded(path_);
+  ASSERT_EQ(loaded.load(), 0);
+  IdentityCacheEntry entry;
+  EXPECT_TRUE(loaded.find(0x801, "wwid:A;rev:1.0", &entry));
+  EXPECT_FALSE(loaded.find(0x802, "wwid:B;rev:1.0", &entry));
+}
+
+TEST_F(IdentityCacheTest, corrupt_length_drops_the_entry) {
+  IdentityCache cache(path_);
+  cache.put(makeEntry(0x801, "A"));
+  ASSERT_EQ(cache.save(), 0);
+
+  // the length of os_identity follows magic, version, count and device_key
+  std::vector<unsigned char> data = readFile();
+  ASSERT_GT(data.size(), 24);
+  uint32_t length = 0x7fffffff;
+  memcpy(&data[20], &length, sizeof(length));
+  writeFile(data);
+
+  IdentityCache loaded(path_);
+  ASSERT_EQ(loaded.load(), 0);
+  IdentityCacheEntry entry;
+  EXPECT_FALSE(loaded.find(0x801, "wwid:A;rev:1.0", &entry));
+}
+
+TEST_F(IdentityCacheTest, other_magic_or_version_is_ignored) {
+  IdentityCache cache(path_);
+  cache.put(makeEntry(0x801, "A"));
+  ASSERT_EQ(cache.save(), 0);
+  const std::vector<unsigned char> saved = readFile();
+
+  for (size_t offset = 0; offset < 8; offset += 4) {
+    std::vector<unsigned char> data = saved;
+    data[offset] ^= 0xff;
+    writeFile(data);
+
+    IdentityCache loaded(path_);
+    ASSERT_EQ(loaded.load(), 0);
+    IdentityCacheEntry entry;
+    EXPECT_FALSE(loaded.find(0x801, "wwid:A;rev:1.0", &entry)) << "offset " << offset;
+  }
+}
+
+TEST_F(IdentityCacheTest, remove_is_saved) {
+  IdentityCache cache(path_);
+  cache.put(makeEntry(0x801, "A"));
+  ASSERT_EQ(cache.save(), 0);
+  cache.remove(0x801);
+  ASSERT_EQ(cache.save(), 0);
+
+  IdentityCache loaded(path_);
+  ASSERT_EQ(loaded.load(), 0);
+  IdentityCacheEntry entry;
+  EXPECT_FALSE(loaded.find(0x801, "wwid:A;rev:1.0", &entry));
+}
+
+TEST_F(IdentityCacheTest, save_reports_the_error) {
+  IdentityCache cache(path_ + "_missing_dir/cache");
+  cache.put(makeEntry(0x801, "A"));
+  EXPECT_EQ(cache.save(), ENOENT);
+}
+
+} // namespace
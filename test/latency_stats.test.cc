@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include <jcu-dparm/latency_stats.h>
+
+using namespace jcu::dparm;
+
+namespace {
+
+TEST(LatencyHistogramTest, bucket_bounds_hold_value) {
+  const uint64_t values[] = {0, 1, 7, 8, 15, 16, 17, 100, 999, 1000, 123456, 2000000, LatencyHistogram::kMaxValue};
+  for (uint64_t value : values) {
+    size_t index = LatencyHistogram::bucketIndex(value);
+    ASSERT_LT(index, LatencyHistogram::kBucketCount);
+    EXPECT_LE(LatencyHistogram::bucketLowerBound(index), value) << value;
+    EXPECT_GE(LatencyHistogram::bucketUpperBound(index), value) << value;
+    // 8 sub-buckets per power of two
+    EXPECT_LE(LatencyHistogram::bucketUpperBound(index) - LatencyHistogram::bucketLowerBound(index), value / 8) << value;
+  }
+  EXPECT_EQ(LatencyHistogram::bucketIndex(LatencyHistogram::kMaxValue + 1000), LatencyHistogram::kBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, buckets_are_contiguous) {
+  for (size_t i = 1; i < LatencyHistogram::kBucketCount; i++) {
+    EXPECT_EQ(LatencyHistogram::bucketLowerBound(i), LatencyHistogram::bucketUpperBound(i - 1) + 1) << i;
+    EXPECT_EQ(LatencyHistogram::bucketIndex(LatencyHistogram::bucketLowerBound(i)), i);
+  }
+}
+
+TEST(LatencyStatsTest, only_recorded_opcodes_are_reported) {
+  LatencyStats stats;
+  std::vector<LatencyOpcodeStats> items;
+  stats.snapshot(items);
+  EXPECT_TRUE(items.empty());
+
+  stats.record(kLatencyNvmeAdmin, 0x02, 300, false);
+  stats.record(kLatencyAta, 0xb0, 2000000, true);
+  stats.record(kLatencyAta, 0xb0, 1000, false);
+
+  stats.snapshot(items);
+  ASSERT_EQ(items.size(), 2);
+  EXPECT_EQ(items[0].opcode_class, kLatencyAta);
+  EXPECT_EQ(items[0].opcode, 0xb0);
+  EXPECT_EQ(items[0].count, 2);
+  EXPECT_EQ(items[0].errors, 1);
+  EXPECT_EQ(items[0].max_us, 2000000);
+  EXPECT_EQ(items[0].meanUs(), 1000500);
+  EXPECT_EQ(items[1].opcode_class, kLatencyNvmeAdmin);
+  EXPECT_EQ(items[1].opcode, 0x02);
+  EXPECT_EQ(items[1].count, 1);
+  EXPECT_EQ(items[1].errors, 0);
+}
+
+TEST(LatencyStatsTest, percentiles) {
+  LatencyStats stats;
+  for (uint64_t i = 1; i <= 1000; i++) {
+    stats.record(kLatencyScsi, 0x12, i * 10, false);
+  }
+  std::vector<LatencyOpcodeStats> items;
+  stats.snapshot(items);
+  ASSERT_EQ(items.size(), 1);
+  const LatencyOpcodeStats& item = items[0];
+
+  uint64_t p50 = item.percentileUs(50);
+  EXPECT_GE(p50, 5000);
+  EXPECT_LE(p50, 5000 + 5000 / 8);
+  uint64_t p99 = item.percentileUs(99);
+  EXPECT_GE(p99, 9900);
+  EXPECT_LE(p99, 10000);
+  EXPECT_EQ(item.percentileUs(100), 10000);
+  EXPECT_LE(item.percentileUs(0), 10 + 10 / 8);
+}
+
+TEST(LatencyStatsTest, concurrent_record) {
+  LatencyStats stats;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&stats]() -> void {
+      for (int i = 0; i < 10000; i++) {
+        stats.record(kLatencyNvmeIo, (uint8_t) (i % 3), (uint64_t) i, (i % 10) == 0);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<LatencyOpcodeStats> items;
+  stats.snapshot(items);
+  ASSERT_EQ(items.size(), 3);
+  uint64_t count = 0, errors = 0;
+  for (const auto& item : items) {
+    uint64_t bucket_total = 0;
+    for (uint64_t bucket : item.buckets) {
+      bucket_total += bucket;
+    }
+    EXPECT_EQ(bucket_total, item.count);
+    count += item.count;
+    errors += item.errors;
+  }
+  EXPECT_EQ(count, 40000);
+  EXPECT_EQ(errors, 4000);
+}
+
+} // namespace
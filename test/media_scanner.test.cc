@@ -0,0 +1,330 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <jcu-dparm/media_scanner.h>
+
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+typedef std::pair<uint64_t, uint32_t> Chunk;
+
+/**
+ * answers READ VERIFY SECTORS EXT by `respond` (all good by default)
+ */
+class FakeAtaDriverHandle : public DriveDriverHandle {
+ public:
+  std::function<DparmResult(uint64_t lba, uint32_t sectors, AtaCompletion *completion)> respond;
+  std::vector<Chunk> chunks;
+
+  FakeAtaDriverHandle() {
+    driving_type_ = kDrivingAtapi;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  bool driverIsTaskfileCmdSupported() const override {
+    return true;
+  }
+
+  DparmResult doTaskfileCmdWithCompletion(int rw, int dma, ata::ata_tf_t *tf, void *data, unsigned int data_bytes,
+                                          unsigned int timeout_secs, AtaCompletion *completion) override {
+    uint64_t lba = tf->lob.lbal | ((uint64_t) tf->lob.lbam << 8) | ((uint64_t) tf->lob.lbah << 16) |
+        ((uint64_t) tf->hob.lbal << 24) | ((uint64_t) tf->hob.lbam << 32) | ((uint64_t) tf->hob.lbah << 40);
+    uint32_t sectors = tf->lob.nsect | ((uint32_t) tf->hob.nsect << 8);
+    if (!sectors) {
+      sectors = 65536;
+    }
+    chunks.push_back(Chunk(lba, sectors));
+    *completion = AtaCompletion();
+    return respond ? respond(lba, sectors, completion) : DparmResult{ DPARME_OK, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeAtaDriverHandle driver_handle;
+  uint64_t capacity;
+
+  FakeDriveHandle()
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()), capacity(1000) {
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeAtaDriverHandle *>(&driver_handle);
+  }
+
+  uint64_t getAtaLbaCapacity() override {
+    return capacity;
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+DparmResult ataError(AtaCompletion *completion, uint64_t error_lba, bool upper_unknown) {
+  completion->has_ata_return = true;
+  completion->ata_extend = true;
+  completion->ata_upper_unknown = upper_unknown;
+  completion->ata_status = 0x51;
+  completion->ata_error = 0x40; // UNC
+  completion->ata_lba = error_lba;
+  return { DPARME_ATA_FAILED, 0 };
+}
+
+MediaScanOptions chunksOf(uint32_t chunk_sectors) {
+  MediaScanOptions options;
+  options.chunk_sectors = chunk_sectors;
+  return options;
+}
+
+MediaScanResult scan(FakeDriveHandle *handle, const MediaScanOptions &options) {
+  MediaScanner scanner(options);
+  scanner.addDrive(handle);
+  scanner.run();
+  return scanner.getResults()[0];
+}
+
+TEST(MediaRegionMapTest, merges_touching_regions_of_same_type) {
+  MediaRegionMap map;
+  map.add(0, 100, kMediaRegionSlow, 1200);
+  map.add(100, 100, kMediaRegionSlow, 1500);
+  map.add(300, 100, kMediaRegionSlow, 1100);
+
+  const auto& regions = map.getRegions();
+  ASSERT_EQ(regions.size(), 2);
+  EXPECT_EQ(regions[0].lba, 0);
+  EXPECT_EQ(regions[0].sectors, 200);
+  EXPECT_EQ(regions[0].max_latency_ms, 1500);
+  EXPECT_EQ(regions[1].lba, 300);
+  EXPECT_EQ(regions[1].sectors, 100);
+  EXPECT_EQ(map.countSectors(kMediaRegionSlow), 300);
+}
+
+TEST(MediaRegionMapTest, other_type_in_between) {
+  MediaRegionMap map;
+  map.add(0, 100, kMediaRegionSlow, 1200);
+  map.add(50, 1, kMediaRegionBad, 20);
+  map.add(51, 1, kMediaRegionBad, 30);
+  map.add(100, 100, kMediaRegionSlow, 1300);
+
+  const auto& regions = map.getRegions();
+  ASSERT_EQ(regions.size(), 2);
+  EXPECT_EQ(regions[0].type, kMediaRegionSlow);
+  EXPECT_EQ(regions[0].lba, 0);
+  EXPECT_EQ(regions[0].sectors, 200);
+  EXPECT_EQ(regions[1].type, kMediaRegionBad);
+  EXPECT_EQ(regions[1].lba, 50);
+  EXPECT_EQ(regions[1].sectors, 2);
+  EXPECT_EQ(regions[1].max_latency_ms, 30);
+}
+
+TEST(MediaRegionMapTest, out_of_order_fills_gap) {
+  MediaRegionMap map;
+  map.add(200, 10, kMediaRegionBad, 1);
+  map.add(100, 10, kMediaRegionBad, 1);
+  map.add(110, 90, kMediaRegionBad, 5);
+  map.add(0, 0, kMediaRegionBad, 9);
+
+  const auto& regions = map.getRegions();
+  ASSERT_EQ(regions.size(), 1);
+  EXPECT_EQ(regions[0].lba, 100);
+  EXPECT_EQ(regions[0].sectors, 110);
+  EXPECT_EQ(regions[0].max_latency_ms, 5);
+}
+
+TEST(MediaScannerTest, resumes_after_the_error_lba) {
+  FakeDriveHandle handle;
+  handle.driver_handle.respond = [](uint64_t lba, uint32_t sectors, AtaCompletion *completion) -> DparmResult {
+    if (lba <= 150 && 150 < lba + sectors) {
+      return ataError(completion, 150, false);
+    }
+    return { DPARME_OK, 0 };
+  };
+
+  MediaScanResult result = scan(&handle, chunksOf(100));
+  EXPECT_TRUE(result.result.isOk());
+  EXPECT_EQ(result.next_lba, 1000);
+  EXPECT_EQ(result.errors, 1);
+  EXPECT_EQ(result.chunk_latency.errors, 1);
+  ASSERT_GE(handle.driver_handle.chunks.size(), 4);
+  EXPECT_EQ(handle.driver_handle.chunks[1], Chunk(100, 100));
+  EXPECT_EQ(handle.driver_handle.chunks[2], Chunk(151, 100));
+  EXPECT_EQ(handle.driver_handle.chunks[3], Chunk(251, 100));
+  EXPECT_EQ(handle.driver_handle.chunks.back(), Chunk(951, 49));
+
+  const auto &regions = result.regions.getRegions();
+  ASSERT_EQ(regions.size(), 1);
+  EXPECT_EQ(regions[0].type, kMediaRegionBad);
+  EXPECT_EQ(regions[0].lba, 150);
+  EXPECT_EQ(regions[0].sectors, 1);
+}
+
+TEST(MediaScannerTest, whole_chunk_is_bad_without_a_usable_error_lba) {
+  const bool upper_unknown[] = { false, true };
+  const uint64_t error_lbas[] = { 5000, 150 };
+  for (size_t i = 0; i < 2; i++) {
+    FakeDriveHandle handle;
+    handle.driver_handle.respond = [&](uint64_t lba, uint32_t sectors, AtaCompletion *completion) -> DparmResult {
+      if (lba == 100) {
+        return ataError(completion, error_lbas[i], upper_unknown[i]);
+      }
+      return { DPARME_OK, 0 };
+    };
+
+    MediaScanResult result = scan(&handle, chunksOf(100));
+    EXPECT_TRUE(result.result.isOk()) << i;
+    EXPECT_EQ(result.next_lba, 1000) << i;
+    ASSERT_GE(handle.driver_handle.chunks.size(), 3) << i;
+    EXPECT_EQ(handle.driver_handle.chunks[2], Chunk(200, 100)) << i;
+    const auto &regions = result.regions.getRegions();
+    ASSERT_EQ(regions.size(), 1) << i;
+    EXPECT_EQ(regions[0].lba, 100) << i;
+    EXPECT_EQ(regions[0].sectors, 100) << i;
+  }
+}
+
+TEST(MediaScannerTest, stops_after_transport_failures) {
+  FakeDriveHandle handle;
+  handle.driver_handle.respond = [](uint64_t lba, uint32_t sectors, AtaCompletion *completion) -> DparmResult {
+    if (lba >= 200) {
+      return { DPARME_IOCTL_FAILED, 5 };
+    }
+    return { DPARME_OK, 0 };
+  };
+
+  MediaScanResult result = scan(&handle, chunksOf(100));
+  EXPECT_EQ(result.result.code, DPARME_IOCTL_FAILED);
+  EXPECT_EQ(handle.driver_handle.chunks.size(), 5);
+  EXPECT_EQ(result.errors, 3);
+  // the last failed chunk is not skipped
+  EXPECT_EQ(result.next_lba, 400);
+  EXPECT_EQ(result.regions.countSectors(kMediaRegionBad), 200);
+}
+
+TEST(MediaScannerTest, ata_error_resets_transport_failures) {
+  FakeDriveHandle handle;
+  handle.driver_handle.respond = [](uint64_t lba, uint32_t sectors, AtaCompletion *completion) -> DparmResult {
+    if (lba == 200) {
+      return ataError(completion, 250, false);
+    }
+    if (lba >= 100 && lba < 400) {
+      return { DPARME_IOCTL_FAILED, 5 };
+    }
+    return { DPARME_OK, 0 };
+  };
+
+  // 100 fails, 200 reports an ATA error, then 251 and 351 fail
+  MediaScanResult result = scan(&handle, chunksOf(100));
+  EXPECT_TRUE(result.result.isOk());
+  EXPECT_EQ(result.next_lba, 1000);
+  EXPECT_EQ(result.errors, 4);
+}
+
+TEST(MediaScannerTest, max_errors) {
+  FakeDriveHandle handle;
+  handle.driver_handle.respond = [](uint64_t lba, uint32_t sectors, AtaCompletion *completion) -> DparmResult {
+    return ataError(completion, lba, false);
+  };
+  MediaScanOptions options = chunksOf(100);
+  options.max_errors = 2;
+
+  MediaScanResult result = scan(&handle, options);
+  EXPECT_EQ(result.result.code, DPARME_ATA_FAILED);
+  EXPECT_EQ(result.errors, 2);
+  EXPECT_EQ(handle.driver_handle.chunks.size(), 2);
+  EXPECT_EQ(result.next_lba, 2);
+}
+
+TEST(MediaScannerTest, cancel_stops_after_the_chunk) {
+  FakeDriveHandle handle;
+  MediaScanner scanner(chunksOf(100));
+  scanner.addDrive(&handle);
+  int calls = 0;
+  scanner.setProgressCallback([&](size_t drive_index, const MediaScanResult &progress) -> bool {
+    if (++calls == 3) {
+      scanner.cancel();
+    }
+    return true;
+  });
+  scanner.run();
+
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(handle.driver_handle.chunks.size(), 3);
+  EXPECT_TRUE(scanner.getResults()[0].result.isOk());
+  EXPECT_EQ(scanner.getResults()[0].next_lba, 300);
+}
+
+TEST(MediaScannerTest, progress_callback_stops_the_drive) {
+  FakeDriveHandle handle;
+  MediaScanner scanner(chunksOf(100));
+  scanner.addDrive(&handle);
+  std::vector<uint64_t> progress_lbas;
+  scanner.setProgressCallback([&](size_t drive_index, const MediaScanResult &progress) -> bool {
+    EXPECT_EQ(drive_index, 0);
+    progress_lbas.push_back(progress.next_lba);
+    return progress_lbas.size() < 2;
+  });
+  scanner.run();
+
+  EXPECT_EQ(progress_lbas, std::vector<uint64_t>({ 100, 200 }));
+  EXPECT_EQ(handle.driver_handle.chunks.size(), 2);
+  EXPECT_EQ(scanner.getResults()[0].next_lba, 200);
+}
+
+TEST(MediaScannerTest, end_lba_is_clamped_to_the_capacity) {
+  FakeDriveHandle handle;
+  MediaScanOptions options = chunksOf(100);
+  options.start_lba = 50;
+  options.end_lba = 5000;
+  MediaScanResult result = scan(&handle, options);
+  EXPECT_EQ(result.start_lba, 50);
+  EXPECT_EQ(result.end_lba, 1000);
+  EXPECT_EQ(result.next_lba, 1000);
+  EXPECT_EQ(handle.driver_handle.chunks.front(), Chunk(50, 100));
+  EXPECT_EQ(handle.driver_handle.chunks.back(), Chunk(950, 50));
+
+  FakeDriveHandle partial;
+  options.end_lba = 250;
+  result = scan(&partial, options);
+  EXPECT_EQ(result.end_lba, 250);
+  EXPECT_EQ(partial.driver_handle.chunks, std::vector<Chunk>({ Chunk(50, 100), Chunk(150, 100) }));
+
+  FakeDriveHandle large;
+  large.capacity = 200000;
+  result = scan(&large, MediaScanOptions());
+  // 65536 sectors per command by default
+  EXPECT_EQ(large.driver_handle.chunks.front(), Chunk(0, 65536));
+  EXPECT_EQ(large.driver_handle.chunks.back(), Chunk(196608, 3392));
+}
+
+TEST(MediaScannerTest, drive_without_capacity_is_not_supported) {
+  FakeDriveHandle handle;
+  handle.capacity = 0;
+  MediaScanResult result = scan(&handle, MediaScanOptions());
+  EXPECT_EQ(result.result.code, DPARME_NOT_SUPPORTED);
+  EXPECT_TRUE(handle.driver_handle.chunks.empty());
+}
+
+} // namespace
@@ -0,0 +1,346 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include <jcu-dparm/nvme_persistent_event_log.h>
+
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+void appendEvent(std::vector<uint8_t>& log, uint8_t type, uint64_t timestamp_ms, uint16_t vsil, uint16_t data_length) {
+  nvme::nvme_persistent_event_header_t header;
+  memset(&header, 0, sizeof(header));
+  header.etype = type;
+  header.etype_rev = 1;
+  header.ehl = sizeof(header) - 3;
+  header.cntlid = 1;
+  // bits 63:48 carry timestamp attributes
+  header.ets = timestamp_ms | (2ULL << 48);
+  header.vsil = vsil;
+  header.el = vsil + data_length;
+  const uint8_t *p = (const uint8_t *) &header;
+  log.insert(log.end(), p, p + sizeof(header));
+  for (uint16_t i = 0; i < vsil; i++) {
+    log.push_back(0xee);
+  }
+  for (uint16_t i = 0; i < data_length; i++) {
+    log.push_back((uint8_t) i);
+  }
+}
+
+TEST(NvmePersistentEventIteratorTest, iterates_packed_events) {
+  std::vector<uint8_t> log;
+  appendEvent(log, 0x01, 1000, 0, 508);
+  appendEvent(log, 0x05, 2000, 3, 5);
+  appendEvent(log, 0x0d, 3000, 0, 0);
+
+  NvmePersistentEventIterator it(log.data(), log.size(), 512);
+  ASSERT_NE(it, NvmePersistentEventIterator());
+  EXPECT_EQ(it->offset, 512);
+  EXPECT_EQ(it->length, 24 + 508);
+  EXPECT_EQ(it->type, 0x01);
+  EXPECT_EQ(it->timestamp_ms, 1000);
+  EXPECT_EQ(it->data_length, 508);
+
+  ++it;
+  ASSERT_NE(it, NvmePersistentEventIterator());
+  EXPECT_EQ(it->offset, 512 + 24 + 508);
+  EXPECT_EQ(it->type, 0x05);
+  EXPECT_EQ(it->timestamp_ms, 2000);
+  EXPECT_EQ(it->vendor_info_length, 3);
+  EXPECT_EQ(it->vendor_info[0], 0xee);
+  EXPECT_EQ(it->data_length, 5);
+  EXPECT_EQ(it->data[4], 4);
+
+  ++it;
+  ASSERT_NE(it, NvmePersistentEventIterator());
+  EXPECT_EQ(it->type, 0x0d);
+  EXPECT_EQ(it->data_length, 0);
+
+  ++it;
+  EXPECT_EQ(it, NvmePersistentEventIterator());
+}
+
+TEST(NvmePersistentEventIteratorTest, stops_at_truncated_event) {
+  std::vector<uint8_t> log;
+  appendEvent(log, 0x01, 1000, 0, 16);
+  appendEvent(log, 0x02, 2000, 0, 16);
+  log.resize(log.size() - 1);
+
+  int count = 0;
+  for (NvmePersistentEventIterator it(log.data(), log.size(), 512); it != NvmePersistentEventIterator(); ++it) {
+    count++;
+  }
+  EXPECT_EQ(count, 1);
+}
+
+TEST(NvmePersistentEventIteratorTest, rejects_vendor_info_longer_than_event) {
+  std::vector<uint8_t> log;
+  appendEvent(log, 0x01, 1000, 0, 16);
+  nvme::nvme_persistent_event_header_t *header = (nvme::nvme_persistent_event_header_t *) log.data();
+  header->vsil = 17;
+
+  NvmePersistentEventIterator it(log.data(), log.size(), 512);
+  EXPECT_EQ(it, NvmePersistentEventIterator());
+}
+
+/**
+ * Persistent Event Log of `log` (header and events). Tracks the reporting context.
+ */
+class FakePelDriverHandle : public DriveDriverHandle {
+ public:
+  std::vector<uint8_t> log;
+  bool context;
+  // larger transfers fail like a host adapter limit; 0 : no limit
+  uint32_t max_transfer_bytes;
+  // offset of each read (LSP 0)
+  std::vector<uint64_t> read_offsets;
+  std::vector<uint8_t> lsps;
+
+  FakePelDriverHandle() : log(sizeof(nvme::nvme_persistent_event_log_header_t)), context(false), max_transfer_bytes(0) {
+    driving_type_ = kDrivingNvme;
+    updateHeader();
+  }
+
+  void updateHeader() {
+    nvme::nvme_persistent_event_log_header_t *header = (nvme::nvme_persistent_event_log_header_t *) log.data();
+    header->lid = nvme::NVME_GET_LOG_PAGE_PERSISTENT_EVENT;
+    header->tll = log.size();
+  }
+
+  void addEvent(uint8_t type, uint64_t timestamp_ms) {
+    appendEvent(log, type, timestamp_ms, 0, 5);
+    updateHeader();
+  }
+
+  void clear() {
+    log.resize(sizeof(nvme::nvme_persistent_event_log_header_t));
+    updateHeader();
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  bool driverIsNvmeAdminPassthruSupported() const override {
+    return true;
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru(nvme::nvme_admin_cmd_t *cmd) override {
+    uint8_t lsp = (uint8_t) ((cmd->cdw10 >> 8) & 0x0f);
+    uint64_t offset = cmd->cdw12 | ((uint64_t) cmd->cdw13 << 32);
+    lsps.push_back(lsp);
+    if ((offset % 4) || (cmd->data_len % 4)) {
+      return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_INVALID_FIELD, 0 };
+    }
+    if (max_transfer_bytes && cmd->data_len > max_transfer_bytes) {
+      return { DPARME_IOCTL_FAILED, EINVAL, 0, 0 };
+    }
+    if (lsp == nvme::NVME_PEL_LSP_ESTABLISH_CONTEXT) {
+      context = true;
+    } else if (lsp == nvme::NVME_PEL_LSP_RELEASE_CONTEXT) {
+      context = false;
+      return { DPARME_OK, 0, 0, 0 };
+    } else if (!context) {
+      return { DPARME_NVME_FAILED, 0, nvme::NVME_SC_CMD_SEQ_ERROR, 0 };
+    } else {
+      read_offsets.push_back(offset);
+    }
+    uint8_t *data = (uint8_t *) cmd->addr;
+    memset(data, 0, cmd->data_len);
+    for (uint32_t i = 0; i < cmd->data_len && offset + i < log.size(); i++) {
+      data[i] = log[(size_t) (offset + i)];
+    }
+    return { DPARME_OK, 0, 0, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakePelDriverHandle driver_handle;
+
+  explicit FakeDriveHandle(uint32_t log_chunk_bytes = 4096)
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()) {
+    nvme_log_chunk_bytes_ = log_chunk_bytes;
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakePelDriverHandle *>(&driver_handle);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+/**
+ * poll and return the timestamps of the new events
+ */
+std::vector<uint64_t> pollTimestamps(NvmePersistentEventReader &reader) {
+  std::vector<uint64_t> timestamps;
+  EXPECT_TRUE(reader.poll().isOk());
+  for (NvmePersistentEventIterator it = reader.begin(); it != reader.end(); ++it) {
+    timestamps.push_back(it->timestamp_ms);
+  }
+  return timestamps;
+}
+
+TEST(NvmePersistentEventReaderTest, reads_the_tail) {
+  FakeDriveHandle handle;
+  FakePelDriverHandle &drive = handle.driver_handle;
+  NvmePersistentEventReader reader(&handle);
+
+  EXPECT_TRUE(pollTimestamps(reader).empty());
+  EXPECT_FALSE(reader.hasPosition());
+
+  drive.addEvent(0x01, 100);
+  drive.addEvent(0x02, 200);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 100, 200 }));
+  EXPECT_EQ(reader.getLastEventOffset(), 512 + 29);
+  EXPECT_EQ(reader.getLastTimestamp(), 200);
+  EXPECT_EQ(reader.getLastType(), 0x02);
+
+  // only from the last consumed event on
+  drive.read_offsets.clear();
+  EXPECT_TRUE(pollTimestamps(reader).empty());
+  ASSERT_EQ(drive.read_offsets.size(), 1);
+  EXPECT_EQ(drive.read_offsets[0], (512 + 29) & ~3ULL);
+
+  drive.addEvent(0x03, 300);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 300 }));
+  EXPECT_EQ(reader.getLastEventOffset(), 512 + 2 * 29);
+  EXPECT_FALSE(drive.context);
+}
+
+TEST(NvmePersistentEventReaderTest, wrap_and_clear_skip_by_timestamp) {
+  FakeDriveHandle handle;
+  FakePelDriverHandle &drive = handle.driver_handle;
+  NvmePersistentEventReader reader(&handle);
+
+  drive.addEvent(0x01, 100);
+  drive.addEvent(0x02, 200);
+  drive.addEvent(0x03, 300);
+  EXPECT_EQ(pollTimestamps(reader).size(), 3);
+
+  // the oldest events were dropped: another event is at the last offset
+  drive.clear();
+  drive.addEvent(0x02, 200);
+  drive.addEvent(0x03, 300);
+  drive.addEvent(0x04, 400);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 400 }));
+  EXPECT_EQ(reader.getLastTimestamp(), 400);
+
+  // cleared: the last offset is beyond the log
+  drive.clear();
+  EXPECT_TRUE(pollTimestamps(reader).empty());
+  drive.addEvent(0x05, 500);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 500 }));
+  EXPECT_FALSE(drive.context);
+}
+
+TEST(NvmePersistentEventReaderTest, same_millisecond_and_clock_reset) {
+  FakeDriveHandle handle;
+  FakePelDriverHandle &drive = handle.driver_handle;
+  NvmePersistentEventReader reader(&handle);
+
+  drive.addEvent(0x01, 100);
+  drive.addEvent(0x02, 200);
+  EXPECT_EQ(pollTimestamps(reader).size(), 2);
+
+  // the last consumed event is gone; a new one of the same millisecond is kept
+  drive.clear();
+  drive.addEvent(0x05, 200);
+  drive.addEvent(0x06, 210);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 200, 210 }));
+
+  // the last consumed event moved: skipped up to it
+  drive.clear();
+  drive.addEvent(0x01, 150);
+  drive.addEvent(0x05, 200);
+  drive.addEvent(0x06, 210);
+  drive.addEvent(0x07, 210);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 210 }));
+  EXPECT_EQ(reader.getLastType(), 0x07);
+
+  // the clock went back
+  drive.clear();
+  drive.addEvent(0x01, 205);
+  drive.addEvent(0x01, 10);
+  drive.addEvent(0x01, 20);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 10, 20 }));
+
+  // cleared, then reset
+  drive.clear();
+  drive.addEvent(nvme::NVME_PEL_POWER_ON_RESET, 5);
+  drive.addEvent(0x01, 8);
+  EXPECT_EQ(pollTimestamps(reader), std::vector<uint64_t>({ 5, 8 }));
+  EXPECT_FALSE(drive.context);
+}
+
+TEST(NvmePersistentEventReaderTest, resumes_from_saved_position) {
+  FakeDriveHandle handle;
+  FakePelDriverHandle &drive = handle.driver_handle;
+  drive.addEvent(0x01, 100);
+  drive.addEvent(0x02, 200);
+
+  NvmePersistentEventReader first(&handle);
+  EXPECT_EQ(pollTimestamps(first).size(), 2);
+
+  drive.addEvent(0x03, 300);
+  NvmePersistentEventReader second(&handle);
+  second.setPosition(first.getLastEventOffset(), first.getLastTimestamp(), first.getLastType());
+  EXPECT_TRUE(second.hasPosition());
+  drive.read_offsets.clear();
+  EXPECT_EQ(pollTimestamps(second), std::vector<uint64_t>({ 300 }));
+  EXPECT_GT(drive.read_offsets[0], 512);
+}
+
+TEST(NvmePersistentEventReaderTest, context_is_released_on_error) {
+  FakeDriveHandle handle;
+  FakePelDriverHandle &drive = handle.driver_handle;
+  NvmePersistentEventReader reader(&handle);
+
+  nvme::nvme_persistent_event_log_header_t *header = (nvme::nvme_persistent_event_log_header_t *) drive.log.data();
+  header->tll = 16;
+  EXPECT_EQ(reader.poll().code, DPARME_ILLEGAL_RESPONSE);
+  EXPECT_FALSE(drive.context);
+  EXPECT_EQ(drive.lsps, std::vector<uint8_t>({ nvme::NVME_PEL_LSP_ESTABLISH_CONTEXT, nvme::NVME_PEL_LSP_RELEASE_CONTEXT }));
+  EXPECT_EQ(reader.begin(), reader.end());
+}
+
+TEST(NvmePersistentEventReaderTest, falls_back_to_4k_transfers) {
+  FakeDriveHandle handle(65536);
+  FakePelDriverHandle &drive = handle.driver_handle;
+  drive.max_transfer_bytes = 4096;
+  for (int i = 0; i < 400; i++) {
+    drive.addEvent(0x01, 100 + i);
+  }
+  NvmePersistentEventReader reader(&handle);
+
+  std::vector<uint64_t> timestamps = pollTimestamps(reader);
+  ASSERT_EQ(timestamps.size(), 400);
+  EXPECT_EQ(timestamps.back(), 499);
+  EXPECT_EQ(drive.read_offsets.size(), (drive.log.size() - 512 + 4095) / 4096);
+  EXPECT_FALSE(drive.context);
+}
+
+} // namespace
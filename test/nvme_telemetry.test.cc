@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <jcu-dparm/nvme_telemetry.h>
+
+#include "drive_handle_base.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+/**
+ * Telemetry Host-Initiated log of 1001 blocks (data areas end at 10, 100 and 1000).
+ * Each byte after the header holds the low byte of its block number.
+ */
+class FakeTelemetryDriverHandle : public DriveDriverHandle {
+ public:
+  uint8_t generation;
+  // the header reads after the first report the next generation
+  bool bump_generation;
+  // larger transfers fail like a host adapter limit; 0 : no limit
+  uint32_t max_transfer_bytes;
+  int header_reads;
+  std::vector<uint32_t> transfer_lengths;
+
+  FakeTelemetryDriverHandle() : generation(5), bump_generation(false), max_transfer_bytes(0), header_reads(0) {
+    driving_type_ = kDrivingNvme;
+  }
+
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+
+  bool driverIsNvmeAdminPassthruSupported() const override {
+    return true;
+  }
+
+  DparmReturn<int> doNvmeAdminPassthru(nvme::nvme_admin_cmd_t *cmd) override {
+    transfer_lengths.push_back(cmd->data_len);
+    if (max_transfer_bytes && cmd->data_len > max_transfer_bytes) {
+      return { DPARME_IOCTL_FAILED, EINVAL, 0, 0 };
+    }
+
+    uint64_t offset = cmd->cdw12 | ((uint64_t) cmd->cdw13 << 32);
+    unsigned char *data = (unsigned char *) cmd->addr;
+    for (uint32_t i = 0; i < cmd->data_len; i++) {
+      data[i] = (unsigned char) ((offset + i) / 512);
+    }
+    if (offset == 0) {
+      nvme::nvme_telemetry_log_header_t header;
+      memset(&header, 0, sizeof(header));
+      header.lpi = nvme::NVME_GET_LOG_PAGE_TELEMETRY_HOST;
+      header.dalb1 = 10;
+      header.dalb2 = 100;
+      header.dalb3 = 1000;
+      header.hostdgn = (bump_generation && header_reads > 0) ? generation + 1 : generation;
+      memcpy(data, &header, std::min<size_t>(sizeof(header), cmd->data_len));
+      header_reads++;
+    }
+    return { DPARME_OK, 0, 0, 0 };
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeTelemetryDriverHandle driver_handle;
+
+  FakeDriveHandle()
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()) {
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeTelemetryDriverHandle *>(&driver_handle);
+  }
+
+  bool isOpen() const override {
+    return true;
+  }
+
+  void close() override {
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+const size_t kLogBytes = 1001 * 512;
+
+bool isLogData(const std::vector<unsigned char> &output) {
+  if (output.size() != kLogBytes) {
+    return false;
+  }
+  for (size_t i = sizeof(nvme::nvme_telemetry_log_header_t); i < output.size(); i++) {
+    if (output[i] != (unsigned char) (i / 512)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+NvmeTelemetrySink appendTo(std::vector<unsigned char> &output) {
+  return [&output](const void *data, size_t length) -> int {
+    output.insert(output.end(), (const unsigned char *) data, (const unsigned char *) data + length);
+    return 0;
+  };
+}
+
+TEST(NvmeTelemetryTest, options_default_to_zero) {
+  NvmeTelemetryOptions options;
+  EXPECT_EQ(options.data_area, 0);
+  EXPECT_FALSE(options.create);
+  EXPECT_EQ(options.chunk_bytes, 0);
+  EXPECT_EQ(options.ring_buffers, 0);
+}
+
+TEST(NvmeTelemetryTest, ring_keeps_order) {
+  const int ring_buffers[] = { 1, 2, 4 };
+  for (size_t i = 0; i < sizeof(ring_buffers) / sizeof(ring_buffers[0]); i++) {
+    FakeDriveHandle handle;
+    std::vector<unsigned char> output;
+    NvmeTelemetryOptions options;
+    options.chunk_bytes = 8192;
+    options.ring_buffers = ring_buffers[i];
+
+    NvmeTelemetryResult result = captureNvmeTelemetry(&handle, options, appendTo(output));
+    EXPECT_TRUE(result.result.isOk()) << "ring_buffers=" << ring_buffers[i];
+    EXPECT_EQ(result.total_bytes, kLogBytes);
+    EXPECT_EQ(result.written_bytes, kLogBytes);
+    EXPECT_EQ(result.generation, 5);
+    EXPECT_EQ(result.data_area_last_block[2], 1000);
+    EXPECT_FALSE(result.generation_changed);
+    EXPECT_TRUE(isLogData(output)) << "ring_buffers=" << ring_buffers[i];
+  }
+}
+
+TEST(NvmeTelemetryTest, data_area_limits_the_capture) {
+  FakeDriveHandle handle;
+  std::vector<unsigned char> output;
+  NvmeTelemetryOptions options;
+  options.data_area = 1;
+
+  NvmeTelemetryResult result = captureNvmeTelemetry(&handle, options, appendTo(output));
+  EXPECT_TRUE(result.result.isOk());
+  EXPECT_EQ(result.total_bytes, 11 * 512);
+  EXPECT_EQ(output.size(), 11 * 512);
+}
+
+TEST(NvmeTelemetryTest, falls_back_to_4k_transfers) {
+  FakeDriveHandle handle;
+  handle.driver_handle.max_transfer_bytes = 4096;
+  std::vector<unsigned char> output;
+  NvmeTelemetryOptions options;
+  options.chunk_bytes = 65536;
+  options.ring_buffers = 2;
+
+  NvmeTelemetryResult result = captureNvmeTelemetry(&handle, options, appendTo(output));
+  EXPECT_TRUE(result.result.isOk());
+  EXPECT_TRUE(isLogData(output));
+
+  // one rejected transfer, then 4k ones only
+  const std::vector<uint32_t> &lengths = handle.driver_handle.transfer_lengths;
+  ASSERT_GT(lengths.size(), 2);
+  EXPECT_EQ(lengths[1], 65536);
+  for (size_t i = 2; i < lengths.size(); i++) {
+    EXPECT_LE(lengths[i], 4096);
+  }
+}
+
+TEST(NvmeTelemetryTest, generation_change_is_reported) {
+  FakeDriveHandle handle;
+  handle.driver_handle.bump_generation = true;
+  std::vector<unsigned char> output;
+  NvmeTelemetryOptions options;
+  options.create = true;
+
+  NvmeTelemetryResult result = captureNvmeTelemetry(&handle, options, appendTo(output));
+  EXPECT_EQ(result.result.code, DPARME_ILLEGAL_DATA);
+  EXPECT_TRUE(result.generation_changed);
+  EXPECT_EQ(result.generation, 5);
+  EXPECT_EQ(handle.driver_handle.header_reads, 2);
+  // the data is still written
+  EXPECT_EQ(result.written_bytes, kLogBytes);
+}
+
+TEST(NvmeTelemetryTest, sink_error_stops_the_capture) {
+  FakeDriveHandle handle;
+  int chunks = 0;
+  NvmeTelemetryOptions options;
+  options.chunk_bytes = 4096;
+  options.ring_buffers = 1;
+
+  NvmeTelemetryResult result = captureNvmeTelemetry(&handle, options, [&chunks](const void *data, size_t length) -> int {
+    return (++chunks > 3) ? EIO : 0;
+  });
+  EXPECT_EQ(result.result.code, DPARME_SYS);
+  EXPECT_EQ(result.result.sys_error, EIO);
+  EXPECT_EQ(result.written_bytes, 512 + 2 * 4096);
+  EXPECT_LT(handle.driver_handle.transfer_lengths.size(), 10);
+}
+
+} // namespace
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <jcu-dparm/sense_data.h>
+
+using namespace jcu::dparm;
+
+namespace {
+
+TEST(SenseDataTest, descriptor_ata_return) {
+  // ABORTED COMMAND, ATA PASS THROUGH INFORMATION AVAILABLE, ATA Status Return descriptor (LBA48)
+  const unsigned char sense[] = {
+      0x72, 0x0b, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x0e,
+      0x09, 0x0c, 0x01, 0x04, 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0, 0x40, 0x51,
+  };
+  AtaCompletion completion;
+  ASSERT_TRUE(decodeSenseData(sense, sizeof(sense), true, &completion));
+  EXPECT_EQ(completion.sense_response_code, 0x72);
+  EXPECT_EQ(completion.sense_key, kSenseAbortedCommand);
+  EXPECT_EQ(completion.asc, 0x00);
+  EXPECT_EQ(completion.ascq, 0x1d);
+  ASSERT_TRUE(completion.has_ata_return);
+  EXPECT_TRUE(completion.ata_extend);
+  EXPECT_EQ(completion.ata_error, 0x04);
+  EXPECT_EQ(completion.ata_status, 0x51);
+  EXPECT_EQ(completion.ata_device, 0x40);
+  EXPECT_EQ(completion.ata_count, 0x1234);
+  EXPECT_EQ(completion.ata_lba, 0xde9a56f0bc78ULL);
+  EXPECT_TRUE(completion.isAtaError());
+
+  ata::ata_tf_t tf = {0};
+  completion.getAtaReturn(&tf);
+  AtaCompletion again;
+  again.setAtaReturn(tf);
+  EXPECT_EQ(again.ata_lba, completion.ata_lba);
+  EXPECT_EQ(again.ata_count, completion.ata_count);
+  EXPECT_EQ(again.ata_status, completion.ata_status);
+}
+
+TEST(SenseDataTest, descriptor_skips_other_descriptors) {
+  const unsigned char sense[] = {
+      0x72, 0x01, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x1a,
+      0x00, 0x0a, 0x80, 0x00, 0, 0, 0, 0, 0, 0, 0, 0x10,
+      0x09, 0x0c, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0xa0, 0x50,
+  };
+  AtaCompletion completion;
+  ASSERT_TRUE(decodeSenseData(sense, sizeof(sense), true, &completion));
+  ASSERT_TRUE(completion.has_ata_return);
+  EXPECT_FALSE(completion.ata_extend);
+  EXPECT_EQ(completion.ata_count, 1);
+  EXPECT_EQ(completion.ata_lba, 0x040302ULL);
+  EXPECT_EQ(completion.ata_status, 0x50);
+  EXPECT_FALSE(completion.isAtaError());
+}
+
+TEST(SenseDataTest, fixed_ata_pass_through) {
+  const unsigned char sense[18] = {
+      0x70, 0x00, 0x0b, 0x04, 0x51, 0x40, 0x08, 0x00,
+      0xc0, 0x11, 0x22, 0x33, 0x00, 0x1d,
+  };
+  AtaCompletion completion;
+  ASSERT_TRUE(decodeSenseData(sense, sizeof(sense), true, &completion));
+  EXPECT_EQ(completion.sense_response_code, 0x70);
+  EXPECT_EQ(completion.sense_key, kSenseAbortedCommand);
+  EXPECT_EQ(completion.ascq, 0x1d);
+  ASSERT_TRUE(completion.has_ata_return);
+  EXPECT_TRUE(completion.ata_extend);
+  EXPECT_TRUE(completion.ata_upper_unknown);
+  EXPECT_EQ(completion.ata_error, 0x04);
+  EXPECT_EQ(completion.ata_status, 0x51);
+  EXPECT_EQ(completion.ata_count, 0x08);
+  EXPECT_EQ(completion.ata_lba, 0x332211ULL);
+
+  ASSERT_TRUE(decodeSenseData(sense, sizeof(sense), false, &completion));
+  EXPECT_FALSE(completion.has_ata_return);
+}
+
+TEST(SenseDataTest, fixed_illegal_request_is_not_ata_return) {
+  // ILLEGAL REQUEST, INVALID FIELD IN CDB: bytes 3-11 are not ATA registers
+  const unsigned char sense[18] = {
+      0x70, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x0a,
+      0x00, 0x00, 0x00, 0x00, 0x24, 0x00,
+  };
+  AtaCompletion completion;
+  ASSERT_TRUE(decodeSenseData(sense, sizeof(sense), true, &completion));
+  EXPECT_EQ(completion.sense_key, kSenseIllegalRequest);
+  EXPECT_EQ(completion.asc, 0x24);
+  EXPECT_FALSE(completion.has_ata_return);
+  EXPECT_FALSE(completion.isAtaError());
+
+  // too short for ASC/ASCQ
+  ASSERT_TRUE(decodeSenseData(sense, 12, true, &completion));
+  EXPECT_FALSE(completion.has_ata_return);
+}
+
+TEST(SenseDataTest, no_sense) {
+  const unsigned char sense[32] = {0};
+  AtaCompletion completion;
+  EXPECT_FALSE(decodeSenseData(sense, sizeof(sense), true, &completion));
+  EXPECT_EQ(completion.sense_response_code, 0);
+  EXPECT_FALSE(completion.has_ata_return);
+
+  // truncated descriptor
+  const unsigned char truncated[] = {0x72, 0x01, 0x00, 0x1d, 0x00, 0x00, 0x00, 0x0e, 0x09, 0x0c, 0x00};
+  EXPECT_TRUE(decodeSenseData(truncated, sizeof(truncated), true, &completion));
+  EXPECT_FALSE(completion.has_ata_return);
+}
+
+TEST(SenseDataTest, transient) {
+  AtaCompletion completion;
+  EXPECT_FALSE(completion.isTransient());
+
+  // UNIT ATTENTION, POWER ON OCCURRED
+  const unsigned char unit_attention[] = {0x70, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x0a,
+                                          0x00, 0x00, 0x00, 0x00, 0x29, 0x00, 0x00, 0x00, 0x00, 0x00};
+  ASSERT_TRUE(decodeSenseData(unit_attention, sizeof(unit_attention), false, &completion));
+  EXPECT_TRUE(completion.isTransient());
+
+  // NOT READY, BECOMING READY / NOT READY, MEDIUM NOT PRESENT
+  unsigned char not_ready[] = {0x72, 0x02, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00};
+  ASSERT_TRUE(decodeSenseData(not_ready, sizeof(not_ready), false, &completion));
+  EXPECT_TRUE(completion.isTransient());
+  not_ready[2] = 0x3a;
+  not_ready[3] = 0x00;
+  ASSERT_TRUE(decodeSenseData(not_ready, sizeof(not_ready), false, &completion));
+  EXPECT_FALSE(completion.isTransient());
+
+  AtaCompletion busy;
+  busy.scsi_status = 0x08;
+  EXPECT_TRUE(busy.isTransient());
+  AtaCompletion requeue;
+  requeue.host_status = 0x0d;
+  EXPECT_TRUE(requeue.isTransient());
+}
+
+} // namespace
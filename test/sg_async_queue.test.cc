@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+
+#include <vector>
+
+// sgio.h has no include guard and comes with sg_async_queue.h
+#include "plat-linux/sg_async_queue.h"
+
+using namespace jcu::dparm;
+using namespace jcu::dparm::plat_linux;
+
+namespace {
+
+/**
+ * stands for the sg driver: the queue writes sg_io_hdr to one end of a SEQPACKET socket pair,
+ * and the test answers through the other end.
+ */
+class FakeSgNode {
+ public:
+  int queue_fd;
+  int node_fd;
+
+  FakeSgNode() : queue_fd(-1), node_fd(-1) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0) {
+      queue_fd = fds[0];
+      node_fd = fds[1];
+      fcntl(queue_fd, F_SETFL, fcntl(queue_fd, F_GETFL) | O_NONBLOCK);
+      fcntl(node_fd, F_SETFL, fcntl(node_fd, F_GETFL) | O_NONBLOCK);
+    }
+  }
+
+  ~FakeSgNode() {
+    // queue_fd is closed by the queue
+    if (node_fd != -1) {
+      close(node_fd);
+    }
+  }
+
+  /**
+   * @return false if nothing was submitted
+   */
+  bool receive(struct scsi_sg_io_hdr *io_hdr) {
+    return read(node_fd, io_hdr, sizeof(*io_hdr)) == (ssize_t) sizeof(*io_hdr);
+  }
+
+  void complete(struct scsi_sg_io_hdr io_hdr, unsigned char ata_status) {
+    io_hdr.status = 0;
+    io_hdr.host_status = 0;
+    io_hdr.driver_status = 0;
+    io_hdr.resid = 0;
+    if (ata_status) {
+      // fixed format sense with the ATA return (SAT-3 12.2.2.7)
+      unsigned char *sense = (unsigned char *) io_hdr.sbp;
+      memset(sense, 0, io_hdr.mx_sb_len);
+      sense[0] = 0x70;
+      sense[2] = 0x01; // RECOVERED ERROR
+      sense[3] = 0x04; // ATA error: ABRT
+      sense[4] = ata_status;
+      sense[7] = 10;
+      // ATA PASS-THROUGH INFORMATION AVAILABLE
+      sense[12] = 0x00;
+      sense[13] = 0x1d;
+      io_hdr.status = SG_CHECK_CONDITION;
+      io_hdr.driver_status = SG_DRIVER_SENSE;
+      io_hdr.sb_len_wr = 18;
+    }
+    ASSERT_EQ(write(node_fd, &io_hdr, sizeof(io_hdr)), (ssize_t) sizeof(io_hdr));
+  }
+};
+
+AsyncAtaCommand makeCommand(int drive, uint64_t user_data, void *data, unsigned int data_bytes) {
+  AsyncAtaCommand command;
+  memset(&command, 0, sizeof(command));
+  command.drive = drive;
+  command.rw = 0;
+  command.dma = 0;
+  command.tf.command = ata::ATA_OP_IDENTIFY;
+  command.data = data;
+  command.data_bytes = data_bytes;
+  command.timeout_secs = 5;
+  command.user_data = user_data;
+  return command;
+}
+
+TEST(SgAsyncQueueTest, completions_are_matched_by_pack_id) {
+  FakeSgNode node0, node1;
+  ASSERT_NE(node0.queue_fd, -1);
+  ASSERT_NE(node1.queue_fd, -1);
+  SgAsyncQueue queue((DriveFactoryOptions()));
+  EXPECT_EQ(queue.adoptDrive("/dev/sg0", node0.queue_fd), 0);
+  EXPECT_EQ(queue.adoptDrive("/dev/sg1", node1.queue_fd), 1);
+
+  unsigned char buffers[3][512];
+  memset(buffers, 0xaa, sizeof(buffers));
+  ASSERT_TRUE(queue.submit(makeCommand(0, 100, buffers[0], 512)).isOk());
+  ASSERT_TRUE(queue.submit(makeCommand(0, 101, buffers[1], 512)).isOk());
+  ASSERT_TRUE(queue.submit(makeCommand(1, 200, buffers[2], 512)).isOk());
+  EXPECT_EQ(queue.getInflightCount(), 3);
+  // read buffers are cleared on submit
+  EXPECT_EQ(buffers[0][0], 0);
+
+  struct scsi_sg_io_hdr hdr[3];
+  ASSERT_TRUE(node0.receive(&hdr[0]));
+  ASSERT_TRUE(node0.receive(&hdr[1]));
+  ASSERT_TRUE(node1.receive(&hdr[2]));
+  EXPECT_NE(hdr[0].pack_id, hdr[1].pack_id);
+  EXPECT_NE(hdr[0].pack_id, hdr[2].pack_id);
+  EXPECT_EQ(hdr[0].dxferp, buffers[0]);
+  EXPECT_EQ(hdr[2].dxfer_len, 512);
+
+  std::vector<AsyncAtaCompletion> completions;
+  EXPECT_EQ(queue.reap(completions, 1, 0), ETIMEDOUT);
+  EXPECT_TRUE(completions.empty());
+
+  // out of order, and a stray pack_id which is ignored
+  struct scsi_sg_io_hdr stray = hdr[0];
+  stray.pack_id = 0x12345;
+  node0.complete(stray, 0);
+  node0.complete(hdr[1], 0);
+  ASSERT_EQ(queue.reap(completions, 1, 1000), 0);
+  ASSERT_EQ(completions.size(), 1);
+  EXPECT_EQ(completions[0].drive, 0);
+  EXPECT_EQ(completions[0].user_data, 101);
+  EXPECT_TRUE(completions[0].result.isOk());
+  EXPECT_EQ(queue.getInflightCount(), 2);
+
+  // the ATA error of the sense data fails the command
+  completions.clear();
+  node1.complete(hdr[2], 0x51);
+  node0.complete(hdr[0], 0);
+  ASSERT_EQ(queue.reap(completions, 2, 1000), 0);
+  ASSERT_EQ(completions.size(), 2);
+  for (auto it = completions.cbegin(); it != completions.cend(); it++) {
+    if (it->user_data == 100) {
+      EXPECT_TRUE(it->result.isOk());
+    } else {
+      EXPECT_EQ(it->user_data, 200);
+      EXPECT_EQ(it->drive, 1);
+      EXPECT_EQ(it->result.code, DPARME_SYS);
+      EXPECT_EQ(it->result.sys_error, EIO);
+      EXPECT_EQ(it->tf.status, 0x51);
+    }
+  }
+  EXPECT_EQ(queue.getInflightCount(), 0);
+
+  // nothing left: returns at once
+  completions.clear();
+  EXPECT_EQ(queue.reap(completions, 1, 1000), 0);
+  EXPECT_TRUE(completions.empty());
+}
+
+TEST(SgAsyncQueueTest, scsi_error_is_not_ata_return) {
+  FakeSgNode node;
+  ASSERT_NE(node.queue_fd, -1);
+  SgAsyncQueue queue((DriveFactoryOptions()));
+  queue.adoptDrive("/dev/sg0", node.queue_fd);
+
+  unsigned char buffer[512];
+  ASSERT_TRUE(queue.submit(makeCommand(0, 1, buffer, sizeof(buffer))).isOk());
+  struct scsi_sg_io_hdr hdr;
+  ASSERT_TRUE(node.receive(&hdr));
+
+  // fixed format ILLEGAL REQUEST, INVALID FIELD IN CDB
+  unsigned char *sense = (unsigned char *) hdr.sbp;
+  memset(sense, 0, hdr.mx_sb_len);
+  sense[0] = 0x70;
+  sense[2] = 0x05;
+  sense[7] = 10;
+  sense[12] = 0x24;
+  hdr.status = SG_CHECK_CONDITION;
+  hdr.host_status = 0;
+  hdr.driver_status = SG_DRIVER_SENSE;
+  ASSERT_EQ(write(node.node_fd, &hdr, sizeof(hdr)), (ssize_t) sizeof(hdr));
+
+  std::vector<AsyncAtaCompletion> completions;
+  ASSERT_EQ(queue.reap(completions, 1, 1000), 0);
+  ASSERT_EQ(completions.size(), 1);
+  EXPECT_FALSE(completions[0].result.isOk());
+  EXPECT_FALSE(completions[0].detail.has_ata_return);
+  EXPECT_EQ(completions[0].detail.sense_key, kSenseIllegalRequest);
+}
+
+TEST(SgAsyncQueueTest, failed_submit_is_not_tracked) {
+  FakeSgNode node;
+  ASSERT_NE(node.queue_fd, -1);
+  SgAsyncQueue queue((DriveFactoryOptions()));
+  queue.adoptDrive("/dev/sg0", node.queue_fd);
+
+  unsigned char buffer[512];
+  DparmResult res = queue.submit(makeCommand(1, 0, buffer, sizeof(buffer)));
+  EXPECT_EQ(res.code, DPARME_SYS);
+  EXPECT_EQ(res.sys_error, EINVAL);
+
+  // the peer is gone: write() fails with EPIPE
+  signal(SIGPIPE, SIG_IGN);
+  close(node.node_fd);
+  node.node_fd = -1;
+  res = queue.submit(makeCommand(0, 0, buffer, sizeof(buffer)));
+  EXPECT_EQ(res.code, DPARME_SYS);
+  EXPECT_NE(res.sys_error, 0);
+  EXPECT_EQ(queue.getInflightCount(), 0);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,63 @@
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+
+#include <vector>
+
+#include "plat-linux/sgio.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+TEST(SgIovecTest, bytes) {
+  unsigned char a[3], b[5];
+  DparmIoVec iov[2] = { { a, sizeof(a) }, { b, sizeof(b) } };
+
+  EXPECT_EQ(sg_iovec_bytes(iov, 2), 8);
+  EXPECT_EQ(sg_iovec_bytes(iov, 1), 3);
+
+  errno = 0;
+  EXPECT_EQ(sg_iovec_bytes(nullptr, 2), 0);
+  EXPECT_EQ(errno, EINVAL);
+  EXPECT_EQ(sg_iovec_bytes(iov, 0), 0);
+  EXPECT_EQ(sg_iovec_bytes(iov, 0x10000), 0);
+
+  DparmIoVec empty[2] = { { a, 0 }, { b, 0 } };
+  errno = 0;
+  EXPECT_EQ(sg_iovec_bytes(empty, 2), 0);
+  EXPECT_EQ(errno, EINVAL);
+
+  // the total must fit in dxfer_len
+  DparmIoVec large[2] = { { a, 0x80000000U }, { b, 0x80000000U } };
+  errno = 0;
+  EXPECT_EQ(sg_iovec_bytes(large, 2), 0);
+  EXPECT_EQ(errno, EINVAL);
+}
+
+TEST(SgIovecTest, gather_scatter) {
+  unsigned char a[3] = { 1, 2, 3 };
+  unsigned char b[1] = { 4 };
+  unsigned char c[4] = { 5, 6, 7, 8 };
+  DparmIoVec iov[3] = { { a, sizeof(a) }, { b, sizeof(b) }, { c, sizeof(c) } };
+
+  std::vector<unsigned char> buffer(sg_iovec_bytes(iov, 3));
+  sg_iovec_gather(iov, 3, buffer.data());
+  EXPECT_EQ(buffer, std::vector<unsigned char>({ 1, 2, 3, 4, 5, 6, 7, 8 }));
+
+  for (size_t i = 0; i < buffer.size(); i++) {
+    buffer[i] = (unsigned char) (0x10 + i);
+  }
+  sg_iovec_scatter(buffer.data(), iov, 3);
+  EXPECT_EQ(a[0], 0x10);
+  EXPECT_EQ(a[2], 0x12);
+  EXPECT_EQ(b[0], 0x13);
+  EXPECT_EQ(c[0], 0x14);
+  EXPECT_EQ(c[3], 0x17);
+}
+
+} // namespace
+
+#endif
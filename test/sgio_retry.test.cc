@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <string.h>
+
+#include <vector>
+
+#include <jcu-dparm/trace_ring.h>
+
+#include "plat-linux/sgio.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+/**
+ * answers SG_IO with the SAM status of each attempt, the last one repeated
+ */
+class FakeSgIo {
+ public:
+  std::vector<unsigned char> statuses;
+  // ioctl fails with this errno; 0 : succeeds
+  int ioctl_errno;
+  std::vector<uint64_t> issued_ms;
+  std::vector<unsigned int> timeouts;
+
+  FakeSgIo() : ioctl_errno(0) {}
+
+  int operator()(int fd, struct scsi_sg_io_hdr *io_hdr) {
+    issued_ms.push_back(TraceRing::now() / 1000000);
+    timeouts.push_back(io_hdr->timeout);
+    if (ioctl_errno) {
+      errno = ioctl_errno;
+      return -1;
+    }
+    size_t attempt = issued_ms.size() - 1;
+    io_hdr->status = statuses[(attempt < statuses.size()) ? attempt : (statuses.size() - 1)];
+    io_hdr->host_status = 0;
+    io_hdr->driver_status = 0;
+    io_hdr->resid = 0;
+    return 0;
+  }
+};
+
+const unsigned char kStatusGood = 0x00;
+const unsigned char kStatusBusy = 0x08;
+// without sense data
+const unsigned char kStatusCheckCondition = 0x02;
+
+int testUnitReady(scsi_sg_device *dev, FakeSgIo *fake, unsigned int timeout_secs) {
+  dev->sg_io = [fake](int fd, struct scsi_sg_io_hdr *io_hdr) -> int {
+    return (*fake)(fd, io_hdr);
+  };
+  unsigned char cdb[6] = { 0 };
+  unsigned char sense[32];
+  return do_sg_ata(dev, SG_READ, cdb, sizeof(cdb), nullptr, 0, 0, timeout_secs, sense, sizeof(sense));
+}
+
+TEST(SgIoRetryTest, transient_status_is_retried) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 3;
+  FakeSgIo fake;
+  fake.statuses = { kStatusBusy, kStatusBusy, kStatusGood };
+
+  EXPECT_EQ(testUnitReady(&dev, &fake, 5), 0);
+  EXPECT_EQ(fake.issued_ms.size(), 3);
+}
+
+TEST(SgIoRetryTest, retries_are_limited) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 2;
+  FakeSgIo fake;
+  fake.statuses = { kStatusBusy };
+
+  testUnitReady(&dev, &fake, 5);
+  EXPECT_EQ(fake.issued_ms.size(), 3);
+
+  // no retry by default
+  scsi_sg_device plain = {};
+  plain.fd = -1;
+  FakeSgIo once;
+  once.statuses = { kStatusBusy };
+  testUnitReady(&plain, &once, 5);
+  EXPECT_EQ(once.issued_ms.size(), 1);
+}
+
+TEST(SgIoRetryTest, backoff_is_doubled) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 3;
+  dev.retry.backoff_ms = 20;
+  FakeSgIo fake;
+  fake.statuses = { kStatusBusy };
+
+  testUnitReady(&dev, &fake, 5);
+  ASSERT_EQ(fake.issued_ms.size(), 4);
+  EXPECT_GE(fake.issued_ms[1] - fake.issued_ms[0], 20);
+  EXPECT_GE(fake.issued_ms[2] - fake.issued_ms[1], 40);
+  EXPECT_GE(fake.issued_ms[3] - fake.issued_ms[2], 80);
+}
+
+TEST(SgIoRetryTest, errors_are_not_retried) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 3;
+  FakeSgIo fake;
+  fake.statuses = { kStatusCheckCondition };
+  testUnitReady(&dev, &fake, 5);
+  EXPECT_EQ(fake.issued_ms.size(), 1);
+
+  FakeSgIo failing;
+  failing.ioctl_errno = ENODEV;
+  EXPECT_EQ(testUnitReady(&dev, &failing, 5), -1);
+  EXPECT_EQ(failing.issued_ms.size(), 1);
+  EXPECT_EQ(dev.last_errno, ENODEV);
+}
+
+TEST(SgIoRetryTest, deadline_cuts_the_retries) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 10;
+  dev.retry.backoff_ms = 100;
+  dev.retry.deadline_ms = 1250;
+  FakeSgIo fake;
+  fake.statuses = { kStatusBusy };
+
+  testUnitReady(&dev, &fake, 5);
+  // the third attempt would start after 300ms with less than 1s left
+  ASSERT_EQ(fake.issued_ms.size(), 2);
+  // attempts are shortened to the time left
+  EXPECT_EQ(fake.timeouts[0], 1250);
+  EXPECT_LE(fake.timeouts[1], 1150);
+  EXPECT_GE(fake.timeouts[1], 1000);
+}
+
+TEST(SgIoRetryTest, no_retry_below_the_floor) {
+  scsi_sg_device dev = {};
+  dev.fd = -1;
+  dev.retry.max_retries = 2;
+  dev.retry.deadline_ms = 900;
+  FakeSgIo fake;
+  fake.statuses = { kStatusBusy };
+
+  testUnitReady(&dev, &fake, 5);
+  ASSERT_EQ(fake.issued_ms.size(), 1);
+  EXPECT_EQ(fake.timeouts[0], 900);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+
+#include "drive_handle_base.h"
+#include "shared_handle_cache.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+class FakeDriverHandle : public DriveDriverHandle {
+ public:
+  std::string getDriverName() const override {
+    return "fake";
+  }
+
+  void mergeDriveInfo(DriveInfo &drive_info) const override {
+  }
+
+  void close() override {
+  }
+};
+
+class FakeDriveHandle : public DriveHandleBase {
+ public:
+  FakeDriverHandle driver_handle;
+  bool opened;
+
+  FakeDriveHandle(const std::string &serial, bool open)
+      : DriveHandleBase(DriveFactoryOptions(), "/dev/fake", DparmResult()), opened(open) {
+    drive_info_.serial = serial;
+  }
+
+  DriveDriverHandle *getDriverHandle() const override {
+    return const_cast<FakeDriverHandle *>(&driver_handle);
+  }
+
+  bool isOpen() const override {
+    return opened;
+  }
+
+  void close() override {
+    opened = false;
+  }
+
+  DparmResult getError() const override {
+    return { DPARME_OK, 0 };
+  }
+};
+
+class Opener {
+ public:
+  std::string serial;
+  bool open_ok;
+  int count;
+
+  Opener() : serial("A"), open_ok(true), count(0) {}
+
+  SharedHandleCache::OpenFunction function() {
+    return [this]() -> std::unique_ptr<DriveHandle> {
+      count++;
+      return std::unique_ptr<DriveHandle>(new FakeDriveHandle(serial, open_ok));
+    };
+  }
+};
+
+TEST(SharedHandleCacheTest, shares_one_handle_per_path) {
+  SharedHandleCache cache;
+  Opener opener;
+
+  auto first = cache.get("/dev/sda", 1, opener.function());
+  auto second = cache.get("/dev/sda", 1, opener.function());
+  EXPECT_EQ(opener.count, 1);
+  EXPECT_EQ(first.get(), second.get());
+  // the cache holds one reference
+  EXPECT_EQ(first.use_count(), 3);
+
+  auto other = cache.get("/dev/sdb", 2, opener.function());
+  EXPECT_EQ(opener.count, 2);
+  EXPECT_NE(first.get(), other.get());
+}
+
+TEST(SharedHandleCacheTest, invalidate_keeps_handles_in_use) {
+  SharedHandleCache cache;
+  Opener opener;
+
+  auto first = cache.get("/dev/sda", 1, opener.function());
+  cache.invalidate("/dev/sda");
+  // the caller keeps its reference; the cache released its own
+  EXPECT_EQ(first.use_count(), 1);
+  EXPECT_TRUE(first->isOpen());
+
+  auto second = cache.get("/dev/sda", 1, opener.function());
+  EXPECT_EQ(opener.count, 2);
+  EXPECT_NE(first.get(), second.get());
+
+  cache.get("/dev/sdb", 2, opener.function());
+  cache.invalidate(nullptr);
+  cache.get("/dev/sda", 1, opener.function());
+  cache.get("/dev/sdb", 2, opener.function());
+  EXPECT_EQ(opener.count, 5);
+}
+
+TEST(SharedHandleCacheTest, failed_open_is_not_cached) {
+  SharedHandleCache cache;
+  Opener opener;
+
+  opener.open_ok = false;
+  auto failed = cache.get("/dev/sda", 1, opener.function());
+  ASSERT_TRUE(failed);
+  EXPECT_FALSE(failed->isOpen());
+
+  opener.open_ok = true;
+  auto opened = cache.get("/dev/sda", 1, opener.function());
+  EXPECT_TRUE(opened->isOpen());
+  EXPECT_EQ(opener.count, 2);
+}
+
+TEST(SharedHandleCacheTest, closed_handle_is_reopened) {
+  SharedHandleCache cache;
+  Opener opener;
+
+  auto first = cache.get("/dev/sda", 1, opener.function());
+  first->close();
+  auto second = cache.get("/dev/sda", 1, opener.function());
+  EXPECT_EQ(opener.count, 2);
+  EXPECT_TRUE(second->isOpen());
+}
+
+TEST(SharedHandleCacheTest, hot_swap) {
+  SharedHandleCache cache;
+  Opener opener;
+
+  auto old_drive = cache.get("/dev/sda", 1, opener.function());
+  EXPECT_EQ(old_drive->getDriveInfo().serial, "A");
+
+  // another device number on the same path is detected
+  opener.serial = "B";
+  auto new_drive = cache.get("/dev/sda", 2, opener.function());
+  EXPECT_EQ(new_drive->getDriveInfo().serial, "B");
+
+  // a drive swapped under the same device number is not, until invalidated
+  opener.serial = "C";
+  EXPECT_EQ(cache.get("/dev/sda", 2, opener.function())->getDriveInfo().serial, "B");
+  cache.invalidate("/dev/sda");
+  EXPECT_EQ(cache.get("/dev/sda", 2, opener.function())->getDriveInfo().serial, "C");
+  EXPECT_EQ(opener.count, 3);
+}
+
+} // namespace
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plat-linux/sysfs_resolver.h"
+
+using namespace jcu::dparm;
+
+namespace {
+
+/**
+ * {root}/devices/... with {root}/dev/block/MAJ:MIN links, like sysfs
+ */
+class SysfsResolverTest : public ::testing::Test {
+ protected:
+  std::string root_;
+
+  void SetUp() override {
+    std::string pattern = ::testing::TempDir() + "jcu_dparm_sysfs_XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back(0);
+    ASSERT_NE(mkdtemp(buffer.data()), nullptr);
+    root_ = buffer.data();
+    makeDir("/dev");
+    makeDir("/dev/block");
+    makeDir("/devices");
+  }
+
+  void TearDown() override {
+    std::string command = "rm -rf '" + root_ + "'";
+    EXPECT_EQ(system(command.c_str()), 0);
+  }
+
+  void makeDir(const std::string &path) {
+    ASSERT_EQ(mkdir((root_ + path).c_str(), 0755), 0) << path;
+  }
+
+  void writeAttr(const std::string &path, const std::string &value) {
+    FILE *fp = fopen((root_ + path).c_str(), "w");
+    ASSERT_NE(fp, nullptr) << path;
+    fputs(value.c_str(), fp);
+    fclose(fp);
+  }
+
+  /**
+   * @param path (in) directory below /devices
+   */
+  void addDevice(const std::string &path, dev_t dev) {
+    char name[32];
+    snprintf(name, sizeof(name), "%u:%u", major(dev), minor(dev));
+    writeAttr(path + "/dev", std::string(name) + "\n");
+    std::string link = root_ + "/dev/block/" + name;
+    unlink(link.c_str());
+    ASSERT_EQ(symlink(("../.." + path).c_str(), link.c_str()), 0);
+  }
+
+  static bool isDirectory(int fd, const std::string &path) {
+    struct stat fd_st, path_st;
+    return fstat(fd, &fd_st) == 0 && stat(path.c_str(), &path_st) == 0 &&
+        fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino;
+  }
+};
+
+TEST_F(SysfsResolverTest, device_directory) {
+  makeDir("/devices/pci0");
+  makeDir("/devices/pci0/sda");
+  addDevice("/devices/pci0/sda", makedev(8, 0));
+
+  SysfsResolver resolver(root_);
+  int fd = resolver.openDevice(makedev(8, 0), false, 0);
+  ASSERT_NE(fd, -1);
+  EXPECT_TRUE(isDirectory(fd, root_ + "/devices/pci0/sda"));
+  close(fd);
+
+  errno = 0;
+  EXPECT_EQ(resolver.openDevice(makedev(8, 16), false, 0), -1);
+  EXPECT_EQ(errno, ENOENT);
+}
+
+TEST_F(SysfsResolverTest, reused_device_number_is_resolved_again) {
+  makeDir("/devices/usb1");
+  makeDir("/devices/usb1/sdb");
+  writeAttr("/devices/usb1/idVendor", "0bda\n");
+  addDevice("/devices/usb1/sdb", makedev(8, 16));
+
+  SysfsResolver resolver(root_);
+  int fd = resolver.openDevice(makedev(8, 16), false, 0);
+  ASSERT_NE(fd, -1);
+  int attr_fd = resolver.openAncestor(makedev(8, 16), false, fd, "idVendor");
+  ASSERT_NE(attr_fd, -1);
+  EXPECT_TRUE(isDirectory(attr_fd, root_ + "/devices/usb1"));
+  close(attr_fd);
+  close(fd);
+
+  // unplugged, and 8:16 given to a drive of another controller
+  writeAttr("/devices/usb1/sdb/dev", "8:32\n");
+  makeDir("/devices/pci0");
+  makeDir("/devices/pci0/host0");
+  makeDir("/devices/pci0/host0/sdb");
+  addDevice("/devices/pci0/host0/sdb", makedev(8, 16));
+
+  fd = resolver.openDevice(makedev(8, 16), false, 0);
+  ASSERT_NE(fd, -1);
+  EXPECT_TRUE(isDirectory(fd, root_ + "/devices/pci0/host0/sdb"));
+  // the depth found for the former directory is dropped
+  errno = 0;
+  EXPECT_EQ(resolver.openAncestor(makedev(8, 16), false, fd, "idVendor"), -1);
+  EXPECT_EQ(errno, EINVAL);
+  close(fd);
+}
+
+TEST_F(SysfsResolverTest, ancestor_depth_is_revalidated) {
+  makeDir("/devices/usb1");
+  makeDir("/devices/usb1/1-1");
+  makeDir("/devices/usb1/1-1/host0");
+  makeDir("/devices/usb1/1-1/host0/sdc");
+  addDevice("/devices/usb1/1-1/host0/sdc", makedev(8, 32));
+  const dev_t dev = makedev(8, 32);
+
+  SysfsResolver resolver(root_);
+  int fd = resolver.openDevice(dev, false, 0);
+  ASSERT_NE(fd, -1);
+
+  // a miss is not cached: the attribute may appear later
+  EXPECT_EQ(resolver.openAncestor(dev, false, fd, "idVendor"), -1);
+  writeAttr("/devices/usb1/1-1/idVendor", "0bda\n");
+  int attr_fd = resolver.openAncestor(dev, false, fd, "idVendor");
+  ASSERT_NE(attr_fd, -1);
+  EXPECT_TRUE(isDirectory(attr_fd, root_ + "/devices/usb1/1-1"));
+  close(attr_fd);
+
+  // the cached depth is used while the attribute is there
+  writeAttr("/devices/usb1/1-1/host0/idVendor", "1234\n");
+  attr_fd = resolver.openAncestor(dev, false, fd, "idVendor");
+  ASSERT_NE(attr_fd, -1);
+  EXPECT_TRUE(isDirectory(attr_fd, root_ + "/devices/usb1/1-1"));
+  close(attr_fd);
+
+  // and searched again when it is gone
+  ASSERT_EQ(unlink((root_ + "/devices/usb1/1-1/idVendor").c_str()), 0);
+  attr_fd = resolver.openAncestor(dev, false, fd, "idVendor");
+  ASSERT_NE(attr_fd, -1);
+  EXPECT_TRUE(isDirectory(attr_fd, root_ + "/devices/usb1/1-1/host0"));
+  close(attr_fd);
+
+  // not above the devices directory
+  writeAttr("/devices/idProduct", "0001\n");
+  EXPECT_EQ(resolver.openAncestor(dev, false, fd, "idProduct"), -1);
+  close(fd);
+}
+
+TEST_F(SysfsResolverTest, concurrent_lookups) {
+  const int kDrives = 8;
+  makeDir("/devices/usb1");
+  writeAttr("/devices/usb1/idVendor", "0bda\n");
+  for (int i = 0; i < kDrives; i++) {
+    std::string path = "/devices/usb1/sd" + std::string(1, (char) ('a' + i));
+    makeDir(path);
+    addDevice(path, makedev(8, i * 16));
+  }
+
+  SysfsResolver resolver(root_);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([this, &resolver, &failures, t]() -> void {
+      for (int n = 0; n < 200; n++) {
+        int i = (t + n) % kDrives;
+        dev_t dev = makedev(8, i * 16);
+        int fd = resolver.openDevice(dev, false, 0);
+        if (fd == -1) {
+          failures++;
+          continue;
+        }
+        if (!isDirectory(fd, root_ + "/devices/usb1/sd" + std::string(1, (char) ('a' + i)))) {
+          failures++;
+        }
+        int attr_fd = resolver.openAncestor(dev, false, fd, "idVendor");
+        if (attr_fd == -1 || !isDirectory(attr_fd, root_ + "/devices/usb1")) {
+          failures++;
+        }
+        if (attr_fd != -1) {
+          close(attr_fd);
+        }
+        close(fd);
+      }
+    });
+  }
+  for (auto it = threads.begin(); it != threads.end(); it++) {
+    it->join();
+  }
+  EXPECT_EQ(failures.load(), 0);
+}
+
+} // namespace
+
+#endif
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jcu-dparm/ata_types.h>
+#include <jcu-dparm/trace_ring.h>
+
+using namespace jcu::dparm;
+
+namespace {
+
+TEST(TraceRingTest, capacity_rounded_up) {
+  TraceRing ring(100);
+  EXPECT_EQ(ring.capacity(), 128);
+}
+
+TEST(TraceRingTest, keeps_newest_records_in_order) {
+  TraceRing ring(8);
+  for (int i = 0; i < 20; i++) {
+    unsigned char payload = (unsigned char) i;
+    ring.record(kTraceSgCdb, 1000 + i, 0, i, &payload, 1);
+  }
+
+  std::vector<TraceRecord> records;
+  ring.snapshot(records);
+  ASSERT_EQ(records.size(), 8);
+  for (size_t i = 0; i < records.size(); i++) {
+    EXPECT_EQ(records[i].index, 12 + i);
+    EXPECT_EQ(records[i].result, (int) (12 + i));
+    EXPECT_EQ(records[i].payload[0], 12 + i);
+  }
+}
+
+TEST(TraceRingTest, payload_truncated) {
+  TraceRing ring(4);
+  unsigned char payload[64];
+  memset(payload, 0xaa, sizeof(payload));
+  ring.record(kTraceSgCdb, 0, 0, 0, payload, sizeof(payload));
+
+  std::vector<TraceRecord> records;
+  ring.snapshot(records);
+  ASSERT_EQ(records.size(), 1);
+  EXPECT_EQ(records[0].length, sizeof(records[0].payload));
+}
+
+TEST(TraceRingTest, concurrent_writers) {
+  TraceRing ring(1024);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&ring, t]() {
+      for (int i = 0; i < 100; i++) {
+        ring.record(kTraceSgCdb, 0, 0, t, nullptr, 0);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<TraceRecord> records;
+  ring.snapshot(records);
+  EXPECT_EQ(records.size(), 400);
+}
+
+TEST(TraceRingTest, decode) {
+  TraceRing ring(4);
+  unsigned char cdb[16] = {0x85, 0x08, 0x0e};
+  ring.record(kTraceSgCdb, 1500000000ULL, 0, 7, cdb, 3);
+
+  unsigned char result[8] = {0x02, 0x00, 0x08, 4, 0x72, 0x00, 0x00, 0x00};
+  ring.record(kTraceSgResult, 1500000000ULL, 120, 0, result, sizeof(result));
+
+  ata::ata_tf_t tf = {0};
+  tf.command = 0xec;
+  tf.status = 0x50;
+  ring.record(kTraceTaskfile, 1500000000ULL, 0, 0, &tf, sizeof(tf));
+
+  TraceNvmeCmd cmd = {0};
+  cmd.opcode = 0x06;
+  cmd.cdw10[0] = 1;
+  ring.record(kTraceNvmeAdmin, 2000000000ULL, 35, 0, &cmd, sizeof(cmd));
+
+  std::vector<TraceRecord> records;
+  ring.snapshot(records);
+  std::string text;
+  decodeTraceRecords(records.data(), records.size(), text);
+
+  EXPECT_EQ(text,
+            "[1.500000] #0 sg cdb pack_id=7: 85 08 0e\n"
+            "[1.500000] #1 sg result ioctl=0 120us status=0x02 host=0x00 driver=0x08 sense: 72 00 00 00\n"
+            "[1.500000] #2 tf rc=0 command=0xec status=0x50 error=0x00 dev=0x00 nsect=0000 lba=000000000000\n"
+            "[2.000000] #3 nvme admin opcode=0x06 nsid=0 cdw10-15=00000001 00000000 00000000 00000000 00000000 00000000 result=0 35us\n");
+}
+
+} // namespace
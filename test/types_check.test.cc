@@ -2,6 +2,7 @@
 
 #include <jcu-dparm/ata_types.h>
 #include <jcu-dparm/nvme_types.h>
+#include <jcu-dparm/types.h>
 
 using namespace jcu::dparm;
 
@@ -69,4 +70,117 @@ TEST(NvmeTypesTest, struct_nvme_smart_log_page) {
   EXPECT_EQ(sizeof(*p), 512);
 }
 
-} // namespace
\ No newline at end of file
+TEST(NvmeTypesTest, struct_nvme_identify_namespace) {
+  nvme_identify_namespace_t* p = (nvme_identify_namespace_t*)0;
+
+  EXPECT_EQ((int)&(p->nsze), 0);
+  EXPECT_EQ((int)&(p->ncap), 8);
+  EXPECT_EQ((int)&(p->nuse), 16);
+  EXPECT_EQ((int)&(p->nsfeat), 24);
+  EXPECT_EQ((int)&(p->flbas), 26);
+  EXPECT_EQ((int)&(p->dps), 29);
+  EXPECT_EQ((int)&(p->noiob), 46);
+  EXPECT_EQ((int)&(p->nvmcap), 48);
+  EXPECT_EQ((int)&(p->nguid), 104);
+  EXPECT_EQ((int)&(p->eui64), 120);
+  EXPECT_EQ((int)&(p->lbaf), 128);
+  EXPECT_EQ((int)&(p->vs), 384);
+
+  EXPECT_EQ(sizeof(*p), 4096);
+}
+
+TEST(NvmeTypesTest, struct_nvme_telemetry_log_header) {
+  nvme_telemetry_log_header_t* p = (nvme_telemetry_log_header_t*)0;
+
+  EXPECT_EQ((int)&(p->dalb1), 8);
+  EXPECT_EQ((int)&(p->dalb3), 12);
+  EXPECT_EQ((int)&(p->dalb4), 16);
+  EXPECT_EQ((int)&(p->hostdgn), 381);
+  EXPECT_EQ((int)&(p->ctrldgn), 383);
+  EXPECT_EQ((int)&(p->rsnident), 384);
+
+  EXPECT_EQ(sizeof(*p), 512);
+}
+
+TEST(NvmeTypesTest, struct_nvme_persistent_event_log_header) {
+  nvme_persistent_event_log_header_t* p = (nvme_persistent_event_log_header_t*)0;
+
+  EXPECT_EQ((int)&(p->tnev), 4);
+  EXPECT_EQ((int)&(p->tll), 8);
+  EXPECT_EQ((int)&(p->lhl), 18);
+  EXPECT_EQ((int)&(p->ts), 20);
+  EXPECT_EQ((int)&(p->pcc), 44);
+  EXPECT_EQ((int)&(p->subnqn), 116);
+  EXPECT_EQ((int)&(p->gen_number), 372);
+  EXPECT_EQ((int)&(p->seb), 480);
+
+  EXPECT_EQ(sizeof(*p), 512);
+  EXPECT_EQ(sizeof(nvme_persistent_event_header_t), 24);
+}
+
+} // namespace
+
+namespace {
+
+TEST(DriveInfoTest, tcg_feature_table) {
+  const unsigned char tper[] = {0x00, 0x01, 0x10, 0x0c, 0x11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned char locking[] = {0x00, 0x02, 0x10, 0x0c, 0x09, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned char locking_dup[] = {0x00, 0x02, 0x10, 0x0c, 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const unsigned char malformed[] = {0x02, 0x03, 0x10, 0x20, 0x00};
+  TcgFeatureTable table;
+  size_t length = 0;
+
+  table.add(tper, sizeof(tper));
+  table.add(locking, sizeof(locking));
+  table.add(locking_dup, sizeof(locking_dup));
+  table.add(malformed, sizeof(malformed));
+
+  const unsigned char *descriptor = table.find(0x0002, &length);
+  ASSERT_NE(descriptor, nullptr);
+  EXPECT_EQ(length, 16);
+  EXPECT_EQ(descriptor[4], 0x09);
+  EXPECT_EQ(table.find(0x0203), nullptr);
+
+  TcgFeatureTable copy;
+  int count = 0;
+  copy.assignRaw(table.raw());
+  copy.forEach([&count](uint16_t feature_code, const unsigned char *data, size_t length) -> void {
+    count++;
+  });
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(copy.raw().size(), 32);
+}
+
+TEST(DriveInfoTest, identify_side_allocation) {
+  DriveInfo drive_info;
+  EXPECT_FALSE(drive_info.hasAtaIdentify());
+  EXPECT_EQ(drive_info.getNvmeIdentifyCtrl().vid, 0);
+
+  std::shared_ptr<nvme::nvme_identify_controller_t> ctrl(new nvme::nvme_identify_controller_t());
+  ctrl->vid = 0x144d;
+  drive_info.setNvmeIdentifyCtrl(ctrl);
+
+  DriveInfo copy = drive_info;
+  EXPECT_EQ(&copy.getNvmeIdentifyCtrl(), &drive_info.getNvmeIdentifyCtrl());
+  EXPECT_EQ(copy.getNvmeIdentifyCtrl().vid, 0x144d);
+  EXPECT_FALSE(copy.hasAtaIdentify());
+}
+
+TEST(DriveFactoryOptionsTest, brace_initialization) {
+  int calls = 0;
+  DriveFactoryOptions options{[&calls](const std::string &text) -> int {
+    calls++;
+    return 0;
+  }, kVerboseInfo};
+  EXPECT_EQ(options.verbose, kVerboseInfo);
+  EXPECT_FALSE(options.lazy_tcg_discovery);
+  EXPECT_EQ(options.trace_records, 0);
+  options.debug_puts("text");
+  EXPECT_EQ(calls, 1);
+
+  DriveFactoryOptions defaults{};
+  EXPECT_EQ(defaults.verbose, kVerboseDisabled);
+  EXPECT_FALSE((bool) defaults.debug_puts);
+}
+
+} // namespace
@@ -0,0 +1,468 @@
+/**
+ * @file	passthrough_bench.cc
+ * @author	Joseph Lee <development@jc-lab.net>
+ * @date	2026/10/16
+ * @copyright Copyright (C) 2020 jc-lab.\n
+ *            This software may be modified and distributed under the terms
+ *            of the Apache License 2.0.  See the LICENSE file for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <jcu-dparm/drive_factory.h>
+#include <jcu-dparm/drive_handle.h>
+#include <jcu-dparm/ata_utils.h>
+#include <jcu-dparm/latency_stats.h>
+
+using namespace jcu::dparm;
+
+namespace {
+
+enum BenchMode {
+  kModeAuto = 0,
+  kModeAta,
+  kModeNvmeIo,
+  kModeNvmePassthru,
+};
+
+struct BenchOptions {
+  std::string path;
+  BenchMode mode;
+  unsigned int block_bytes;
+  int queue_depth;
+  bool random;
+  bool write;
+  bool force;
+  unsigned int duration_secs;
+  /**
+   * bytes of the drive used from lba 0. 0 : whole drive
+   */
+  uint64_t span_bytes;
+  /**
+   * 0 : not given
+   */
+  uint32_t nsid;
+};
+
+struct Target {
+  BenchMode mode;
+  uint64_t lba_count;
+  unsigned int lba_bytes;
+  uint32_t nsid;
+};
+
+/**
+ * outcome of one worker. The latencies go to the shared LatencyStats.
+ */
+struct WorkerResult {
+  DparmResult first_error;
+  uint64_t ios;
+  uint64_t errors;
+};
+
+void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [options] <drive path>\n"
+          "  -m <mode>      ata, nvme-io, nvme-passthru (default: by drive type)\n"
+          "  -b <bytes>     block size, multiple of the lba size (default: 4096)\n"
+          "  -q <depth>     commands in flight, one handle per command (default: 1)\n"
+          "  -p <pattern>   seq, rand (default: rand)\n"
+          "  -w             write instead of read. Destroys the data; requires --force\n"
+          "  -t <secs>      duration (default: 10)\n"
+          "  -s <bytes>     span from lba 0 (default: whole drive)\n"
+          "  -n <nsid>      namespace of nvme-passthru (default: 1). nvme-io uses the namespace\n"
+          "                 of the device; a different -n is an error\n"
+          "  --force        allow -w\n",
+          prog);
+}
+
+bool parseUnsigned(const char *text, uint64_t *value) {
+  char *end = nullptr;
+  errno = 0;
+  unsigned long long parsed = strtoull(text, &end, 0);
+  if (errno || end == text) {
+    return false;
+  }
+  switch (*end) {
+    case 'k': case 'K': parsed <<= 10; end++; break;
+    case 'm': case 'M': parsed <<= 20; end++; break;
+    case 'g': case 'G': parsed <<= 30; end++; break;
+    default: break;
+  }
+  if (*end) {
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool parseArgs(int argc, char *argv[], BenchOptions *options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    uint64_t value = 0;
+    bool has_value = (arg.size() == 2 && arg[0] == '-' && strchr("mbqptsn", arg[1]));
+    if (has_value && ++i >= argc) {
+      return false;
+    }
+    if (arg == "-m") {
+      std::string mode(argv[i]);
+      if (mode == "ata") {
+        options->mode = kModeAta;
+      } else if (mode == "nvme-io") {
+        options->mode = kModeNvmeIo;
+      } else if (mode == "nvme-passthru") {
+        options->mode = kModeNvmePassthru;
+      } else {
+        return false;
+      }
+    } else if (arg == "-p") {
+      std::string pattern(argv[i]);
+      if (pattern == "seq") {
+        options->random = false;
+      } else if (pattern == "rand") {
+        options->random = true;
+      } else {
+        return false;
+      }
+    } else if (has_value) {
+      if (!parseUnsigned(argv[i], &value)) {
+        return false;
+      }
+      switch (arg[1]) {
+        case 'b': options->block_bytes = (unsigned int) value; break;
+        case 'q': options->queue_depth = (int) value; break;
+        case 't': options->duration_secs = (unsigned int) value; break;
+        case 's': options->span_bytes = value; break;
+        case 'n': options->nsid = (uint32_t) value; break;
+        default: return false;
+      }
+    } else if (arg == "-w") {
+      options->write = true;
+    } else if (arg == "--force") {
+      options->force = true;
+    } else if (arg[0] != '-' && options->path.empty()) {
+      options->path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options->path.empty() && options->block_bytes && options->queue_depth > 0 && options->duration_secs;
+}
+
+void *allocBuffer(size_t size) {
+  void *buffer = nullptr;
+  if (posix_memalign(&buffer, 4096, size)) {
+    return nullptr;
+  }
+  memset(buffer, 0xa5, size);
+  return buffer;
+}
+
+/**
+ * lba count and lba size of the namespace from Identify Namespace (CNS 00h)
+ */
+DparmResult identifyNamespace(DriveHandle *handle, uint32_t nsid, Target *target) {
+  std::unique_ptr<unsigned char, void(*)(void *)> data((unsigned char *) allocBuffer(4096), free);
+  if (!data) {
+    return { DPARME_SYS, ENOMEM };
+  }
+  nvme::nvme_admin_cmd_t cmd = { 0 };
+  cmd.opcode = 0x06;
+  cmd.nsid = nsid;
+  cmd.addr = data.get();
+  cmd.data_len = 4096;
+  cmd.cdw10 = 0;
+  DparmReturn<int> dr = handle->doNvmeAdminPassthru(&cmd);
+  if (!dr.isOk()) {
+    return { dr.code, dr.sys_error };
+  }
+  const unsigned char *p = data.get();
+  uint64_t nsze = 0;
+  for (int i = 7; i >= 0; i--) {
+    nsze = (nsze << 8) | p[i];
+  }
+  // FLBAS bits 3:0 select the LBA format; LBADS (byte 2 of the format) is log2 of the lba size
+  unsigned int format = p[26] & 0x0f;
+  unsigned int lbads = p[128 + format * 4 + 2];
+  if (!nsze || lbads < 9 || lbads > 16) {
+    return { DPARME_NOT_SUPPORTED, 0 };
+  }
+  target->lba_count = nsze;
+  target->lba_bytes = 1u << lbads;
+  return { DPARME_OK, 0 };
+}
+
+DparmResult resolveTarget(DriveHandle *handle, const BenchOptions& options, Target *target) {
+  target->mode = options.mode;
+  target->nsid = 0;
+  if (target->mode == kModeAuto) {
+    if (handle->getDriveInfo().driving_type == kDrivingNvme) {
+      target->mode = handle->driverIsNvmeIoSupported() ? kModeNvmeIo : kModeNvmePassthru;
+    } else {
+      target->mode = kModeAta;
+    }
+  }
+  switch (target->mode) {
+    case kModeAta:
+      if (!handle->driverIsTaskfileCmdSupported()) {
+        return { DPARME_NOT_SUPPORTED, 0 };
+      }
+      target->lba_count = handle->getAtaLbaCapacity();
+      target->lba_bytes = 512;
+      return { target->lba_count ? DPARME_OK : DPARME_NOT_SUPPORTED, 0 };
+    case kModeNvmeIo:
+      if (!handle->driverIsNvmeIoSupported()) {
+        return { DPARME_NOT_SUPPORTED, 0 };
+      }
+      // doNvmeIo is issued on the namespace the handle was opened on
+      target->nsid = handle->getNvmeNamespaceId();
+      if (!target->nsid) {
+        return { DPARME_NOT_SUPPORTED, 0 };
+      }
+      if (options.nsid && options.nsid != target->nsid) {
+        return { DPARME_ILLEGAL_DATA, EINVAL };
+      }
+      return identifyNamespace(handle, target->nsid, target);
+    case kModeNvmePassthru:
+      if (!handle->driverIsNvmeIoPassthruSupported()) {
+        return { DPARME_NOT_SUPPORTED, 0 };
+      }
+      target->nsid = options.nsid ? options.nsid : 1;
+      return identifyNamespace(handle, target->nsid, target);
+    default:
+      return { DPARME_NOT_SUPPORTED, 0 };
+  }
+}
+
+/**
+ * @return command status. The latency is measured around the call.
+ */
+DparmResult issueIo(DriveHandle *handle, const BenchOptions& options, const Target& target,
+                    uint64_t lba, uint32_t lba_count, void *buffer) {
+  switch (target.mode) {
+    case kModeAta: {
+      ata::ata_tf_t tf;
+      ata::tf_init(&tf, options.write ? ata::ATA_OP_WRITE_DMA_EXT : ata::ATA_OP_READ_DMA_EXT, lba, lba_count);
+      return handle->doTaskfileCmd(options.write ? 1 : 0, 1, &tf, buffer, options.block_bytes, 0);
+    }
+    case kModeNvmeIo: {
+      nvme::nvme_user_io_t io = { 0 };
+      io.opcode = options.write ? 0x01 : 0x02;
+      io.nblocks = (uint16_t) (lba_count - 1);
+      io.addr = (uint64_t) (uintptr_t) buffer;
+      io.slba = lba;
+      DparmReturn<int> dr = handle->doNvmeIo(&io);
+      return { dr.code, dr.sys_error };
+    }
+    case kModeNvmePassthru: {
+      nvme::nvme_passthru_cmd_t cmd = { 0 };
+      cmd.opcode = options.write ? 0x01 : 0x02;
+      cmd.nsid = target.nsid;
+      cmd.addr = buffer;
+      cmd.data_len = options.block_bytes;
+      cmd.cdw10 = (uint32_t) lba;
+      cmd.cdw11 = (uint32_t) (lba >> 32);
+      cmd.cdw12 = lba_count - 1;
+      DparmReturn<int> dr = handle->doNvmeIoPassthru(&cmd);
+      return { dr.code, dr.sys_error };
+    }
+    default:
+      return { DPARME_NOT_SUPPORTED, 0 };
+  }
+}
+
+void runWorker(int index, DriveHandle *handle, const BenchOptions& options, const Target& target,
+               uint64_t span_blocks, std::chrono::steady_clock::time_point deadline,
+               std::atomic<bool> *stop, LatencyStats *stats, WorkerResult *result) {
+  uint32_t lba_per_block = options.block_bytes / target.lba_bytes;
+  LatencyOpcodeClass opcode_class = (target.mode == kModeAta) ? kLatencyAta : kLatencyNvmeIo;
+  uint8_t opcode;
+  if (target.mode == kModeAta) {
+    opcode = options.write ? ata::ATA_OP_WRITE_DMA_EXT : ata::ATA_OP_READ_DMA_EXT;
+  } else {
+    opcode = options.write ? 0x01 : 0x02;
+  }
+  std::unique_ptr<void, void(*)(void *)> buffer(allocBuffer(options.block_bytes), free);
+  std::mt19937_64 rng((uint64_t) index * 0x9e3779b97f4a7c15ULL + 1);
+  // sequential workers start evenly spaced so they do not read the same blocks
+  uint64_t next_block = span_blocks * (uint64_t) index / (uint64_t) options.queue_depth;
+
+  result->first_error = { DPARME_OK, 0 };
+  result->ios = 0;
+  result->errors = 0;
+  if (!buffer) {
+    result->first_error = { DPARME_SYS, ENOMEM };
+    return;
+  }
+
+  while (!stop->load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < deadline) {
+    uint64_t block;
+    if (options.random) {
+      block = rng() % span_blocks;
+    } else {
+      block = next_block;
+      next_block = (next_block + 1) % span_blocks;
+    }
+
+    auto issued = std::chrono::steady_clock::now();
+    DparmResult dr = issueIo(handle, options, target, block * lba_per_block, lba_per_block, buffer.get());
+    uint64_t duration_us = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - issued).count();
+
+    stats->record(opcode_class, opcode, duration_us, !dr.isOk());
+    result->ios++;
+    if (!dr.isOk()) {
+      if (!result->errors) {
+        result->first_error = dr;
+      }
+      result->errors++;
+      // a drive failing every command would only measure the error path
+      if (result->errors >= 16 && result->errors * 2 > result->ios) {
+        stop->store(true);
+      }
+    }
+  }
+}
+
+const char *modeName(BenchMode mode) {
+  switch (mode) {
+    case kModeAta: return "ata";
+    case kModeNvmeIo: return "nvme-io";
+    case kModeNvmePassthru: return "nvme-passthru";
+    default: return "auto";
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  BenchOptions options;
+  options.mode = kModeAuto;
+  options.block_bytes = 4096;
+  options.queue_depth = 1;
+  options.random = true;
+  options.write = false;
+  options.force = false;
+  options.duration_secs = 10;
+  options.span_bytes = 0;
+  options.nsid = 0;
+
+  if (!parseArgs(argc, argv, &options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (options.write && !options.force) {
+    fprintf(stderr, "-w overwrites the drive; add --force\n");
+    return 2;
+  }
+
+  DriveFactory *factory = DriveFactory::getSystemFactory();
+
+  // DriveHandle is not thread safe; each command in flight gets its own handle and worker
+  std::vector<std::unique_ptr<DriveHandle>> handles;
+  for (int i = 0; i < options.queue_depth; i++) {
+    std::unique_ptr<DriveHandle> handle = factory->open(options.path.c_str());
+    if (!handle || !handle->isOpen()) {
+      DparmResult err = handle ? handle->getError() : DparmResult{ DPARME_SYS, ENOMEM };
+      fprintf(stderr, "open %s failed: code=%d, sys=%d\n", options.path.c_str(), err.code, err.sys_error);
+      return 1;
+    }
+    handles.push_back(std::move(handle));
+  }
+
+  Target target;
+  DparmResult dr = resolveTarget(handles[0].get(), options, &target);
+  if (target.mode == kModeNvmeIo && target.nsid && options.nsid && options.nsid != target.nsid) {
+    fprintf(stderr, "%s: -n %u is not the namespace of the device (%u)\n",
+            options.path.c_str(), options.nsid, target.nsid);
+    return 2;
+  }
+  if (!dr.isOk()) {
+    fprintf(stderr, "%s: mode %s is not usable: code=%d, sys=%d\n",
+            options.path.c_str(), modeName(target.mode), dr.code, dr.sys_error);
+    return 1;
+  }
+  if (options.block_bytes % target.lba_bytes) {
+    fprintf(stderr, "block size must be a multiple of %u\n", target.lba_bytes);
+    return 2;
+  }
+  uint32_t lba_per_block = options.block_bytes / target.lba_bytes;
+  // 16-bit sector count (ATA, 0 : 65536) / 0-based NLB (NVMe)
+  if (lba_per_block > 65536) {
+    fprintf(stderr, "block size is too large\n");
+    return 2;
+  }
+  uint64_t span_lbas = target.lba_count;
+  if (options.span_bytes && options.span_bytes / target.lba_bytes < span_lbas) {
+    span_lbas = options.span_bytes / target.lba_bytes;
+  }
+  uint64_t span_blocks = span_lbas / lba_per_block;
+  if (!span_blocks) {
+    fprintf(stderr, "span is smaller than a block\n");
+    return 2;
+  }
+
+  printf("%s: %s %s %s, bs=%u, qd=%d, %us, span=%llu blocks (lba %u bytes)\n",
+         options.path.c_str(), modeName(target.mode), options.random ? "rand" : "seq",
+         options.write ? "write" : "read", options.block_bytes, options.queue_depth,
+         options.duration_secs, (unsigned long long) span_blocks, target.lba_bytes);
+
+  LatencyStats stats;
+  std::atomic<bool> stop(false);
+  std::vector<WorkerResult> results(options.queue_depth);
+  std::vector<std::thread> workers;
+  auto started = std::chrono::steady_clock::now();
+  auto deadline = started + std::chrono::seconds(options.duration_secs);
+  for (int i = 0; i < options.queue_depth; i++) {
+    workers.emplace_back(runWorker, i, handles[i].get(), std::cref(options), std::cref(target),
+                         span_blocks, deadline, &stop, &stats, &results[i]);
+  }
+  for (auto it = workers.begin(); it != workers.end(); it++) {
+    it->join();
+  }
+  double elapsed_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  uint64_t ios = 0;
+  uint64_t errors = 0;
+  DparmResult first_error = { DPARME_OK, 0 };
+  for (auto it = results.cbegin(); it != results.cend(); it++) {
+    ios += it->ios;
+    errors += it->errors;
+    if (first_error.isOk() && !it->first_error.isOk()) {
+      first_error = it->first_error;
+    }
+  }
+  uint64_t completed = ios - errors;
+
+  printf("ios=%llu errors=%llu elapsed=%.2fs\n", (unsigned long long) ios, (unsigned long long) errors, elapsed_secs);
+  printf("iops=%.0f throughput=%.2f MiB/s\n",
+         completed / elapsed_secs, (double) completed * options.block_bytes / elapsed_secs / (1024.0 * 1024.0));
+
+  std::vector<LatencyOpcodeStats> snapshot;
+  stats.snapshot(snapshot);
+  for (auto it = snapshot.cbegin(); it != snapshot.cend(); it++) {
+    printf("latency (us): mean=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu\n",
+           (unsigned long long) it->meanUs(),
+           (unsigned long long) it->percentileUs(50),
+           (unsigned long long) it->percentileUs(90),
+           (unsigned long long) it->percentileUs(99),
+           (unsigned long long) it->percentileUs(99.9),
+           (unsigned long long) it->max_us);
+  }
+  if (errors) {
+    fprintf(stderr, "first error: code=%d, sys=%d\n", first_error.code, first_error.sys_error);
+    return 1;
+  }
+  return 0;
+}